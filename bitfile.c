@@ -41,6 +41,19 @@
 #include <errno.h>
 #include "bitfile.h"
 
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* number of bytes read or written with each fread/fwrite */
+#define BF_BLOCK_SIZE   (1 << 16)
+
+/* number of bits that fit in the bit buffer */
+#define BF_BUFFER_BITS  (sizeof(bit_buffer_t) * 8)
+
+/* most bits BitFileGetBitsInt/BitFilePutBitsInt can move at once */
+#define BF_INT_BITS     32
+
 /***************************************************************************
 *                            TYPE DEFINITIONS
 ***************************************************************************/
@@ -52,11 +65,31 @@
 ***************************************************************************/
 typedef int (*num_func_t)(bit_file_t*, void*, const unsigned int, const size_t);
 
+/* accumulator for the bits waiting to be read/written */
+typedef unsigned long long bit_buffer_t;
+
+/***************************************************************************
+* Bits are moved through a 64 bit accumulator and bytes through a block
+* buffer, so the file is only touched once every BF_BLOCK_SIZE bytes.  The
+* low bitCount bits of bitBuffer are valid, the oldest one is the msb.
+*
+* A bit file in memory has no fp.  When reading, block is the caller's
+* data.  When writing, block grows as needed and is handed to the caller by
+* BitFileToMemory.  A bit file made by MakeCallbackBitFile has no fp either
+* and moves its blocks with io instead of fread/fwrite.
+***************************************************************************/
 struct bit_file_t
 {
     FILE *fp;                   /* file pointer used by stdio functions */
-    unsigned char bitBuffer;    /* bits waiting to be read/written */
-    unsigned char bitCount;     /* number of bits in bitBuffer */
+    bit_io_func_t io;           /* or function reading/writing blocks */
+    void *ioHandle;             /* passed to io */
+    bit_buffer_t bitBuffer;     /* bits waiting to be read/written */
+    unsigned int bitCount;      /* number of bits in bitBuffer */
+    unsigned char *block;       /* bytes waiting to be read/written */
+    size_t blockSize;           /* number of bytes allocated for block */
+    size_t blockPos;            /* next byte to read/write in block */
+    size_t blockLen;            /* number of bytes read into block */
+    int error;                  /* non-zero once a write failed */
     num_func_t PutBitsNumFunc;  /* endian specific BitFilePutBitsNum */
     num_func_t GetBitsNumFunc;  /* endian specific BitFileGetBitsNum */
     BF_MODES mode;              /* open for read, write, or append */
@@ -80,6 +113,12 @@ typedef union
 *                               PROTOTYPES
 ***************************************************************************/
 static endian_t DetermineEndianess(void);
+static int InitBitFile(bit_file_t *bf, FILE *stream, const BF_MODES mode,
+    unsigned char *block, const size_t blockSize);
+
+static void FillBitBuffer(bit_file_t *stream);
+static int WriteBlock(bit_file_t *stream);
+static int FlushBitBuffer(bit_file_t *stream, const unsigned char onesFill);
 
 static int BitFilePutBitsLE(bit_file_t *stream, void *bits,
     const unsigned int count, const size_t size);
@@ -116,58 +155,33 @@ bit_file_t *BitFileOpen(const char *fileName, const BF_MODES mode)
 {
     const char modes[3][3] = {"rb", "wb", "ab"};    /* binary modes for fopen */
     bit_file_t *bf;
+    FILE *fp;
+
+    fp = fopen(fileName, modes[mode]);
+
+    if (fp == NULL)
+    {
+        /* fopen failed */
+        return NULL;
+    }
 
     bf = (bit_file_t *)malloc(sizeof(bit_file_t));
 
-    if (bf == NULL)
+    if ((bf == NULL) || (InitBitFile(bf, fp, mode,
+        (unsigned char *)malloc(BF_BLOCK_SIZE), BF_BLOCK_SIZE) != 0))
     {
         /* malloc failed */
+        free(bf);
+        fclose(fp);
         errno = ENOMEM;
+        return NULL;
     }
-    else
-    {
-        bf->fp = fopen(fileName, modes[mode]);
-
-        if (bf->fp == NULL)
-        {
-            /* fopen failed */
-            free(bf);
-            bf = NULL;
-        }
-        else
-        {
-            /* fopen succeeded fill in remaining bf data */
-            bf->bitBuffer = 0;
-            bf->bitCount = 0;
-            bf->mode = mode;
-
-            switch (DetermineEndianess())
-            {
-                case BF_LITTLE_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsLE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsLE;
-                    break;
-
-                case BF_BIG_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsBE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsBE;
-                    break;
-
-                case BF_UNKNOWN_ENDIAN:
-                default:
-                    bf->PutBitsNumFunc = BitFileNotSupported;
-                    bf->GetBitsNumFunc = BitFileNotSupported;
-                    break;
-            }
 
-            /***************************************************************
-            * TO DO: Consider using the last byte in a file to indicate
-            * the number of bits in the previous byte that actually have
-            * data.  If I do that, I'll need special handling of files
-            * opened with a mode of BF_APPEND.
-            ***************************************************************/
-        }
-    }
+    /***********************************************************************
+    * TO DO: Consider using the last byte in a file to indicate the number
+    * of bits in the previous byte that actually have data.  If I do that,
+    * I'll need special handling of files opened with a mode of BF_APPEND.
+    ***********************************************************************/
 
     return (bf);
 }
@@ -200,43 +214,181 @@ bit_file_t *MakeBitFile(FILE *stream, const BF_MODES mode)
     {
         bf = (bit_file_t *)malloc(sizeof(bit_file_t));
 
-        if (bf == NULL)
+        if ((bf == NULL) || (InitBitFile(bf, stream, mode,
+            (unsigned char *)malloc(BF_BLOCK_SIZE), BF_BLOCK_SIZE) != 0))
         {
             /* malloc failed */
+            free(bf);
+            bf = NULL;
             errno = ENOMEM;
         }
-        else
-        {
-            /* set structure data */
-            bf->fp = stream;
-            bf->bitBuffer = 0;
-            bf->bitCount = 0;
-            bf->mode = mode;
+    }
 
-            switch (DetermineEndianess())
-            {
-                case BF_LITTLE_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsLE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsLE;
-                    break;
-
-                case BF_BIG_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsBE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsBE;
-                    break;
-
-                case BF_UNKNOWN_ENDIAN:
-                default:
-                    bf->PutBitsNumFunc = BitFileNotSupported;
-                    bf->GetBitsNumFunc = BitFileNotSupported;
-                    break;
-            }
-        }
+    return (bf);
+}
+
+/***************************************************************************
+*   Function   : MakeMemoryBitFile
+*   Description: This function creates a bit file in memory.  A bit file
+*                opened for reading reads the data passed as a parameter,
+*                which must not change or be freed before the bit file is
+*                closed.  A bit file opened for writing or appending starts
+*                empty and grows as needed.
+*   Parameters : data - the data to read (ignored when writing)
+*                size - the number of bytes in data when reading, the
+*                       expected output size (may be 0) when writing
+*                mode - The mode of the bit file
+*   Effects    : A bit_file_t structure will be created for the data.
+*   Returned   : Pointer to the bit_file_t structure for the bit file
+*                or NULL on failure.  errno will be set for all failure
+*                cases.
+***************************************************************************/
+bit_file_t *MakeMemoryBitFile(const void *data, const size_t size,
+    const BF_MODES mode)
+{
+    bit_file_t *bf;
+    unsigned char *block;
+    size_t blockSize;
+
+    if ((mode == BF_READ) && (data == NULL) && (size != 0))
+    {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    bf = (bit_file_t *)malloc(sizeof(bit_file_t));
+
+    if (bf == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (mode == BF_READ)
+    {
+        /* never written, the caller's data is not copied */
+        block = (unsigned char *)data;
+        blockSize = size;
+    }
+    else
+    {
+        blockSize = (size != 0) ? size : BF_BLOCK_SIZE;
+        block = (unsigned char *)malloc(blockSize);
+    }
+
+    if ((block == NULL) && (mode != BF_READ))
+    {
+        /* malloc failed */
+        free(bf);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    InitBitFile(bf, NULL, mode, block, blockSize);
+
+    if (mode == BF_READ)
+    {
+        bf->blockLen = size;
     }
 
     return (bf);
 }
 
+/***************************************************************************
+*   Function   : MakeCallbackBitFile
+*   Description: This function creates a bit file that reads or writes its
+*                bytes through a function instead of a stdio file, a block
+*                of up to blockSize bytes at a time.
+*   Parameters : io - the function reading or writing the blocks
+*                handle - passed to io
+*                blockSize - the size of the block buffer, 0 for the
+*                            default
+*                mode - The mode of the bit file
+*   Effects    : A bit_file_t structure will be created for io.
+*   Returned   : Pointer to the bit_file_t structure for the bit file
+*                or NULL on failure.  errno will be set for all failure
+*                cases.
+***************************************************************************/
+bit_file_t *MakeCallbackBitFile(bit_io_func_t io, void *handle,
+    const size_t blockSize, const BF_MODES mode)
+{
+    bit_file_t *bf;
+    size_t size;
+
+    if (io == NULL)
+    {
+        errno = EBADF;
+        return NULL;
+    }
+
+    size = (blockSize != 0) ? blockSize : BF_BLOCK_SIZE;
+    bf = (bit_file_t *)malloc(sizeof(bit_file_t));
+
+    if ((bf == NULL) || (InitBitFile(bf, NULL, mode,
+        (unsigned char *)malloc(size), size) != 0))
+    {
+        /* malloc failed */
+        free(bf);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    bf->io = io;
+    bf->ioHandle = handle;
+
+    return (bf);
+}
+
+/***************************************************************************
+*   Function   : InitBitFile
+*   Description: This function fills in a newly allocated bit_file_t
+*                structure.
+*   Parameters : bf - the structure to fill in
+*                stream - pointer to the standard file being wrapped, NULL
+*                         for a bit file in memory.
+*                mode - The mode of the file being wrapped.
+*                block - the block buffer
+*                blockSize - the size of block
+*   Effects    : The structure is ready for use.
+*   Returned   : 0 for success, -1 if there is no block buffer.
+***************************************************************************/
+static int InitBitFile(bit_file_t *bf, FILE *stream, const BF_MODES mode,
+    unsigned char *block, const size_t blockSize)
+{
+    bf->fp = stream;
+    bf->io = NULL;
+    bf->ioHandle = NULL;
+    bf->bitBuffer = 0;
+    bf->bitCount = 0;
+    bf->block = block;
+    bf->blockSize = blockSize;
+    bf->blockPos = 0;
+    bf->blockLen = 0;
+    bf->error = 0;
+    bf->mode = mode;
+
+    switch (DetermineEndianess())
+    {
+        case BF_LITTLE_ENDIAN:
+            bf->PutBitsNumFunc = &BitFilePutBitsLE;
+            bf->GetBitsNumFunc = &BitFileGetBitsLE;
+            break;
+
+        case BF_BIG_ENDIAN:
+            bf->PutBitsNumFunc = &BitFilePutBitsBE;
+            bf->GetBitsNumFunc = &BitFileGetBitsBE;
+            break;
+
+        case BF_UNKNOWN_ENDIAN:
+        default:
+            bf->PutBitsNumFunc = BitFileNotSupported;
+            bf->GetBitsNumFunc = BitFileNotSupported;
+            break;
+    }
+
+    return (block == NULL) ? -1 : 0;
+}
+
 /***************************************************************************
 *   Function   : DetermineEndianess
 *   Description: This function determines the endianess of the current
@@ -273,6 +425,182 @@ static endian_t DetermineEndianess(void)
     return endian;
 }
 
+/***************************************************************************
+*   Function   : FillBitBuffer
+*   Description: This function moves whole bytes from the block buffer into
+*                the bit buffer until it is full, reading the next block
+*                from the file when the block buffer runs out.  While the
+*                block buffer holds 8 bytes they are loaded at once.
+*   Parameters : stream - pointer to bit file stream to read from
+*   Effects    : Up to 8 bytes are added to the bit buffer.
+*   Returned   : None.  At the end of the file fewer bits are added.
+***************************************************************************/
+static void FillBitBuffer(bit_file_t *stream)
+{
+    const unsigned char *next;
+    bit_buffer_t word;
+    unsigned int bytes;
+
+    if ((stream->bitCount <= BF_BUFFER_BITS - 8) &&
+        (stream->blockLen - stream->blockPos >= sizeof(bit_buffer_t)))
+    {
+        /* compilers make this a single big endian load */
+        next = stream->block + stream->blockPos;
+        word = ((bit_buffer_t)next[0] << 56) | ((bit_buffer_t)next[1] << 48) |
+            ((bit_buffer_t)next[2] << 40) | ((bit_buffer_t)next[3] << 32) |
+            ((bit_buffer_t)next[4] << 24) | ((bit_buffer_t)next[5] << 16) |
+            ((bit_buffer_t)next[6] << 8) | (bit_buffer_t)next[7];
+
+        bytes = (BF_BUFFER_BITS - stream->bitCount) / 8;
+
+        if (bytes == sizeof(bit_buffer_t))
+        {
+            stream->bitBuffer = word;
+        }
+        else
+        {
+            stream->bitBuffer = (stream->bitBuffer << (bytes * 8)) |
+                (word >> (BF_BUFFER_BITS - bytes * 8));
+        }
+
+        stream->blockPos += bytes;
+        stream->bitCount += bytes * 8;
+        return;
+    }
+
+    while (stream->bitCount <= BF_BUFFER_BITS - 8)
+    {
+        if (stream->blockPos == stream->blockLen)
+        {
+            if (stream->io != NULL)
+            {
+                stream->blockLen = stream->io(stream->ioHandle,
+                    stream->block, stream->blockSize);
+            }
+            else if (stream->fp == NULL)
+            {
+                /* all the data of a bit file in memory is in block */
+                break;
+            }
+            else
+            {
+                stream->blockLen = fread(stream->block, 1, stream->blockSize,
+                    stream->fp);
+            }
+
+            stream->blockPos = 0;
+
+            if (stream->blockLen == 0)
+            {
+                break;
+            }
+        }
+
+        stream->bitBuffer = (stream->bitBuffer << 8) |
+            stream->block[stream->blockPos];
+        stream->blockPos++;
+        stream->bitCount += 8;
+    }
+}
+
+/***************************************************************************
+*   Function   : WriteBlock
+*   Description: This function writes the bytes in the block buffer to the
+*                file, or passes them to io.  A bit file in memory has
+*                neither, the block buffer is doubled instead when it is
+*                full.
+*   Parameters : stream - pointer to bit file stream to write to
+*   Effects    : The block buffer is written and emptied, or grown.
+*   Returned   : 0 for success, EOF if the write fails.
+***************************************************************************/
+static int WriteBlock(bit_file_t *stream)
+{
+    size_t length;
+    unsigned char *block;
+
+    if ((stream->fp == NULL) && (stream->io == NULL))
+    {
+        if (stream->blockPos < stream->blockSize)
+        {
+            return 0;
+        }
+
+        block = (unsigned char *)realloc(stream->block, 2 * stream->blockSize);
+
+        if (block == NULL)
+        {
+            errno = ENOMEM;
+            stream->error = 1;
+            return EOF;
+        }
+
+        stream->block = block;
+        stream->blockSize *= 2;
+        return 0;
+    }
+
+    length = stream->blockPos;
+    stream->blockPos = 0;
+
+    if ((length != 0) && (((stream->io != NULL) ?
+        stream->io(stream->ioHandle, stream->block, length) :
+        fwrite(stream->block, 1, length, stream->fp)) != length))
+    {
+        stream->error = 1;
+        return EOF;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : FlushBitBuffer
+*   Description: This function pads the bits of an incomplete byte in the
+*                bit buffer to a whole byte, and writes it and the block
+*                buffer to the file.
+*   Parameters : stream - pointer to bit file stream to write to
+*                onesFill - non-zero if spare bits are filled with ones
+*   Effects    : The bit buffer and the block buffer are emptied.
+*   Returned   : EOF if the write fails.  Otherwise, the padded byte
+*                written.  -1 if there was no incomplete byte.
+***************************************************************************/
+static int FlushBitBuffer(bit_file_t *stream, const unsigned char onesFill)
+{
+    int returnValue;
+
+    returnValue = -1;
+
+    if (stream->bitCount != 0)
+    {
+        returnValue = (int)((stream->bitBuffer << (8 - stream->bitCount)) &
+            0xFF);
+
+        if (onesFill)
+        {
+            returnValue |= (0xFF >> stream->bitCount);
+        }
+
+        if ((stream->blockPos == stream->blockSize) &&
+            (WriteBlock(stream) == EOF))
+        {
+            return EOF;
+        }
+
+        stream->block[stream->blockPos] = (unsigned char)returnValue;
+        stream->blockPos++;
+    }
+
+    stream->bitBuffer = 0;
+    stream->bitCount = 0;
+
+    if (WriteBlock(stream) == EOF)
+    {
+        returnValue = EOF;
+    }
+
+    return returnValue;
+}
+
 /***************************************************************************
 *   Function   : BitFileClose
 *   Description: This function closes a bit file and frees all associated
@@ -294,11 +622,7 @@ int BitFileClose(bit_file_t *stream)
     if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
     {
         /* write out any unwritten bits */
-        if (stream->bitCount != 0)
-        {
-            (stream->bitBuffer) <<= 8 - (stream->bitCount);
-            fputc(stream->bitBuffer, stream->fp);   /* handle error? */
-        }
+        FlushBitBuffer(stream, 0);      /* handle error? */
     }
 
     /***********************************************************************
@@ -307,9 +631,18 @@ int BitFileClose(bit_file_t *stream)
     ***********************************************************************/
 
     /* close file */
-    returnValue = fclose(stream->fp);
+    if (stream->fp != NULL)
+    {
+        returnValue = fclose(stream->fp);
+    }
 
     /* free memory allocated for bit file */
+    if ((stream->fp != NULL) || (stream->io != NULL) ||
+        (stream->mode != BF_READ))
+    {
+        free(stream->block);
+    }
+
     free(stream);
 
     return(returnValue);
@@ -321,12 +654,16 @@ int BitFileClose(bit_file_t *stream)
 *                returning a pointer to a stdio file.
 *   Parameters : stream - pointer to bit file stream being closed
 *   Effects    : The specified bitfile will be made usable as a stdio
-*                FILE.
+*                FILE.  Whole bytes that were read ahead into the buffers
+*                but not used are given back by seeking the file backwards,
+*                so the file position follows the last byte used (this
+*                fails silently on files that can't seek).
 *   Returned   : Pointer to FILE.  NULL for failure.
 ***************************************************************************/
 FILE *BitFileToFILE(bit_file_t *stream)
 {
     FILE *fp = NULL;
+    long unused;
 
     if (stream == NULL)
     {
@@ -336,10 +673,16 @@ FILE *BitFileToFILE(bit_file_t *stream)
     if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
     {
         /* write out any unwritten bits */
-        if (stream->bitCount != 0)
+        FlushBitBuffer(stream, 0);      /* handle error? */
+    }
+    else if (stream->fp != NULL)
+    {
+        unused = (long)(stream->blockLen - stream->blockPos) +
+            (long)(stream->bitCount / 8);
+
+        if (unused != 0)
         {
-            (stream->bitBuffer) <<= 8 - (stream->bitCount);
-            fputc(stream->bitBuffer, stream->fp);   /* handle error? */
+            fseek(stream->fp, -unused, SEEK_CUR);
         }
     }
 
@@ -352,11 +695,73 @@ FILE *BitFileToFILE(bit_file_t *stream)
     fp = stream->fp;
 
     /* free memory allocated for bit file */
+    if ((stream->fp != NULL) || (stream->io != NULL) ||
+        (stream->mode != BF_READ))
+    {
+        free(stream->block);
+    }
+
     free(stream);
 
     return(fp);
 }
 
+/***************************************************************************
+*   Function   : BitFileToMemory
+*   Description: This function flushes and frees a bit file in memory,
+*                returning its data.
+*   Parameters : stream - pointer to bit file stream being closed
+*                size - set to the number of bytes returned
+*   Effects    : The specified bitfile is freed.  A bit file opened for
+*                writing hands its buffer over to the caller, who must
+*                free() it.  For a bit file opened for reading the bytes
+*                that were not used are returned, they are part of the data
+*                it was made with.
+*   Returned   : Pointer to the data, NULL for failure (or if there is no
+*                data).  errno will be set for all failure cases.
+***************************************************************************/
+unsigned char *BitFileToMemory(bit_file_t *stream, size_t *size)
+{
+    unsigned char *data;
+    size_t unused;
+
+    if ((stream == NULL) || (size == NULL) || (stream->fp != NULL) ||
+        (stream->io != NULL))
+    {
+        errno = EBADF;
+        return(NULL);
+    }
+
+    if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
+    {
+        /* write out any unwritten bits, a failed write sets error */
+        FlushBitBuffer(stream, 0);
+
+        if (stream->error)
+        {
+            /* some of the data was lost */
+            free(stream->block);
+            free(stream);
+            errno = ENOMEM;
+            return(NULL);
+        }
+
+        data = stream->block;
+        *size = stream->blockPos;
+    }
+    else
+    {
+        unused = (stream->blockLen - stream->blockPos) + stream->bitCount / 8;
+        data = (unused == 0) ? NULL :
+            stream->block + (stream->blockLen - unused);
+        *size = unused;
+    }
+
+    free(stream);
+
+    return(data);
+}
+
 /***************************************************************************
 *   Function   : BitFileByteAlign
 *   Description: This function aligns the bitfile to the nearest byte.  For
@@ -366,8 +771,9 @@ FILE *BitFileToFILE(bit_file_t *stream)
 *   Parameters : stream - pointer to bit file stream to align
 *   Effects    : Flushes out the bit buffer.
 *   Returned   : EOF if stream is NULL or write fails.  Writes return the
-*                byte aligned contents of the bit buffer.  Reads returns
-*                the unaligned contents of the bit buffer.
+*                byte aligned contents of the bit buffer, 0 if it was
+*                already aligned.  Reads returns the unaligned contents of
+*                the bit buffer.
 ***************************************************************************/
 int BitFileByteAlign(bit_file_t *stream)
 {
@@ -378,20 +784,30 @@ int BitFileByteAlign(bit_file_t *stream)
         return(EOF);
     }
 
-    returnValue = stream->bitBuffer;
+    /* bits of the incomplete byte */
+    returnValue = (int)(stream->bitBuffer & (0xFF >> (8 - stream->bitCount % 8)));
 
     if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
     {
-        /* write out any unwritten bits */
+        /* write out any unwritten bits.  FlushBitBuffer returns -1 (EOF)
+         * when there is no incomplete byte, so only call it when there is */
         if (stream->bitCount != 0)
         {
-            (stream->bitBuffer) <<= 8 - (stream->bitCount);
-            fputc(stream->bitBuffer, stream->fp);   /* handle error? */
+            if (FlushBitBuffer(stream, 0) == EOF)
+            {
+                returnValue = EOF;
+            }
+        }
+        else if (WriteBlock(stream) == EOF)
+        {
+            returnValue = EOF;
         }
     }
-
-    stream->bitBuffer = 0;
-    stream->bitCount = 0;
+    else
+    {
+        /* whole bytes read ahead are kept */
+        stream->bitCount -= stream->bitCount % 8;
+    }
 
     return (returnValue);
 }
@@ -410,32 +826,96 @@ int BitFileByteAlign(bit_file_t *stream)
 ***************************************************************************/
 int BitFileFlushOutput(bit_file_t *stream, const unsigned char onesFill)
 {
-    int returnValue;
-
     if (stream == NULL)
     {
         return(EOF);
     }
 
-    returnValue = -1;
+    return FlushBitBuffer(stream, onesFill);
+}
 
-    /* write out any unwritten bits */
-    if (stream->bitCount != 0)
+/***************************************************************************
+*   Function   : BitFileGetBitsInt
+*   Description: This function reads the specified number of bits from the
+*                file passed as a parameter into an unsigned int.  The
+*                first bit read is the most significant one.  This is the
+*                fast path that all the other get functions are built on.
+*   Parameters : stream - pointer to bit file stream to read from
+*                value - address to store bits read
+*                count - number of bits to read (at most 32)
+*   Effects    : Reads bits from the bit buffer, refilling it from the
+*                block buffer and the file when it runs low.  If fewer than
+*                count bits are left in the file, the bits left are used
+*                up, so every later read returns EOF too.
+*   Returned   : EOF for failure, otherwise the number of bits read.
+***************************************************************************/
+int BitFileGetBitsInt(bit_file_t *stream, unsigned int *value,
+    const unsigned int count)
+{
+    if ((stream == NULL) || (value == NULL) || (count > BF_INT_BITS))
     {
-        stream->bitBuffer <<= (8 - stream->bitCount);
+        return(EOF);
+    }
 
-        if (onesFill)
+    if (stream->bitCount < count)
+    {
+        FillBitBuffer(stream);
+
+        if (stream->bitCount < count)
         {
-            stream->bitBuffer |= (0xFF >> stream->bitCount);
+            /* short read at end of file */
+            stream->bitCount = 0;
+            return EOF;
         }
+    }
 
-        returnValue = fputc(stream->bitBuffer, stream->fp);
+    stream->bitCount -= count;
+    *value = (unsigned int)((stream->bitBuffer >> stream->bitCount) &
+        (((bit_buffer_t)1 << count) - 1));
+
+    return count;
+}
+
+/***************************************************************************
+*   Function   : BitFilePutBitsInt
+*   Description: This function writes the specified number of low bits of
+*                value to the file passed as a parameter, most significant
+*                bit first.  This is the fast path that all the other put
+*                functions are built on.
+*   Parameters : stream - pointer to bit file stream to write to
+*                value - the bits to write
+*                count - number of bits to write (at most 32)
+*   Effects    : Writes bits to the bit buffer.  Whole bytes are moved to
+*                the block buffer, which is written when it fills up.
+*   Returned   : EOF for failure, otherwise the number of bits written.
+***************************************************************************/
+int BitFilePutBitsInt(bit_file_t *stream, const unsigned int value,
+    const unsigned int count)
+{
+    if ((stream == NULL) || (count > BF_INT_BITS))
+    {
+        return(EOF);
     }
 
-    stream->bitBuffer = 0;
-    stream->bitCount = 0;
+    stream->bitBuffer = (stream->bitBuffer << count) |
+        (value & (((bit_buffer_t)1 << count) - 1));
+    stream->bitCount += count;
 
-    return (returnValue);
+    while (stream->bitCount >= 8)
+    {
+        if ((stream->blockPos == stream->blockSize) &&
+            (WriteBlock(stream) == EOF))
+        {
+            return EOF;
+        }
+
+        stream->bitCount -= 8;
+        stream->block[stream->blockPos] =
+            (unsigned char)(stream->bitBuffer >> stream->bitCount);
+        stream->blockPos++;
+    }
+
+    return count;
 }
 
 /***************************************************************************
@@ -449,36 +929,14 @@ int BitFileFlushOutput(bit_file_t *stream, const unsigned char onesFill)
 ***************************************************************************/
 int BitFileGetChar(bit_file_t *stream)
 {
-    int returnValue;
-    unsigned char tmp;
-
-    if (stream == NULL)
-    {
-        return(EOF);
-    }
-
-    returnValue = fgetc(stream->fp);
-
-    if (stream->bitCount == 0)
-    {
-        /* we can just get byte from file */
-        return returnValue;
-    }
+    unsigned int c;
 
-    /* we have some buffered bits to return too */
-    if (returnValue != EOF)
+    if (BitFileGetBitsInt(stream, &c, 8) == EOF)
     {
-        /* figure out what to return */
-        tmp = ((unsigned char)returnValue) >> (stream->bitCount);
-        tmp |= ((stream->bitBuffer) << (8 - (stream->bitCount)));
-
-        /* put remaining in buffer. count shouldn't change. */
-        stream->bitBuffer = returnValue;
-
-        returnValue = tmp;
+        return EOF;
     }
 
-    return returnValue;
+    return (int)c;
 }
 
 /***************************************************************************
@@ -492,34 +950,12 @@ int BitFileGetChar(bit_file_t *stream)
 ***************************************************************************/
 int BitFilePutChar(const int c, bit_file_t *stream)
 {
-    unsigned char tmp;
-
-    if (stream == NULL)
-    {
-        return(EOF);
-    }
-
-    if (stream->bitCount == 0)
-    {
-        /* we can just put byte from file */
-        return fputc(c, stream->fp);
-    }
-
-    /* figure out what to write */
-    tmp = ((unsigned char)c) >> (stream->bitCount);
-    tmp = tmp | ((stream->bitBuffer) << (8 - stream->bitCount));
-
-    if (fputc(tmp, stream->fp) != EOF)
-    {
-        /* put remaining in buffer. count shouldn't change. */
-        stream->bitBuffer = c;
-    }
-    else
+    if (BitFilePutBitsInt(stream, (unsigned int)c, 8) == EOF)
     {
         return EOF;
     }
 
-    return tmp;
+    return (c & 0xFF);
 }
 
 /***************************************************************************
@@ -529,37 +965,19 @@ int BitFilePutChar(const int c, bit_file_t *stream)
 *                bit buffer.
 *   Parameters : stream - pointer to bit file stream to read from
 *   Effects    : Reads next bit from bit buffer.  If the buffer is empty,
-*                a new byte will be read from the file.
+*                it is refilled from the block buffer.
 *   Returned   : 0 if bit == 0, 1 if bit == 1, and EOF if operation fails.
 ***************************************************************************/
 int BitFileGetBit(bit_file_t *stream)
 {
-    int returnValue;
+    unsigned int bit;
 
-    if (stream == NULL)
-    {
-        return(EOF);
-    }
-
-    if (stream->bitCount == 0)
+    if (BitFileGetBitsInt(stream, &bit, 1) == EOF)
     {
-        /* buffer is empty, read another character */
-        if ((returnValue = fgetc(stream->fp)) == EOF)
-        {
-            return EOF;
-        }
-        else
-        {
-            stream->bitCount = 8;
-            stream->bitBuffer = returnValue;
-        }
+        return EOF;
     }
 
-    /* bit to return is msb in buffer */
-    stream->bitCount--;
-    returnValue = (stream->bitBuffer) >> (stream->bitCount);
-
-    return (returnValue & 0x01);
+    return (int)bit;
 }
 
 /***************************************************************************
@@ -569,40 +987,17 @@ int BitFileGetBit(bit_file_t *stream)
 *   Parameters : c - the bit value to be written
 *                stream - pointer to bit file stream to write to
 *   Effects    : Writes a bit to the bit buffer.  If the buffer has a byte,
-*                the buffer is written to the file and cleared.
+*                the byte is moved to the block buffer.
 *   Returned   : On success, the bit value written, otherwise EOF.
 ***************************************************************************/
 int BitFilePutBit(const int c, bit_file_t *stream)
 {
-    int returnValue = c;
-
-    if (stream == NULL)
-    {
-        return(EOF);
-    }
-
-    stream->bitCount++;
-    stream->bitBuffer <<= 1;
-
-    if (c != 0)
+    if (BitFilePutBitsInt(stream, (c != 0), 1) == EOF)
     {
-        stream->bitBuffer |= 1;
-    }
-
-    /* write bit buffer if we have 8 bits */
-    if (stream->bitCount == 8)
-    {
-        if (fputc(stream->bitBuffer, stream->fp) == EOF)
-        {
-            returnValue = EOF;
-        }
-
-        /* reset buffer */
-        stream->bitCount = 0;
-        stream->bitBuffer = 0;
+        return EOF;
     }
 
-    return returnValue;
+    return c;
 }
 
 /***************************************************************************
@@ -621,8 +1016,9 @@ int BitFilePutBit(const int c, bit_file_t *stream)
 ***************************************************************************/
 int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count)
 {
-    unsigned char *bytes, shifts;
+    unsigned char *bytes;
     int offset, remaining, returnValue;
+    unsigned int value;
 
     bytes = (unsigned char *)bits;
 
@@ -651,26 +1047,13 @@ int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count)
 
     if (remaining != 0)
     {
-        /* read remaining bits */
-        shifts = 8 - remaining;
-        bytes[offset] = 0;
-
-        while (remaining > 0)
+        /* read remaining bits and shift them into position */
+        if (BitFileGetBitsInt(stream, &value, remaining) == EOF)
         {
-            returnValue = BitFileGetBit(stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            bytes[offset] <<= 1;
-            bytes[offset] |= (returnValue & 0x01);
-            remaining--;
+            return EOF;
         }
 
-        /* shift last bits into position */
-        bytes[offset] <<= shifts;
+        bytes[offset] = (unsigned char)(value << (8 - remaining));
     }
 
     return count;
@@ -692,7 +1075,7 @@ int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count)
 ***************************************************************************/
 int BitFilePutBits(bit_file_t *stream, void *bits, const unsigned int count)
 {
-    unsigned char *bytes, tmp;
+    unsigned char *bytes;
     int offset, remaining, returnValue;
 
     bytes = (unsigned char *)bits;
@@ -722,22 +1105,66 @@ int BitFilePutBits(bit_file_t *stream, void *bits, const unsigned int count)
     if (remaining != 0)
     {
         /* write remaining bits */
-        tmp = bytes[offset];
-
-        while (remaining > 0)
+        if (BitFilePutBitsInt(stream, bytes[offset] >> (8 - remaining),
+            remaining) == EOF)
         {
-            returnValue = BitFilePutBit((tmp & 0x80), stream);
+            return EOF;
+        }
+    }
 
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
+    return count;
+}
 
-            tmp <<= 1;
-            remaining--;
-        }
+/***************************************************************************
+*   Function   : BitFilePeekBits
+*   Description: This function fills the bit buffer and returns the bits
+*                in it without reading them, so that a caller can take
+*                several fields with shifts before it skips them with
+*                BitFileSkipBits.
+*   Parameters : stream - pointer to bit file stream to read from
+*                bits - set to the bits, the next one the msb
+*   Effects    : The bit buffer is filled from the file.
+*   Returned   : The number of bits in bits.  It is more than
+*                BF_BUFFER_BITS - 8 unless the end of the file is reached.
+***************************************************************************/
+unsigned int BitFilePeekBits(bit_file_t *stream, unsigned long long *bits)
+{
+    if ((stream == NULL) || (bits == NULL))
+    {
+        return 0;
+    }
+
+    FillBitBuffer(stream);
+
+    if (stream->bitCount == 0)
+    {
+        *bits = 0;
+    }
+    else
+    {
+        *bits = stream->bitBuffer << (BF_BUFFER_BITS - stream->bitCount);
     }
 
+    return stream->bitCount;
+}
+
+/***************************************************************************
+*   Function   : BitFileSkipBits
+*   Description: This function reads bits returned by BitFilePeekBits.
+*   Parameters : stream - pointer to bit file stream to read from
+*                count - number of bits to skip
+*   Effects    : count bits are removed from the bit buffer.
+*   Returned   : EOF if the bit buffer holds fewer than count bits,
+*                otherwise count.
+***************************************************************************/
+int BitFileSkipBits(bit_file_t *stream, const unsigned int count)
+{
+    if ((stream == NULL) || (count > stream->bitCount))
+    {
+        return EOF;
+    }
+
+    stream->bitCount -= count;
     return count;
 }
 
@@ -795,6 +1222,7 @@ static int BitFileGetBitsLE(bit_file_t *stream, void *bits,
 {
     unsigned char *bytes;
     int offset, remaining, returnValue;
+    unsigned int value;
 
     (void)size;
     bytes = (unsigned char *)bits;
@@ -819,20 +1247,12 @@ static int BitFileGetBitsLE(bit_file_t *stream, void *bits,
     if (remaining != 0)
     {
         /* read remaining bits */
-        while (remaining > 0)
+        if (BitFileGetBitsInt(stream, &value, remaining) == EOF)
         {
-            returnValue = BitFileGetBit(stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            bytes[offset] <<= 1;
-            bytes[offset] |= (returnValue & 0x01);
-            remaining--;
+            return EOF;
         }
 
+        bytes[offset] = (unsigned char)((bytes[offset] << remaining) | value);
     }
 
     return count;
@@ -859,6 +1279,7 @@ static int BitFileGetBitsBE(bit_file_t *stream, void *bits,
 {
     unsigned char *bytes;
     int offset, remaining, returnValue;
+    unsigned int value;
 
     if (count > (size * 8))
     {
@@ -889,20 +1310,12 @@ static int BitFileGetBitsBE(bit_file_t *stream, void *bits,
     if (remaining != 0)
     {
         /* read remaining bits */
-        while (remaining > 0)
+        if (BitFileGetBitsInt(stream, &value, remaining) == EOF)
         {
-            returnValue = BitFileGetBit(stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            bytes[offset] <<= 1;
-            bytes[offset] |= (returnValue & 0x01);
-            remaining--;
+            return EOF;
         }
 
+        bytes[offset] = (unsigned char)((bytes[offset] << remaining) | value);
     }
 
     return count;
@@ -962,7 +1375,7 @@ int BitFilePutBitsNum(bit_file_t *stream, void *bits, const unsigned int count,
 static int BitFilePutBitsLE(bit_file_t *stream, void *bits,
     const unsigned int count, const size_t size)
 {
-    unsigned char *bytes, tmp;
+    unsigned char *bytes;
     int offset, remaining, returnValue;
 
     (void)size;
@@ -987,20 +1400,9 @@ static int BitFilePutBitsLE(bit_file_t *stream, void *bits,
     if (remaining != 0)
     {
         /* write remaining bits */
-        tmp = bytes[offset];
-        tmp <<= (8 - remaining);
-
-        while (remaining > 0)
+        if (BitFilePutBitsInt(stream, bytes[offset], remaining) == EOF)
         {
-            returnValue = BitFilePutBit((tmp & 0x80), stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            tmp <<= 1;
-            remaining--;
+            return EOF;
         }
     }
 
@@ -1025,7 +1427,7 @@ static int BitFilePutBitsLE(bit_file_t *stream, void *bits,
 static int BitFilePutBitsBE(bit_file_t *stream, void *bits,
     const unsigned int count, const size_t size)
 {
-    unsigned char *bytes, tmp;
+    unsigned char *bytes;
     int offset, remaining, returnValue;
 
     if (count > (size * 8))
@@ -1055,20 +1457,9 @@ static int BitFilePutBitsBE(bit_file_t *stream, void *bits,
     if (remaining != 0)
     {
         /* write remaining bits */
-        tmp = bytes[offset];
-        tmp <<= (8 - remaining);
-
-        while (remaining > 0)
+        if (BitFilePutBitsInt(stream, bytes[offset], remaining) == EOF)
         {
-            returnValue = BitFilePutBit((tmp & 0x80), stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            tmp <<= 1;
-            remaining--;
+            return EOF;
         }
     }
 
@@ -58,6 +58,14 @@ typedef enum
 struct bit_file_t;
 typedef struct bit_file_t bit_file_t;
 
+/***************************************************************************
+* reads up to size bytes into data or writes the size bytes at data for a
+* bit file made by MakeCallbackBitFile, returning the number of bytes moved.
+* A read returning 0 is the end of the file, a short write an error.
+***************************************************************************/
+typedef size_t (*bit_io_func_t)(void *handle, unsigned char *data,
+    size_t size);
+
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
@@ -68,6 +76,16 @@ bit_file_t *MakeBitFile(FILE *stream, const BF_MODES mode);
 int BitFileClose(bit_file_t *stream);
 FILE *BitFileToFILE(bit_file_t *stream);
 
+/* open/close a bit file in memory */
+bit_file_t *MakeMemoryBitFile(const void *data, const size_t size,
+    const BF_MODES mode);
+unsigned char *BitFileToMemory(bit_file_t *stream, size_t *size);
+
+/* open a bit file that reads/writes blocks through a function, close it
+ * with BitFileClose */
+bit_file_t *MakeCallbackBitFile(bit_io_func_t io, void *handle,
+    const size_t blockSize, const BF_MODES mode);
+
 /* toss spare bits and byte align file */
 int BitFileByteAlign(bit_file_t *stream);
 
@@ -82,10 +100,21 @@ int BitFilePutChar(const int c, bit_file_t *stream);
 int BitFileGetBit(bit_file_t *stream);
 int BitFilePutBit(const int c, bit_file_t *stream);
 
+/* get/put up to 32 bits as an unsigned int (most significant bit first) */
+int BitFileGetBitsInt(bit_file_t *stream, unsigned int *value,
+    const unsigned int count);
+int BitFilePutBitsInt(bit_file_t *stream, const unsigned int value,
+    const unsigned int count);
+
 /* get/put number of bits (most significant bit to least significat bit) */
 int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count);
 int BitFilePutBits(bit_file_t *stream, void *bits, const unsigned int count);
 
+/* look at the next bits (at least 57 before the end of the file, the next
+ * one is the msb) and skip the ones used, to take several fields at once */
+unsigned int BitFilePeekBits(bit_file_t *stream, unsigned long long *bits);
+int BitFileSkipBits(bit_file_t *stream, const unsigned int count);
+
 /***************************************************************************
 * get/put a number of bits from numerical types (short, int, long, ...)
 *
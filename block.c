@@ -0,0 +1,1313 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : block.c
+*   Purpose : Split a file into independent blocks, encode, decode, check
+*             or search them on several threads, and keep them in a
+*             container with a table of the blocks.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "lzss.h"
+#include "lzlocal.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/***************************************************************************
+* A block file is
+*   header  - "LZSB", version, format, OFFSET_BITS, LENGTH_BITS, SLIDE_BITS,
+*             the character the window is filled with, two reserved bytes
+*             and the checksum of the header
+*   blocks  - every block encoded on its own, one after the other
+*   index   - for every block the offset of its data in the file, the size
+*             of its data, its size before encoding, the checksum of its
+*             data and the checksum of the block before encoding
+*   trailer - offset of the index, number of blocks, block size, checksum
+*             of the index and "LZSB"
+* All the numbers are little endian and the checksums are Checksum32 with
+* seed 0.  The index is at the end so the blocks can be written as soon as
+* they are encoded, and found from the end.
+*
+* Version 1 files have an 8 byte header with only the magic, version and
+* format, no checksums, and were written with the default bit widths.
+* They are still read.
+***************************************************************************/
+#define BLOCK_MAGIC         "LZSB"
+#define BLOCK_VERSION       2
+#define BLOCK_FILL          '~'
+
+#define HEADER_SIZE         16
+#define ENTRY_SIZE          24
+#define TRAILER_SIZE        24
+
+#define V1_HEADER_SIZE      8
+#define V1_ENTRY_SIZE       16
+#define V1_TRAILER_SIZE     20
+
+/* blocks encoded or decoded together, for every thread */
+#define JOBS_PER_THREAD     2
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/* an entry of the block index */
+typedef struct block_entry_t
+{
+	unsigned long long offset;  /* offset of the block data in the file */
+	unsigned long compSize;     /* size of the block data */
+	unsigned long size;         /* size of the block before encoding */
+	unsigned long compSum;      /* checksum of the block data */
+	unsigned long sum;          /* checksum of the block before encoding */
+} block_entry_t;
+
+/* what the header and trailer of a block file tell */
+typedef struct block_info_t
+{
+	block_format_t format;
+	unsigned int version;
+	unsigned long count;        /* number of blocks */
+	unsigned long blockSize;
+} block_info_t;
+
+/* a block waiting for a thread to encode, decode or search it */
+typedef struct block_job_t
+{
+	unsigned char *in;
+	size_t inSize;
+	unsigned char *out;         /* allocated by the stage */
+	size_t outSize;
+	int result;
+	int error;                  /* errno of a stage that failed */
+
+	/* checksums of in and out, and the checksum in is expected to have */
+	unsigned long inSum, outSum, expect;
+
+	/* offsets of the occurrences in the block and the ends of the block */
+	unsigned long long *match;
+	unsigned long matchCount, matchRoom;
+	search_edge_t edge;
+} block_job_t;
+
+/***************************************************************************
+* The jobs of a pool are taken in order by the threads that run it.  next is
+* the next job no thread took yet.  run does a job, with the stage or the
+* pattern of the pool.  With verify set, a job whose input does not have the
+* expected checksum fails without being run.
+***************************************************************************/
+typedef struct block_pool_t
+{
+	void (*run)(struct block_pool_t *pool, block_job_t *job);
+	buffer_func_t stage;
+	int verify;
+	const unsigned char *pattern;
+	size_t m;
+	block_job_t *jobs;
+	unsigned int count;
+	unsigned int next;
+	pthread_mutex_t lock;
+} block_pool_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int CountThreads(unsigned int threads);
+static void *PoolWorker(void *arg);
+static void RunPool(block_pool_t *pool, unsigned int threads);
+static void RunStage(block_pool_t *pool, block_job_t *job);
+static void RunSearch(block_pool_t *pool, block_job_t *job);
+static void RunVerify(block_pool_t *pool, block_job_t *job);
+static int CheckInput(block_pool_t *pool, block_job_t *job);
+static void CollectMatch(unsigned long long offset, void *userData);
+
+static int EncodeSlideBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize);
+static int EncodeCheckedProjectBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize);
+
+static void PutNumber(unsigned char *buffer, unsigned long long value,
+	const unsigned int bytes);
+static unsigned long long GetNumber(const unsigned char *buffer,
+	const unsigned int bytes);
+static int ReadIndex(FILE *fpIn, block_info_t *info, block_entry_t **index);
+static int ReadWave(FILE *fpIn, const block_entry_t *index,
+	unsigned long first, block_pool_t *pool);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : CountThreads
+*   Description: This function chooses the number of threads to use.
+*   Parameters : threads - the number of threads asked for, 0 for one
+*                          thread on every online processor
+*   Effects    : None
+*   Returned   : The number of threads, at least 1.
+****************************************************************************/
+static unsigned int CountThreads(unsigned int threads)
+{
+	long online;
+
+	if (threads != 0)
+	{
+		return threads;
+	}
+
+	online = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	online = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return (online > 0) ? (unsigned int)online : 1;
+}
+
+/****************************************************************************
+*   Function   : PoolWorker
+*   Description: This function does the jobs of a pool until no job is
+*				 left.
+*   Parameters : arg - the pool
+*   Effects    : The jobs taken are done and their result is set.
+*   Returned   : NULL
+****************************************************************************/
+static void *PoolWorker(void *arg)
+{
+	block_pool_t *pool = (block_pool_t *)arg;
+	block_job_t *job;
+	unsigned int i;
+
+	while (1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		i = pool->next;
+
+		if (i < pool->count)
+		{
+			pool->next++;
+		}
+
+		pthread_mutex_unlock(&pool->lock);
+
+		if (i >= pool->count)
+		{
+			break;
+		}
+
+		job = &pool->jobs[i];
+		pool->run(pool, job);
+	}
+
+	return NULL;
+}
+
+/****************************************************************************
+*   Function   : RunPool
+*   Description: This function runs the jobs of a pool on up to threads
+*				 threads, the calling thread being one of them.  If a
+*				 thread can't be created the others do its jobs.
+*   Parameters : pool - the pool, with its stage, jobs and count set
+*                threads - the number of threads to use
+*   Effects    : Every job of the pool is done and its result is set.
+*   Returned   : None
+****************************************************************************/
+static void RunPool(block_pool_t *pool, unsigned int threads)
+{
+	pthread_t *thread;
+	unsigned int i, created;
+
+	pool->next = 0;
+
+	if (threads > pool->count)
+	{
+		threads = pool->count;
+	}
+
+	thread = NULL;
+	created = 0;
+
+	if (threads > 1)
+	{
+		thread = (pthread_t *)malloc((threads - 1) * sizeof(pthread_t));
+	}
+
+	for (i = 1; (thread != NULL) && (i < threads); i++)
+	{
+		if (pthread_create(&thread[created], NULL, PoolWorker, pool) == 0)
+		{
+			created++;
+		}
+	}
+
+	PoolWorker(pool);
+
+	for (i = 0; i < created; i++)
+	{
+		pthread_join(thread[i], NULL);
+	}
+
+	free(thread);
+}
+
+/****************************************************************************
+*   Function   : RunStage
+*   Description: This function encodes or decodes a block with the stage
+*				 of a pool.
+*   Parameters : pool - the pool
+*                job - the block
+*   Effects    : The output, checksums and result of the job are set.
+*   Returned   : None
+****************************************************************************/
+static void RunStage(block_pool_t *pool, block_job_t *job)
+{
+	if (CheckInput(pool, job) != 0)
+	{
+		return;
+	}
+
+	job->result = pool->stage(job->in, job->inSize, &job->out,
+		&job->outSize);
+
+	if (0 == job->result)
+	{
+		job->outSum = Checksum32(job->out, job->outSize, 0);
+	}
+	else
+	{
+		/* errno belongs to the thread, keep it for the caller */
+		job->error = errno;
+	}
+}
+
+/****************************************************************************
+*   Function   : RunSearch
+*   Description: This function searches a block for the pattern of a pool.
+*   Parameters : pool - the pool
+*                job - the block
+*   Effects    : The occurrences, ends and result of the job are set.
+*   Returned   : None
+****************************************************************************/
+static void RunSearch(block_pool_t *pool, block_job_t *job)
+{
+	job->matchCount = 0;
+
+	if (CheckInput(pool, job) != 0)
+	{
+		return;
+	}
+
+	if (SearchSegment(job->in, job->inSize, pool->pattern, pool->m,
+		CollectMatch, job, &job->edge) < 0)
+	{
+		job->result = -1;
+	}
+}
+
+/****************************************************************************
+*   Function   : RunVerify
+*   Description: This function checks the data of a block against its
+*				 checksum, without decoding it.
+*   Parameters : pool - the pool
+*                job - the block
+*   Effects    : The result of the job is set, -1 if the data is damaged.
+*   Returned   : None
+****************************************************************************/
+static void RunVerify(block_pool_t *pool, block_job_t *job)
+{
+	(void)pool;
+	job->inSum = Checksum32(job->in, job->inSize, 0);
+	job->result = (job->inSum == job->expect) ? 0 : -1;
+}
+
+/****************************************************************************
+*   Function   : CheckInput
+*   Description: This function computes the checksum of the input of a job
+*				 and, if the pool verifies its input, compares it with the
+*				 expected one.
+*   Parameters : pool - the pool
+*                job - the block
+*   Effects    : The input checksum of the job is set.  Its result is set
+*                to -1 if the input is damaged, 0 if not.
+*   Returned   : The result of the job.
+****************************************************************************/
+static int CheckInput(block_pool_t *pool, block_job_t *job)
+{
+	job->inSum = Checksum32(job->in, job->inSize, 0);
+	job->result = (pool->verify && (job->inSum != job->expect)) ? -1 : 0;
+
+	return job->result;
+}
+
+/****************************************************************************
+*   Function   : EncodeSlideBuf
+*   Description: This function encodes a block with EncodeLZSS and adds the
+*				 slide parameter with AddSlide, for BLOCK_SLIDE.
+*   Parameters : in, inSize, out, outSize - as for EncodeLZSSBuf
+*   Effects    : *out is allocated with the encoded block.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int EncodeSlideBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	unsigned char *lzss;
+	size_t lzssSize;
+	int result;
+
+	if (EncodeLZSSBuf(in, inSize, &lzss, &lzssSize) != 0)
+	{
+		return -1;
+	}
+
+	result = AddSlideBuf(lzss, lzssSize, out, outSize);
+	free(lzss);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : EncodeCheckedProjectBuf
+*   Description: This function encodes a block with EncodeProject and
+*				 decodes it back, for BLOCK_PROJECT.  The project format
+*				 can't hold every text: a slide that does not fit in
+*				 SLIDE_BITS or a pointer into the characters before the
+*				 text is lost, so a block is only written if it decodes.
+*   Parameters : in, inSize, out, outSize - as for EncodeProjectBuf
+*   Effects    : *out is allocated with the encoded block.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to ENOTSUP for a block the project
+*                format can't hold.
+****************************************************************************/
+static int EncodeCheckedProjectBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	unsigned char *decoded;
+	size_t decodedSize;
+	int same;
+
+	if (EncodeProjectBuf(in, inSize, out, outSize) != 0)
+	{
+		return -1;
+	}
+
+	if (DecodeProjectBuf(*out, *outSize, &decoded, &decodedSize) != 0)
+	{
+		free(*out);
+		*out = NULL;
+		return -1;
+	}
+
+	same = (decodedSize == inSize) && (memcmp(decoded, in, inSize) == 0);
+	free(decoded);
+
+	if (!same)
+	{
+		free(*out);
+		*out = NULL;
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : CollectMatch
+*   Description: This function keeps the offset of an occurrence found in
+*				 a block, to be reported once the blocks before it are.
+*   Parameters : offset - offset of the occurrence in the block
+*                userData - the job of the block
+*   Effects    : The offset is added to the job.  If there is no room for
+*                it the result of the job is set to -1.
+*   Returned   : None
+****************************************************************************/
+static void CollectMatch(unsigned long long offset, void *userData)
+{
+	block_job_t *job = (block_job_t *)userData;
+	unsigned long long *bigger;
+	unsigned long room;
+
+	if (job->matchCount == job->matchRoom)
+	{
+		room = (job->matchRoom == 0) ? 256 : (2 * job->matchRoom);
+		bigger = (unsigned long long *)realloc(job->match,
+			room * sizeof(unsigned long long));
+
+		if (NULL == bigger)
+		{
+			errno = ENOMEM;
+			job->result = -1;
+			return;
+		}
+
+		job->match = bigger;
+		job->matchRoom = room;
+	}
+
+	job->match[job->matchCount++] = offset;
+}
+
+/****************************************************************************
+*   Function   : PutNumber
+*   Description: This function stores a number in little endian order.
+*   Parameters : buffer - where to store the number
+*                value - the number
+*                bytes - the number of bytes to store
+*   Effects    : bytes bytes of buffer are written.
+*   Returned   : None
+****************************************************************************/
+static void PutNumber(unsigned char *buffer, unsigned long long value,
+	const unsigned int bytes)
+{
+	unsigned int i;
+
+	for (i = 0; i < bytes; i++)
+	{
+		buffer[i] = (unsigned char)(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+/****************************************************************************
+*   Function   : GetNumber
+*   Description: This function reads a number stored by PutNumber.
+*   Parameters : buffer - where the number is stored
+*                bytes - the number of bytes of the number
+*   Effects    : None
+*   Returned   : The number.
+****************************************************************************/
+static unsigned long long GetNumber(const unsigned char *buffer,
+	const unsigned int bytes)
+{
+	unsigned long long value;
+	unsigned int i;
+
+	value = 0;
+
+	for (i = bytes; i > 0; i--)
+	{
+		value = (value << 8) | buffer[i - 1];
+	}
+
+	return value;
+}
+
+/****************************************************************************
+*   Function   : EncodeBlocks
+*   Description: This function splits an input file into blocks of
+*				 blockSize bytes and encodes every block on its own, with
+*				 the window filled as EncodeLZSS fills it.  The blocks are
+*				 encoded by a pool of threads, a few blocks for every
+*				 thread at a time, and written in order to a block file.
+*   Parameters : fpIn - pointer to the open binary file to encode
+*                fpOut - pointer to the open binary file to write the block
+*                        file
+*                format - BLOCK_LZSS to encode the blocks with EncodeLZSS,
+*                         BLOCK_PROJECT to encode them with EncodeProject
+*                         and check that they decode,
+*                         BLOCK_SLIDE to encode them with EncodeLZSS and
+*                         AddSlide
+*                blockSize - size of a block, up to BLOCK_MAX_SIZE
+*                threads - number of threads, 0 for one on every processor
+*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to ENOTSUP for a BLOCK_PROJECT block
+*                the project format can't hold.
+****************************************************************************/
+int EncodeBlocks(FILE *fpIn, FILE *fpOut, block_format_t format,
+	size_t blockSize, unsigned int threads)
+{
+	block_pool_t pool;
+	block_job_t *jobs;
+	block_entry_t *index, *bigger;
+	unsigned char buffer[TRAILER_SIZE], *table;
+	unsigned long count, room, i;
+	unsigned long long offset;
+	unsigned int j, waveSize;
+	int result, last;
+
+	/* validate arguments */
+	if ((NULL == fpIn) || (NULL == fpOut))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (((format != BLOCK_LZSS) && (format != BLOCK_PROJECT) &&
+		(format != BLOCK_SLIDE)) ||
+		(blockSize == 0) || (blockSize > BLOCK_MAX_SIZE))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	threads = CountThreads(threads);
+	waveSize = threads * JOBS_PER_THREAD;
+
+	jobs = (block_job_t *)calloc(waveSize, sizeof(block_job_t));
+	room = 64;
+	index = (block_entry_t *)malloc(room * sizeof(block_entry_t));
+
+	if ((NULL == jobs) || (NULL == index))
+	{
+		free(jobs);
+		free(index);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	pool.run = RunStage;
+	pool.stage = (format == BLOCK_LZSS) ? EncodeLZSSBuf :
+		((format == BLOCK_PROJECT) ? EncodeCheckedProjectBuf :
+		EncodeSlideBuf);
+	pool.verify = 0;
+	pool.jobs = jobs;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	/* header */
+	memcpy(buffer, BLOCK_MAGIC, 4);
+	buffer[4] = BLOCK_VERSION;
+	buffer[5] = (unsigned char)format;
+	buffer[6] = OFFSET_BITS;
+	buffer[7] = LENGTH_BITS;
+	buffer[8] = SLIDE_BITS;
+	buffer[9] = BLOCK_FILL;
+	buffer[10] = 0;
+	buffer[11] = 0;
+	PutNumber(buffer + 12, Checksum32(buffer, 12, 0), 4);
+	result = (fwrite(buffer, 1, HEADER_SIZE, fpOut) == HEADER_SIZE) ? 0 : -1;
+
+	offset = HEADER_SIZE;
+	count = 0;
+	last = 0;
+
+	while ((0 == result) && !last)
+	{
+		/* read the blocks of the next wave */
+		for (pool.count = 0; pool.count < waveSize; pool.count++)
+		{
+			if (NULL == jobs[pool.count].in)
+			{
+				jobs[pool.count].in = (unsigned char *)malloc(blockSize);
+
+				if (NULL == jobs[pool.count].in)
+				{
+					errno = ENOMEM;
+					result = -1;
+					break;
+				}
+			}
+
+			jobs[pool.count].inSize = fread(jobs[pool.count].in, 1,
+				blockSize, fpIn);
+
+			if (jobs[pool.count].inSize < blockSize)
+			{
+				if (ferror(fpIn))
+				{
+					errno = EIO;
+					result = -1;
+					break;
+				}
+
+				/* the last block, if it isn't empty */
+				last = 1;
+
+				if (jobs[pool.count].inSize != 0)
+				{
+					pool.count++;
+				}
+
+				break;
+			}
+		}
+
+		if ((result != 0) || (0 == pool.count))
+		{
+			break;
+		}
+
+		RunPool(&pool, threads);
+
+		/* write the blocks in order */
+		for (j = 0; j < pool.count; j++)
+		{
+			if ((0 == result) && (jobs[j].result != 0))
+			{
+				errno = jobs[j].error;
+				result = -1;
+			}
+
+			if ((0 == result) && (count == room))
+			{
+				bigger = (block_entry_t *)realloc(index,
+					2 * room * sizeof(block_entry_t));
+
+				if (NULL == bigger)
+				{
+					errno = ENOMEM;
+					result = -1;
+				}
+				else
+				{
+					index = bigger;
+					room *= 2;
+				}
+			}
+
+			if ((0 == result) && (fwrite(jobs[j].out, 1, jobs[j].outSize,
+				fpOut) != jobs[j].outSize))
+			{
+				result = -1;
+			}
+
+			if (0 == result)
+			{
+				index[count].offset = offset;
+				index[count].compSize = (unsigned long)jobs[j].outSize;
+				index[count].size = (unsigned long)jobs[j].inSize;
+				index[count].compSum = jobs[j].outSum;
+				index[count].sum = jobs[j].inSum;
+				offset += jobs[j].outSize;
+				count++;
+			}
+
+			free(jobs[j].out);
+			jobs[j].out = NULL;
+		}
+	}
+
+	/* index and trailer */
+	table = (0 == result) ?
+		(unsigned char *)malloc(count * ENTRY_SIZE + 1) : NULL;
+
+	if ((0 == result) && (NULL == table))
+	{
+		errno = ENOMEM;
+		result = -1;
+	}
+
+	for (i = 0; (0 == result) && (i < count); i++)
+	{
+		PutNumber(table + i * ENTRY_SIZE, index[i].offset, 8);
+		PutNumber(table + i * ENTRY_SIZE + 8, index[i].compSize, 4);
+		PutNumber(table + i * ENTRY_SIZE + 12, index[i].size, 4);
+		PutNumber(table + i * ENTRY_SIZE + 16, index[i].compSum, 4);
+		PutNumber(table + i * ENTRY_SIZE + 20, index[i].sum, 4);
+	}
+
+	if ((0 == result) &&
+		(fwrite(table, 1, count * ENTRY_SIZE, fpOut) != count * ENTRY_SIZE))
+	{
+		result = -1;
+	}
+
+	if (0 == result)
+	{
+		PutNumber(buffer, offset, 8);
+		PutNumber(buffer + 8, count, 4);
+		PutNumber(buffer + 12, blockSize, 4);
+		PutNumber(buffer + 16, Checksum32(table, count * ENTRY_SIZE, 0), 4);
+		memcpy(buffer + 20, BLOCK_MAGIC, 4);
+
+		if (fwrite(buffer, 1, TRAILER_SIZE, fpOut) != TRAILER_SIZE)
+		{
+			result = -1;
+		}
+	}
+
+	for (j = 0; j < waveSize; j++)
+	{
+		free(jobs[j].in);
+	}
+
+	pthread_mutex_destroy(&pool.lock);
+	free(table);
+	free(jobs);
+	free(index);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : ReadIndex
+*   Description: This function reads the header, trailer and index of a
+*				 block file and checks that they agree with each other, and
+*				 with their checksums.  A file written with other bit
+*				 widths or another window fill can't be decoded here.
+*   Parameters : fpIn - pointer to the open block file, which has to be
+*                       seekable
+*                info - set to what the header and trailer tell
+*                index - set to the allocated index, which the caller has
+*                        to free
+*   Effects    : The file position of fpIn is changed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to ENOTSUP for a file written with
+*                other parameters.
+****************************************************************************/
+static int ReadIndex(FILE *fpIn, block_info_t *info, block_entry_t **index)
+{
+	unsigned char buffer[TRAILER_SIZE], *table, *field;
+	unsigned long long indexOffset, end;
+	unsigned long i, entrySize, trailerSize, headerSize, tableSum;
+	block_entry_t *entry;
+
+	*index = NULL;
+
+	/* header */
+	if ((fseek(fpIn, 0, SEEK_SET) != 0) ||
+		(fread(buffer, 1, V1_HEADER_SIZE, fpIn) != V1_HEADER_SIZE) ||
+		(memcmp(buffer, BLOCK_MAGIC, 4) != 0) ||
+		((buffer[4] != 1) && (buffer[4] != BLOCK_VERSION)) ||
+		((buffer[5] != BLOCK_LZSS) && (buffer[5] != BLOCK_PROJECT) &&
+		((buffer[5] != BLOCK_SLIDE) || (buffer[4] == 1))))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	info->version = buffer[4];
+	info->format = (block_format_t)buffer[5];
+
+	if (1 == info->version)
+	{
+		headerSize = V1_HEADER_SIZE;
+		entrySize = V1_ENTRY_SIZE;
+		trailerSize = V1_TRAILER_SIZE;
+	}
+	else
+	{
+		headerSize = HEADER_SIZE;
+		entrySize = ENTRY_SIZE;
+		trailerSize = TRAILER_SIZE;
+
+		if ((fread(buffer + V1_HEADER_SIZE, 1, HEADER_SIZE - V1_HEADER_SIZE,
+			fpIn) != HEADER_SIZE - V1_HEADER_SIZE) ||
+			(GetNumber(buffer + 12, 4) != Checksum32(buffer, 12, 0)))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		if ((buffer[6] != OFFSET_BITS) || (buffer[7] != LENGTH_BITS) ||
+			(buffer[8] != SLIDE_BITS) || (buffer[9] != BLOCK_FILL))
+		{
+			errno = ENOTSUP;
+			return -1;
+		}
+	}
+
+	/* trailer */
+	if ((fseek(fpIn, -(long)trailerSize, SEEK_END) != 0) ||
+		(fread(buffer, 1, trailerSize, fpIn) != trailerSize) ||
+		(memcmp(buffer + trailerSize - 4, BLOCK_MAGIC, 4) != 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	indexOffset = GetNumber(buffer, 8);
+	info->count = (unsigned long)GetNumber(buffer + 8, 4);
+	info->blockSize = (unsigned long)GetNumber(buffer + 12, 4);
+	tableSum = (unsigned long)GetNumber(buffer + 16, 4);
+	end = (unsigned long long)ftell(fpIn) - trailerSize;
+
+	if ((indexOffset < headerSize) ||
+		(end - indexOffset != (unsigned long long)info->count * entrySize) ||
+		(fseek(fpIn, (long)indexOffset, SEEK_SET) != 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	*index = (block_entry_t *)malloc((info->count + 1) *
+		sizeof(block_entry_t));
+	table = (unsigned char *)malloc(info->count * entrySize + 1);
+
+	if ((NULL == *index) || (NULL == table))
+	{
+		free(*index);
+		free(table);
+		*index = NULL;
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if ((fread(table, 1, info->count * entrySize, fpIn) !=
+		info->count * entrySize) ||
+		((info->version != 1) &&
+		(Checksum32(table, info->count * entrySize, 0) != tableSum)))
+	{
+		free(*index);
+		free(table);
+		*index = NULL;
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the blocks follow each other between the header and the index */
+	end = headerSize;
+
+	for (i = 0; i < info->count; i++)
+	{
+		entry = &(*index)[i];
+		field = table + i * entrySize;
+
+		entry->offset = GetNumber(field, 8);
+		entry->compSize = (unsigned long)GetNumber(field + 8, 4);
+		entry->size = (unsigned long)GetNumber(field + 12, 4);
+		entry->compSum = (1 == info->version) ? 0 :
+			(unsigned long)GetNumber(field + 16, 4);
+		entry->sum = (1 == info->version) ? 0 :
+			(unsigned long)GetNumber(field + 20, 4);
+
+		if ((entry->offset != end) || (entry->size > info->blockSize) ||
+			(entry->offset + entry->compSize > indexOffset))
+		{
+			free(*index);
+			free(table);
+			*index = NULL;
+			errno = EINVAL;
+			return -1;
+		}
+
+		end += entry->compSize;
+	}
+
+	free(table);
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : ReadWave
+*   Description: This function reads the data of the blocks a pool works on
+*				 next.
+*   Parameters : fpIn - pointer to the open block file
+*                index - the index of the file
+*                first - the first block to read
+*                pool - the pool, with count set to the number of blocks
+*   Effects    : The input, size and expected checksum of the jobs are
+*                set.  The inputs are allocated, also when reading fails.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int ReadWave(FILE *fpIn, const block_entry_t *index,
+	unsigned long first, block_pool_t *pool)
+{
+	block_job_t *job;
+	unsigned int j;
+
+	for (j = 0; j < pool->count; j++)
+	{
+		job = &pool->jobs[j];
+		job->inSize = index[first + j].compSize;
+		job->expect = index[first + j].compSum;
+		job->in = (unsigned char *)malloc(job->inSize + 1);
+
+		if (NULL == job->in)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+
+		if ((fseek(fpIn, (long)index[first + j].offset, SEEK_SET) != 0) ||
+			(fread(job->in, 1, job->inSize, fpIn) != job->inSize))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : DecodeBlocks
+*   Description: This function decodes a block file written by
+*				 EncodeBlocks.  The blocks are decoded by a pool of
+*				 threads, a few blocks for every thread at a time, and
+*				 written in order.  The data of every block is checked
+*				 against its checksum before it is decoded, and the
+*				 decoded block after.
+*   Parameters : fpIn - pointer to the open block file, which has to be
+*                       seekable
+*                fpOut - pointer to the open binary file to write decoded
+*                        output
+*                threads - number of threads, 0 for one on every processor
+*   Effects    : fpIn is decoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int DecodeBlocks(FILE *fpIn, FILE *fpOut, unsigned int threads)
+{
+	block_pool_t pool;
+	block_job_t *jobs;
+	block_entry_t *index;
+	block_info_t info;
+	unsigned long first;
+	unsigned int j, waveSize;
+	int result;
+
+	/* validate arguments */
+	if ((NULL == fpIn) || (NULL == fpOut))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (ReadIndex(fpIn, &info, &index) != 0)
+	{
+		return -1;
+	}
+
+	threads = CountThreads(threads);
+	waveSize = threads * JOBS_PER_THREAD;
+	jobs = (block_job_t *)calloc(waveSize, sizeof(block_job_t));
+
+	if (NULL == jobs)
+	{
+		free(index);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	pool.run = RunStage;
+	pool.stage = (info.format == BLOCK_LZSS) ? DecodeLZSSBuf :
+		((info.format == BLOCK_PROJECT) ? DecodeProjectBuf : DecodeSlideBuf);
+	pool.verify = (info.version != 1);
+	pool.jobs = jobs;
+	pthread_mutex_init(&pool.lock, NULL);
+	result = 0;
+
+	for (first = 0; (0 == result) && (first < info.count);
+		first += pool.count)
+	{
+		/* read the blocks of the next wave */
+		pool.count = (info.count - first < waveSize) ?
+			(unsigned int)(info.count - first) : waveSize;
+		result = ReadWave(fpIn, index, first, &pool);
+
+		if (0 == result)
+		{
+			RunPool(&pool, threads);
+		}
+
+		/* write the blocks in order */
+		for (j = 0; j < pool.count; j++)
+		{
+			if ((0 == result) && ((jobs[j].result != 0) ||
+				(jobs[j].outSize != index[first + j].size) ||
+				(pool.verify && (jobs[j].outSum != index[first + j].sum))))
+			{
+				errno = EINVAL;
+				result = -1;
+			}
+
+			if ((0 == result) && (fwrite(jobs[j].out, 1, jobs[j].outSize,
+				fpOut) != jobs[j].outSize))
+			{
+				result = -1;
+			}
+
+			free(jobs[j].in);
+			free(jobs[j].out);
+			jobs[j].in = NULL;
+			jobs[j].out = NULL;
+		}
+	}
+
+	pthread_mutex_destroy(&pool.lock);
+	free(jobs);
+	free(index);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : SearchBlocks
+*   Description: This function finds every occurrence of a pattern in a
+*				 block file of the project format, without decoding it.
+*				 The blocks are searched by a pool of threads, a few blocks
+*				 for every thread at a time.  An occurrence that crosses
+*				 blocks is found by going on with the KMP automaton of the
+*				 text before a block over the first characters of the
+*				 block.  The occurrences are passed to matchFunc in order
+*				 of their offset, from the calling thread.
+*   Parameters : fpIn - pointer to the open block file, encoded with
+*                       BLOCK_PROJECT, which has to be seekable
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence in
+*                            the original text
+*                userData - passed to matchFunc
+*                threads - number of threads, 0 for one on every processor
+*   Effects    : The file position of fpIn is changed.  It is not closed.
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+long SearchBlocks(FILE *fpIn, const unsigned char *pattern, size_t m,
+	match_func_t matchFunc, void *userData, unsigned int threads)
+{
+	block_pool_t pool;
+	block_job_t *jobs;
+	block_entry_t *index;
+	block_info_t info;
+	unsigned long first, i;
+	unsigned long long start;
+	unsigned int j, waveSize;
+	long total, state;
+
+	/* validate arguments */
+	if ((NULL == fpIn) || (NULL == pattern) || (NULL == matchFunc))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (0 == m)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ReadIndex(fpIn, &info, &index) != 0)
+	{
+		return -1;
+	}
+
+	if (info.format != BLOCK_PROJECT)
+	{
+		free(index);
+		errno = EINVAL;
+		return -1;
+	}
+
+	threads = CountThreads(threads);
+	waveSize = threads * JOBS_PER_THREAD;
+	jobs = (block_job_t *)calloc(waveSize, sizeof(block_job_t));
+	total = (NULL == jobs) ? -1 : 0;
+
+	for (j = 0; (0 == total) && (j < waveSize); j++)
+	{
+		jobs[j].edge.head = (unsigned char *)malloc(m);
+
+		if (NULL == jobs[j].edge.head)
+		{
+			total = -1;
+		}
+	}
+
+	if (total != 0)
+	{
+		for (j = 0; (jobs != NULL) && (j < waveSize); j++)
+		{
+			free(jobs[j].edge.head);
+		}
+
+		free(jobs);
+		free(index);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	pool.run = RunSearch;
+	pool.verify = (info.version != 1);
+	pool.pattern = pattern;
+	pool.m = m;
+	pool.jobs = jobs;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	start = 0;
+	state = 0;
+
+	for (first = 0; (total >= 0) && (first < info.count);
+		first += pool.count)
+	{
+		/* read the blocks of the next wave */
+		pool.count = (info.count - first < waveSize) ?
+			(unsigned int)(info.count - first) : waveSize;
+
+		if (ReadWave(fpIn, index, first, &pool) != 0)
+		{
+			total = -1;
+		}
+
+		if (total >= 0)
+		{
+			RunPool(&pool, threads);
+		}
+
+		/* report the occurrences in order */
+		for (j = 0; j < pool.count; j++)
+		{
+			if ((total >= 0) && ((jobs[j].result != 0) ||
+				(jobs[j].edge.length != index[first + j].size)))
+			{
+				errno = (jobs[j].result != 0) ? errno : EINVAL;
+				total = -1;
+			}
+
+			if (total >= 0)
+			{
+				/* the occurrences that start before the block come first */
+				state = SearchStitch(pattern, m, (size_t)state,
+					&jobs[j].edge, start, matchFunc, userData, &total);
+
+				if (state < 0)
+				{
+					total = -1;
+				}
+			}
+
+			for (i = 0; (total >= 0) && (i < jobs[j].matchCount); i++)
+			{
+				matchFunc(start + jobs[j].match[i], userData);
+				total++;
+			}
+
+			start += index[first + j].size;
+			free(jobs[j].in);
+			jobs[j].in = NULL;
+		}
+	}
+
+	for (j = 0; j < waveSize; j++)
+	{
+		free(jobs[j].in);
+		free(jobs[j].match);
+		free(jobs[j].edge.head);
+	}
+
+	pthread_mutex_destroy(&pool.lock);
+	free(jobs);
+	free(index);
+
+	return total;
+}
+
+/****************************************************************************
+*   Function   : VerifyBlocks
+*   Description: This function checks the data of every block of a block
+*				 file against its checksum, without decoding any block.
+*				 The blocks are checked by a pool of threads, a few blocks
+*				 for every thread at a time.
+*   Parameters : fpIn - pointer to the open block file, which has to be
+*                       seekable
+*                threads - number of threads, 0 for one on every processor
+*   Effects    : The file position of fpIn is changed.  It is not closed.
+*   Returned   : The number of damaged blocks, 0 if the file is intact, -1
+*                for failure.  errno will be set in the event of a failure,
+*                to ENOTSUP for a version 1 file, which has no checksums.
+****************************************************************************/
+long VerifyBlocks(FILE *fpIn, unsigned int threads)
+{
+	block_pool_t pool;
+	block_job_t *jobs;
+	block_entry_t *index;
+	block_info_t info;
+	unsigned long first;
+	unsigned int j, waveSize;
+	long damaged;
+
+	/* validate arguments */
+	if (NULL == fpIn)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	if (ReadIndex(fpIn, &info, &index) != 0)
+	{
+		return -1;
+	}
+
+	if (1 == info.version)
+	{
+		free(index);
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	threads = CountThreads(threads);
+	waveSize = threads * JOBS_PER_THREAD;
+	jobs = (block_job_t *)calloc(waveSize, sizeof(block_job_t));
+
+	if (NULL == jobs)
+	{
+		free(index);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	pool.run = RunVerify;
+	pool.verify = 1;
+	pool.jobs = jobs;
+	pthread_mutex_init(&pool.lock, NULL);
+	damaged = 0;
+
+	for (first = 0; (damaged >= 0) && (first < info.count);
+		first += pool.count)
+	{
+		pool.count = (info.count - first < waveSize) ?
+			(unsigned int)(info.count - first) : waveSize;
+
+		if (ReadWave(fpIn, index, first, &pool) != 0)
+		{
+			damaged = -1;
+		}
+		else
+		{
+			RunPool(&pool, threads);
+		}
+
+		for (j = 0; j < pool.count; j++)
+		{
+			if ((damaged >= 0) && (jobs[j].result != 0))
+			{
+				damaged++;
+			}
+
+			free(jobs[j].in);
+			jobs[j].in = NULL;
+		}
+	}
+
+	pthread_mutex_destroy(&pool.lock);
+	free(jobs);
+	free(index);
+
+	return damaged;
+}
@@ -37,14 +37,55 @@
 /***************************************************************************
 *                             INCLUDED FILES
 ***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include "lzlocal.h"
 
+/* the vector kernels are built with gcc and clang for x86 processors */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BRUTE_X86
+#include <immintrin.h>
+#endif
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
 /***************************************************************************
-*                            GLOBAL VARIABLES
+* A kernel finds the longest match of the MAX_CODED characters of pattern
+* among the WINDOW_SIZE - 1 strings starting at window, oldest first.  A
+* match may not run past the end of them, and the first of the longest
+* matches is the one found.  The offset returned is an index of window.
 ***************************************************************************/
-/* cyclic buffer sliding window of already read characters */
-extern unsigned char slidingWindow[];
-extern unsigned char uncodedLookahead[];
+typedef void (*match_kernel_t)(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match);
+
+/***************************************************************************
+* linear holds the sliding window twice, so the characters that follow any
+* index of the window are in a row, without wrapping around.  kernel is the
+* widest kernel the processor runs.
+***************************************************************************/
+struct search_data_t
+{
+    unsigned char linear[2 * WINDOW_SIZE];
+    match_kernel_t kernel;
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void MatchScalar(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match);
+static void MatchFrom(const unsigned char *window,
+    const unsigned char *pattern, unsigned int k, encoded_string_t *match);
+
+#ifdef BRUTE_X86
+static void MatchSSE2(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match);
+static void MatchAVX2(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match);
+#endif
 
 /***************************************************************************
 *                                FUNCTIONS
@@ -54,97 +95,313 @@ extern unsigned char uncodedLookahead[];
 *   Function   : InitializeSearchStructures
 *   Description: This function initializes structures used to speed up the
 *                process of mathcing uncoded strings to strings in the
-*                sliding window.  The brute force search doesn't use any
-*                special structures, so this function doesn't do anything.
-*   Parameters : None
-*   Effects    : None
+*                sliding window.  The brute force search keeps a copy of
+*                the sliding window that does not wrap around, and chooses
+*                the kernel that compares it with the lookahead.
+*   Parameters : ctx - the codec context
+*   Effects    : The search data of ctx is allocated.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ****************************************************************************/
-int InitializeSearchStructures(void)
+int InitializeSearchStructures(lzss_ctx_t *ctx)
 {
+    search_data_t *sd;
+
+    sd = (search_data_t *)malloc(sizeof(search_data_t));
+    ctx->searchData = sd;
+
+    if (NULL == sd)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memcpy(sd->linear, ctx->slidingWindow, WINDOW_SIZE);
+    memcpy(sd->linear + WINDOW_SIZE, ctx->slidingWindow, WINDOW_SIZE);
+    sd->kernel = MatchScalar;
+
+#ifdef BRUTE_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        sd->kernel = MatchAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        sd->kernel = MatchSSE2;
+    }
+#endif
+
     return 0;
 }
 
+/****************************************************************************
+*   Function   : FreeSearchStructures
+*   Description: This function frees the structures allocated by
+*                InitializeSearchStructures.
+*   Parameters : ctx - the codec context
+*   Effects    : The search data of ctx is freed.
+*   Returned   : None
+****************************************************************************/
+void FreeSearchStructures(lzss_ctx_t *ctx)
+{
+    free(ctx->searchData);
+    ctx->searchData = NULL;
+}
+
 /****************************************************************************
 *   Function   : FindMatch
 *   Description: This function will search through the slidingWindow
 *                dictionary for the longest sequence matching the MAX_CODED
-*                long string stored in uncodedLookahed.
-*   Parameters : windowHead - head of sliding window
+*                long string stored in uncodedLookahed.  The strings are
+*                compared from the oldest, after windowHead, to the newest,
+*                and a match stops before windowHead, so it is never longer
+*                than its offset.
+*   Parameters : ctx - the codec context
+*                windowHead - head of sliding window
 *                uncodedHead - head of uncoded lookahead buffer
 *   Effects    : None
 *   Returned   : The sliding window index where the match starts and the
 *                length of the match.  If there is no match a length of
 *                zero will be returned.
 ****************************************************************************/
-encoded_string_t FindMatch(const unsigned int windowHead,
+encoded_string_t FindMatch(lzss_ctx_t *ctx, const unsigned int windowHead,
     unsigned int uncodedHead)
 {
+    const search_data_t *sd = ctx->searchData;
+    unsigned char pattern[MAX_CODED];
     encoded_string_t matchData;
     unsigned int i;
-    unsigned int j;
-
-    matchData.length = 0;
-    matchData.offset = 0;
- //   i = windowHead;  /* start at the beginning of the sliding window */
-   i = Wrap((windowHead + 1), WINDOW_SIZE);
-	j = 0;
-	
-    while (1)
+
+    for (i = 0; i < MAX_CODED; i++)
+    {
+        pattern[i] = ctx->uncodedLookahead[uncodedHead];
+        uncodedHead = Wrap((uncodedHead + 1), MAX_CODED);
+    }
+
+    sd->kernel(sd->linear + windowHead + 1, pattern, &matchData);
+
+    if (matchData.length > 0)
+    {
+        matchData.offset =
+            Wrap((matchData.offset + windowHead + 1), WINDOW_SIZE);
+    }
+
+    return matchData;
+}
+
+/****************************************************************************
+*   Function   : MatchScalar
+*   Description: This function is the kernel of processors without vector
+*                instructions.  It compares the strings a character at a
+*                time.
+*   Parameters : window - the strings of the sliding window, oldest first
+*                pattern - the MAX_CODED characters to match
+*                match - set to the longest match
+*   Effects    : None
+*   Returned   : None
+****************************************************************************/
+static void MatchScalar(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match)
+{
+    match->offset = 0;
+    match->length = 0;
+    MatchFrom(window, pattern, 0, match);
+}
+
+/****************************************************************************
+*   Function   : MatchFrom
+*   Description: This function compares the strings from index k of
+*                window on a character at a time, for MatchScalar and for
+*                the last strings of the vector kernels.
+*   Parameters : window - the strings of the sliding window, oldest first
+*                pattern - the MAX_CODED characters to match
+*                k - index of the first string to compare
+*                match - the longest match before k, replaced by a longer
+*                        one
+*   Effects    : None
+*   Returned   : None
+****************************************************************************/
+static void MatchFrom(const unsigned char *window,
+    const unsigned char *pattern, unsigned int k, encoded_string_t *match)
+{
+    unsigned int j, most;
+
+    for (; (k < WINDOW_SIZE - 1) && (match->length < MAX_CODED); k++)
     {
-        if (slidingWindow[i] == uncodedLookahead[uncodedHead])
+        if (window[k] != pattern[0])
         {
-            /* we matched one. how many more match? */
-            j = 1;
+            continue;
+        }
+
+        /* a match stops at the end of the window */
+        most = WINDOW_SIZE - 1 - k;
+
+        if (most > MAX_CODED)
+        {
+            most = MAX_CODED;
+        }
+
+        for (j = 1; (j < most) && (window[k + j] == pattern[j]); j++)
+        {
+        }
+
+        if (j > match->length)
+        {
+            match->length = j;
+            match->offset = k;
+        }
+    }
+}
+
+#ifdef BRUTE_X86
+/****************************************************************************
+*   Function   : MatchSSE2
+*   Description: This function is the kernel of processors with SSE2.  It
+*                compares 16 strings at once, one character of the pattern
+*                after the other, until none of them matches, and leaves
+*                the last MAX_CODED strings, which end early, to MatchFrom.
+*   Parameters : window - the strings of the sliding window, oldest first
+*                pattern - the MAX_CODED characters to match
+*                match - set to the longest match
+*   Effects    : None
+*   Returned   : None
+****************************************************************************/
+__attribute__((target("sse2")))
+static void MatchSSE2(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match)
+{
+    __m128i chars[MAX_CODED];
+    __m128i run;
+    unsigned int k, t, mask, next;
+
+    match->offset = 0;
+    match->length = 0;
+
+    for (t = 0; t < MAX_CODED; t++)
+    {
+        chars[t] = _mm_set1_epi8((char)pattern[t]);
+    }
+
+    for (k = 0; k + 16 <= WINDOW_SIZE - MAX_CODED; k += 16)
+    {
+        run = _mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(window + k)), chars[0]);
+        mask = (unsigned int)_mm_movemask_epi8(run);
+
+        /* the strings of mask match the first t characters */
+        for (t = 1; (mask != 0) && (t < MAX_CODED); t++)
+        {
+            run = _mm_and_si128(run, _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(window + k + t)),
+                chars[t]));
+            next = (unsigned int)_mm_movemask_epi8(run);
 
-            while(slidingWindow[Wrap((i + j), WINDOW_SIZE)] ==
-                uncodedLookahead[Wrap((uncodedHead + j), MAX_CODED)])
+            if (0 == next)
             {
-                if ((j >= MAX_CODED) ||(Wrap((i + j), WINDOW_SIZE) == windowHead) )// ORIGINAL: if (j >= MAX_CODED) prevent length > offset
-                {
-                    break;
-                }
-                j++;
+                break;
             }
 
-            if (j > matchData.length)
+            mask = next;
+        }
+
+        if ((mask != 0) && (t > match->length))
+        {
+            match->length = t;
+            match->offset = k + __builtin_ctz(mask);
+
+            if (MAX_CODED == t)
             {
-                matchData.length = j;
-                matchData.offset = i;
+                return;
             }
         }
+    }
+
+    MatchFrom(window, pattern, k, match);
+}
+
+/****************************************************************************
+*   Function   : MatchAVX2
+*   Description: This function is MatchSSE2 for processors with AVX2,
+*                which compares 32 strings at once.
+*   Parameters : window - the strings of the sliding window, oldest first
+*                pattern - the MAX_CODED characters to match
+*                match - set to the longest match
+*   Effects    : None
+*   Returned   : None
+****************************************************************************/
+__attribute__((target("avx2")))
+static void MatchAVX2(const unsigned char *window,
+    const unsigned char *pattern, encoded_string_t *match)
+{
+    __m256i chars[MAX_CODED];
+    __m256i run;
+    unsigned int k, t, mask, next;
+
+    match->offset = 0;
+    match->length = 0;
 
-        if (j >= MAX_CODED)
+    for (t = 0; t < MAX_CODED; t++)
+    {
+        chars[t] = _mm256_set1_epi8((char)pattern[t]);
+    }
+
+    for (k = 0; k + 32 <= WINDOW_SIZE - MAX_CODED; k += 32)
+    {
+        run = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i *)(window + k)), chars[0]);
+        mask = (unsigned int)_mm256_movemask_epi8(run);
+
+        /* the strings of mask match the first t characters */
+        for (t = 1; (mask != 0) && (t < MAX_CODED); t++)
         {
-            matchData.length = MAX_CODED;
-            break;
+            run = _mm256_and_si256(run, _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(window + k + t)),
+                chars[t]));
+            next = (unsigned int)_mm256_movemask_epi8(run);
+
+            if (0 == next)
+            {
+                break;
+            }
+
+            mask = next;
         }
 
-        i = Wrap((i + 1), WINDOW_SIZE);
-        if (i == windowHead)
+        if ((mask != 0) && (t > match->length))
         {
-            /* we wrapped around */
-            break;
+            match->length = t;
+            match->offset = k + __builtin_ctz(mask);
+
+            if (MAX_CODED == t)
+            {
+                return;
+            }
         }
     }
 
-    return matchData;
+    MatchFrom(window, pattern, k, match);
 }
+#endif
 
 /****************************************************************************
 *   Function   : ReplaceChar
 *   Description: This function replaces the character stored in
-*                slidingWindow[charIndex] with the one specified by
-*                replacement.
-*   Parameters : charIndex - sliding window index of the character to be
+*                slidingWindow[charIndex], and its copies in the search
+*                data, with the one specified by replacement.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the character to be
 *                            removed from the linked list.
 *   Effects    : slidingWindow[charIndex] is replaced by replacement.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ****************************************************************************/
-int ReplaceChar(const unsigned int charIndex, const unsigned char replacement)
+int ReplaceChar(lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned char replacement)
 {
-    slidingWindow[charIndex] = replacement;
+    ctx->slidingWindow[charIndex] = replacement;
+    ctx->searchData->linear[charIndex] = replacement;
+    ctx->searchData->linear[charIndex + WINDOW_SIZE] = replacement;
     return 0;
 }
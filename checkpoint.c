@@ -0,0 +1,491 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : checkpoint.c
+*   Purpose : Keep a sidecar index of checkpoints for a file encoded with
+*             EncodeLZSS, so part of it can be decoded without decoding
+*             everything before it.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "lzss.h"
+#include "lzlocal.h"
+#include "bitfile.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/***************************************************************************
+* An index file is
+*   header      - "LZSI", version, three reserved bytes, the interval and
+*                 the window size
+*   checkpoints - one for every interval bytes of decoded text: the offset
+*                 in the text, the offset in bits in the encoded file and
+*                 the sliding window
+* All the numbers are little endian.  Checkpoint k is at the first item
+* that starts at or after offset k * interval of the text, so the
+* checkpoint for an offset is found without searching.
+***************************************************************************/
+#define INDEX_MAGIC         "LZSI"
+#define INDEX_VERSION       1
+
+#define HEADER_SIZE         16
+#define ENTRY_SIZE          (16 + WINDOW_SIZE)
+
+/* bits in an uncoded character and in an (offset, length) pair */
+#define UNCODED_BITS        (1 + 8)
+#define CODED_BITS          (1 + OFFSET_BITS + LENGTH_BITS)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/* where the decoder is and what its window holds */
+typedef struct checkpoint_t
+{
+	unsigned long long textPos;     /* offset of the next decoded byte */
+	unsigned long long bitPos;      /* offset in bits of the next item */
+	unsigned char window[WINDOW_SIZE];
+} checkpoint_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int DecodeItem(bit_file_t *bfpIn, checkpoint_t *cp,
+	unsigned char *chars, unsigned int *count);
+static int ReadCheckpoint(FILE *fpIndex, unsigned long long start,
+	checkpoint_t *cp);
+static void PutNumber(unsigned char *buffer, unsigned long long value,
+	const unsigned int bytes);
+static unsigned long long GetNumber(const unsigned char *buffer,
+	const unsigned int bytes);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : IndexLZSS
+*   Description: This function decodes a file encoded with EncodeLZSS,
+*				 without writing the text, and writes an index with a
+*				 checkpoint for every interval bytes of the text.  A
+*				 checkpoint is the state DecodeLZSS is in at an item: the
+*				 offset of the item in bits and the sliding window.
+*   Parameters : fpIn - pointer to the open LZSS encoded file, which has to
+*                       be seekable
+*                fpIndex - pointer to the open binary file to write the
+*                          index to
+*                interval - bytes of text between checkpoints, at least
+*                           WINDOW_SIZE
+*   Effects    : fpIn is read from its start to its end and the index is
+*                written to fpIndex.  Neither file is closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int IndexLZSS(FILE *fpIn, FILE *fpIndex, unsigned long interval)
+{
+	checkpoint_t *cp;
+	bit_file_t *bfpIn;
+	unsigned char buffer[HEADER_SIZE];
+	unsigned char chars[MAX_CODED];
+	unsigned long long next;
+	unsigned int count;
+	int result;
+
+	/* validate arguments */
+	if ((NULL == fpIn) || (NULL == fpIndex))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	/* a checkpoint for every interval needs items shorter than it */
+	if ((interval < WINDOW_SIZE) || (interval > 0xFFFFFFFFUL))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (fseek(fpIn, 0, SEEK_SET) != 0)
+	{
+		return -1;
+	}
+
+	cp = (checkpoint_t *)malloc(sizeof(checkpoint_t));
+
+	if (NULL == cp)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	bfpIn = MakeBitFile(fpIn, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		free(cp);
+		return -1;
+	}
+
+	memcpy(buffer, INDEX_MAGIC, 4);
+	buffer[4] = INDEX_VERSION;
+	buffer[5] = buffer[6] = buffer[7] = 0;
+	PutNumber(buffer + 8, interval, 4);
+	PutNumber(buffer + 12, WINDOW_SIZE, 4);
+	result = (fwrite(buffer, 1, HEADER_SIZE, fpIndex) == HEADER_SIZE) ? 0 : -1;
+
+	/* the same window DecodeLZSS starts with */
+	memset(cp->window, '~', WINDOW_SIZE);
+	cp->textPos = 0;
+	cp->bitPos = 0;
+	next = 0;
+
+	do
+	{
+		if ((0 == result) && (cp->textPos >= next))
+		{
+			PutNumber(buffer, cp->textPos, 8);
+			PutNumber(buffer + 8, cp->bitPos, 8);
+
+			if ((fwrite(buffer, 1, 16, fpIndex) != 16) ||
+				(fwrite(cp->window, 1, WINDOW_SIZE, fpIndex) != WINDOW_SIZE))
+			{
+				result = -1;
+			}
+
+			next = (cp->textPos / interval + 1) * interval;
+		}
+	} while ((0 == result) && (DecodeItem(bfpIn, cp, chars, &count) == 0));
+
+	BitFileToFILE(bfpIn);
+	free(cp);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : DecodeRange
+*   Description: This function decodes length bytes of a file encoded with
+*				 EncodeLZSS, starting at offset start of the text.  With an
+*				 index decoding starts at the last checkpoint before start,
+*				 so at most the interval of the index is decoded before the
+*				 range.  Without one it starts at the beginning of the file.
+*   Parameters : fpIn - pointer to the open LZSS encoded file, which has to
+*                       be seekable
+*                fpIndex - pointer to the open index of fpIn written by
+*                          IndexLZSS, or NULL
+*                start - offset in the text of the first byte to decode
+*                out - where to write the decoded bytes
+*                length - number of bytes to decode
+*   Effects    : The file positions of fpIn and fpIndex are changed.
+*                Neither file is closed after exit.
+*   Returned   : The number of bytes written to out, less than length if
+*                the text ends first, -1 for failure.  errno will be set in
+*                the event of a failure.
+****************************************************************************/
+long DecodeRange(FILE *fpIn, FILE *fpIndex, unsigned long long start,
+	unsigned char *out, size_t length)
+{
+	checkpoint_t *cp;
+	bit_file_t *bfpIn;
+	unsigned char chars[MAX_CODED];
+	unsigned long long end;
+	unsigned int count, i, skip;
+	size_t written;
+
+	/* validate arguments */
+	if ((NULL == fpIn) || ((NULL == out) && (length != 0)))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	cp = (checkpoint_t *)malloc(sizeof(checkpoint_t));
+
+	if (NULL == cp)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (NULL == fpIndex)
+	{
+		memset(cp->window, '~', WINDOW_SIZE);
+		cp->textPos = 0;
+		cp->bitPos = 0;
+	}
+	else if (ReadCheckpoint(fpIndex, start, cp) != 0)
+	{
+		free(cp);
+		return -1;
+	}
+
+	if (fseek(fpIn, (long)(cp->bitPos / 8), SEEK_SET) != 0)
+	{
+		free(cp);
+		return -1;
+	}
+
+	bfpIn = MakeBitFile(fpIn, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		free(cp);
+		return -1;
+	}
+
+	/* the checkpoint may be in the middle of a byte */
+	skip = (unsigned int)(cp->bitPos % 8);
+
+	if ((skip != 0) && (BitFileGetBitsInt(bfpIn, &i, skip) == EOF))
+	{
+		BitFileToFILE(bfpIn);
+		free(cp);
+		errno = EINVAL;
+		return -1;
+	}
+
+	end = start + length;
+	written = 0;
+
+	while ((cp->textPos < end) && (DecodeItem(bfpIn, cp, chars, &count) == 0))
+	{
+		/* chars were decoded at textPos - count */
+		for (i = 0; i < count; i++)
+		{
+			if ((cp->textPos - count + i >= start) &&
+				(cp->textPos - count + i < end))
+			{
+				out[written++] = chars[i];
+			}
+		}
+	}
+
+	BitFileToFILE(bfpIn);
+	free(cp);
+
+	return (long)written;
+}
+
+/****************************************************************************
+*   Function   : DecodeItem
+*   Description: This function decodes the next item of a LZSS encoded
+*				 file the way DecodeLZSS does.
+*   Parameters : bfpIn - the LZSS encoded bit file
+*                cp - the decoder, which is moved past the item
+*                chars - set to the decoded characters
+*                count - set to the number of decoded characters
+*   Effects    : The item is consumed from bfpIn.
+*   Returned   : 0 for success, EOF at the end of the file.
+****************************************************************************/
+static int DecodeItem(bit_file_t *bfpIn, checkpoint_t *cp,
+	unsigned char *chars, unsigned int *count)
+{
+	encoded_string_t code;
+	unsigned int nextChar, src, i;
+	int c;
+
+	nextChar = (unsigned int)(cp->textPos % WINDOW_SIZE);
+
+	if ((c = BitFileGetBit(bfpIn)) == EOF)
+	{
+		return EOF;
+	}
+
+	if (c == UNCODED)
+	{
+		if ((c = BitFileGetChar(bfpIn)) == EOF)
+		{
+			return EOF;
+		}
+
+		chars[0] = (unsigned char)c;
+		*count = 1;
+		cp->bitPos += UNCODED_BITS;
+	}
+	else
+	{
+		code.offset = 0;
+		code.length = 0;
+
+		if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS,
+			sizeof(unsigned int)) == EOF) ||
+			(BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS,
+			sizeof(unsigned int)) == EOF))
+		{
+			return EOF;
+		}
+
+		/* the offset counts back from the next character */
+		src = (nextChar > code.offset) ? (nextChar - code.offset) :
+			(nextChar + WINDOW_SIZE - code.offset);
+
+		/* read the whole string before any of it is written back */
+		for (i = 0; i < code.length; i++)
+		{
+			chars[i] = cp->window[Wrap((src + i), WINDOW_SIZE)];
+		}
+
+		*count = code.length;
+		cp->bitPos += CODED_BITS;
+	}
+
+	for (i = 0; i < *count; i++)
+	{
+		cp->window[Wrap((nextChar + i), WINDOW_SIZE)] = chars[i];
+	}
+
+	cp->textPos += *count;
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : ReadCheckpoint
+*   Description: This function reads the last checkpoint of an index that
+*				 is at or before an offset of the text.
+*   Parameters : fpIndex - pointer to the open index file
+*                start - the offset of the text
+*                cp - set to the checkpoint
+*   Effects    : The file position of fpIndex is changed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int ReadCheckpoint(FILE *fpIndex, unsigned long long start,
+	checkpoint_t *cp)
+{
+	unsigned char buffer[HEADER_SIZE];
+	unsigned long long k, count;
+	unsigned long interval;
+	long size;
+
+	if ((fseek(fpIndex, 0, SEEK_END) != 0) || ((size = ftell(fpIndex)) < 0) ||
+		(fseek(fpIndex, 0, SEEK_SET) != 0) ||
+		(fread(buffer, 1, HEADER_SIZE, fpIndex) != HEADER_SIZE) ||
+		(memcmp(buffer, INDEX_MAGIC, 4) != 0) ||
+		(buffer[4] != INDEX_VERSION) ||
+		(GetNumber(buffer + 12, 4) != WINDOW_SIZE))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	interval = (unsigned long)GetNumber(buffer + 8, 4);
+	count = ((unsigned long)size - HEADER_SIZE) / ENTRY_SIZE;
+
+	if ((interval < WINDOW_SIZE) || (0 == count))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	k = start / interval;
+
+	if (k >= count)
+	{
+		k = count - 1;
+	}
+
+	/* checkpoint k can be a few bytes past k * interval */
+	while (1)
+	{
+		if ((fseek(fpIndex, (long)(HEADER_SIZE + k * ENTRY_SIZE),
+			SEEK_SET) != 0) ||
+			(fread(buffer, 1, 16, fpIndex) != 16) ||
+			(fread(cp->window, 1, WINDOW_SIZE, fpIndex) != WINDOW_SIZE))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		cp->textPos = GetNumber(buffer, 8);
+		cp->bitPos = GetNumber(buffer + 8, 8);
+
+		if ((cp->textPos <= start) || (0 == k))
+		{
+			break;
+		}
+
+		k--;
+	}
+
+	if ((0 == k) && (cp->textPos != 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : PutNumber
+*   Description: This function stores a number in little endian order.
+*   Parameters : buffer - where to store the number
+*                value - the number
+*                bytes - the number of bytes to store
+*   Effects    : bytes bytes of buffer are written.
+*   Returned   : None
+****************************************************************************/
+static void PutNumber(unsigned char *buffer, unsigned long long value,
+	const unsigned int bytes)
+{
+	unsigned int i;
+
+	for (i = 0; i < bytes; i++)
+	{
+		buffer[i] = (unsigned char)(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+/****************************************************************************
+*   Function   : GetNumber
+*   Description: This function reads a number stored by PutNumber.
+*   Parameters : buffer - where the number is stored
+*                bytes - the number of bytes of the number
+*   Effects    : None
+*   Returned   : The number.
+****************************************************************************/
+static unsigned long long GetNumber(const unsigned char *buffer,
+	const unsigned int bytes)
+{
+	unsigned long long value;
+	unsigned int i;
+
+	value = 0;
+
+	for (i = bytes; i > 0; i--)
+	{
+		value = (value << 8) | buffer[i - 1];
+	}
+
+	return value;
+}
@@ -0,0 +1,149 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : checksum.c
+*   Purpose : A fast 32 bit checksum for the blocks of block files.  It is
+*             the XXH32 hash of Yann Collet's xxHash, so other tools can
+*             compute the same value.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include "lzlocal.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define PRIME1      0x9E3779B1UL
+#define PRIME2      0x85EBCA77UL
+#define PRIME3      0xC2B2AE3DUL
+#define PRIME4      0x27D4EB2FUL
+#define PRIME5      0x165667B1UL
+
+#define MASK32      0xFFFFFFFFUL
+
+/***************************************************************************
+*                                 MACROS
+***************************************************************************/
+
+/* unsigned long may be wider than 32 bits, so every result is masked */
+#define Rotate(x, r)    ((((x) << (r)) | (((x) & MASK32) >> (32 - (r)))) & MASK32)
+#define Read32(p)       ((unsigned long)(p)[0] | ((unsigned long)(p)[1] << 8) | \
+                        ((unsigned long)(p)[2] << 16) | ((unsigned long)(p)[3] << 24))
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned long Round(unsigned long acc, unsigned long input);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : Checksum32
+*   Description: This function computes the XXH32 hash of a buffer.  The
+*				 buffer is read in 16 byte stripes into four independent
+*				 accumulators, which are merged and mixed with the tail.
+*   Parameters : data - the buffer
+*                size - number of bytes in the buffer
+*                seed - the seed of the hash
+*   Effects    : None
+*   Returned   : The 32 bit hash.
+****************************************************************************/
+unsigned long Checksum32(const void *data, size_t size, unsigned long seed)
+{
+	const unsigned char *p, *end;
+	unsigned long v1, v2, v3, v4, h;
+
+	p = (const unsigned char *)data;
+	end = p + size;
+	seed &= MASK32;
+
+	if (size >= 16)
+	{
+		v1 = (seed + PRIME1 + PRIME2) & MASK32;
+		v2 = (seed + PRIME2) & MASK32;
+		v3 = seed;
+		v4 = (seed - PRIME1) & MASK32;
+
+		do
+		{
+			v1 = Round(v1, Read32(p));
+			v2 = Round(v2, Read32(p + 4));
+			v3 = Round(v3, Read32(p + 8));
+			v4 = Round(v4, Read32(p + 12));
+			p += 16;
+		} while (p + 16 <= end);
+
+		h = (Rotate(v1, 1) + Rotate(v2, 7) + Rotate(v3, 12) +
+			Rotate(v4, 18)) & MASK32;
+	}
+	else
+	{
+		h = (seed + PRIME5) & MASK32;
+	}
+
+	h = (h + (unsigned long)size) & MASK32;
+
+	while (p + 4 <= end)
+	{
+		h = (h + Read32(p) * PRIME3) & MASK32;
+		h = (Rotate(h, 17) * PRIME4) & MASK32;
+		p += 4;
+	}
+
+	while (p < end)
+	{
+		h = (h + *p * PRIME5) & MASK32;
+		h = (Rotate(h, 11) * PRIME1) & MASK32;
+		p++;
+	}
+
+	/* avalanche */
+	h ^= h >> 15;
+	h = (h * PRIME2) & MASK32;
+	h ^= h >> 13;
+	h = (h * PRIME3) & MASK32;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/****************************************************************************
+*   Function   : Round
+*   Description: This function mixes four bytes into an accumulator.
+*   Parameters : acc - the accumulator
+*                input - the four bytes, little endian
+*   Effects    : None
+*   Returned   : The new accumulator.
+****************************************************************************/
+static unsigned long Round(unsigned long acc, unsigned long input)
+{
+	acc = (acc + input * PRIME2) & MASK32;
+	acc = Rotate(acc, 13);
+
+	return (acc * PRIME1) & MASK32;
+}
@@ -0,0 +1,103 @@
+/***************************************************************************
+*                     Match Finder Benchmark
+*
+*   File    : fmbench.c
+*   Purpose : Measure EncodeLZSS with the match finding method it is linked
+*             with (brute.c, hash.c, tree.c or sarray.c)
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzss.h"
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : main
+*   Description: This function encodes a file (org.txt by default) into a
+*				 temporary file, prints the time it took, the throughput
+*				 and the encoded size, and checks that the encoded file
+*				 decodes back to the original.
+*   Parameters : argv[1] - optional name of the file to encode
+*   Effects    : Results are printed to stdout
+*   Returned   : 0 for success, 1 for failure
+****************************************************************************/
+int main(int argc, char *argv[])
+{
+	const char *name;
+	FILE *org, *comp, *decomp;
+	long orgSize, compSize;
+	clock_t start;
+	double seconds;
+	int c1, c2;
+
+	name = (argc > 1) ? argv[1] : "org.txt";
+
+	org = fopen(name, "rb");
+	comp = tmpfile();
+	decomp = tmpfile();
+
+	if ((org == NULL) || (comp == NULL) || (decomp == NULL))
+	{
+		perror("Opening files");
+		return 1;
+	}
+
+	start = clock();
+	EncodeLZSS(org, comp);
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	orgSize = ftell(org);
+	compSize = ftell(comp);
+
+	/* the encoded file has to decode back to the original */
+	rewind(comp);
+	DecodeLZSS(comp, decomp);
+	rewind(org);
+	rewind(decomp);
+
+	do
+	{
+		c1 = getc(org);
+		c2 = getc(decomp);
+	} while ((c1 == c2) && (c1 != EOF));
+
+	printf("%-24s %10ld -> %10ld bytes (%5.1f%%) %8.3f s %8.2f MB/s %s\n",
+		argv[0], orgSize, compSize,
+		(orgSize > 0) ? (100.0 * compSize / orgSize) : 0.0, seconds,
+		(seconds > 0) ? (orgSize / seconds / 1e6) : 0.0,
+		(c1 == c2) ? "ok" : "DECODE FAILED");
+
+	fclose(org);
+	fclose(comp);
+	fclose(decomp);
+
+	return (c1 == c2) ? 0 : 1;
+}
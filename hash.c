@@ -0,0 +1,291 @@
+/***************************************************************************
+*          LZSS Encoding and Decoding
+*
+*   File    : hash.c
+*   Purpose : Implement hash chain matching of uncoded strings for LZSS
+*             algorithm.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*   Based on : Michael Dipperstein implementation Version 0.7
+*			   http://michael.dipperstein.com/lzss/
+*
+*
+****************************************************************************
+*
+* Hash: Hash table optimized matching routines used by LZSS
+*       Encoding/Decoding Routine
+* Copyright (C) 2004 - 2007, 2014 by
+* Michael Dipperstein (mdipper@alumni.engr.ucsb.edu)
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <errno.h>
+#include "lzlocal.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define NULL_INDEX      (WINDOW_SIZE + 1)
+
+/* only matches longer than MAX_UNCODED are encoded, so it is enough to
+ * hash the first MAX_UNCODED + 1 characters of every string */
+#define KEY_SIZE        (MAX_UNCODED + 1)
+
+#define HASH_BITS       13
+#define HASH_SIZE       (1 << HASH_BITS)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/***************************************************************************
+* hashTable holds the newest window index of every hash key and next links
+* each index to the previous index with the same key.  Entries are never
+* removed.  stamp records the ReplaceChar call that added an index, which
+* tells whether the entry is still in the window and whether the link into
+* it is stale.
+***************************************************************************/
+struct search_data_t
+{
+    unsigned int hashTable[HASH_SIZE];
+    unsigned int next[WINDOW_SIZE];
+    unsigned long stamp[WINDOW_SIZE];
+    unsigned long replaced;         /* number of ReplaceChar calls */
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static unsigned int HashKey(const unsigned char *buffer,
+    const unsigned int index, const unsigned int limit);
+static void AddString(lzss_ctx_t *ctx, const unsigned int charIndex);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : HashKey
+*   Description: This function generates a hash key for a KEY_SIZE long
+*                string in a cyclic buffer.
+*   Parameters : buffer - the cyclic buffer holding the string
+*                index - index of the first character of the string
+*                limit - size of the cyclic buffer
+*   Effects    : None
+*   Returned   : Key matching the string
+****************************************************************************/
+static unsigned int HashKey(const unsigned char *buffer,
+    const unsigned int index, const unsigned int limit)
+{
+    unsigned long key;
+    unsigned int i, j;
+
+    key = 0;
+    j = index;
+
+    for (i = 0; i < KEY_SIZE; i++)
+    {
+        key = (key << 8) | buffer[j];
+        j = Wrap((j + 1), limit);
+    }
+
+    /* multiplicative hash, keep the high bits of the 32 bit product */
+    return (unsigned int)(((key * 2654435761UL) & 0xFFFFFFFFUL) >>
+        (32 - HASH_BITS));
+}
+
+/****************************************************************************
+*   Function   : AddString
+*   Description: This function adds the string starting at charIndex to
+*                the head of its hash chain.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the string
+*   Effects    : The string is the newest entry of its hash chain.
+*   Returned   : None
+****************************************************************************/
+static void AddString(lzss_ctx_t *ctx, const unsigned int charIndex)
+{
+    search_data_t *sd = ctx->searchData;
+    unsigned int key;
+
+    key = HashKey(ctx->slidingWindow, charIndex, WINDOW_SIZE);
+    sd->next[charIndex] = sd->hashTable[key];
+    sd->hashTable[key] = charIndex;
+    sd->stamp[charIndex] = sd->replaced;
+}
+
+/****************************************************************************
+*   Function   : InitializeSearchStructures
+*   Description: This function initializes the hash table with every string
+*                in the sliding window that does not contain windowHead
+*                (index 0 at the start of encoding).
+*   Parameters : ctx - the codec context
+*   Effects    : The hash table and chains are allocated and initialized.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int InitializeSearchStructures(lzss_ctx_t *ctx)
+{
+    search_data_t *sd;
+    unsigned int i;
+
+    sd = (search_data_t *)malloc(sizeof(search_data_t));
+    ctx->searchData = sd;
+
+    if (sd == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < HASH_SIZE; i++)
+    {
+        sd->hashTable[i] = NULL_INDEX;
+    }
+
+    /************************************************************************
+    * Pretend the strings of the pre-filled window were added by the
+    * ReplaceChar calls that would have written their last characters.
+    ************************************************************************/
+    for (i = 1; i <= WINDOW_SIZE - KEY_SIZE; i++)
+    {
+        sd->replaced = i + KEY_SIZE;
+        AddString(ctx, i);
+    }
+
+    sd->replaced = WINDOW_SIZE;
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : FreeSearchStructures
+*   Description: This function frees the hash table and chains.
+*   Parameters : ctx - the codec context
+*   Effects    : The hash table and chains are freed.
+*   Returned   : None
+****************************************************************************/
+void FreeSearchStructures(lzss_ctx_t *ctx)
+{
+    free(ctx->searchData);
+    ctx->searchData = NULL;
+}
+
+/****************************************************************************
+*   Function   : FindMatch
+*   Description: This function will search through the slidingWindow
+*                dictionary for the longest sequence matching the MAX_CODED
+*                long string stored in uncodedLookahed.  Only the strings
+*                on the hash chain of the first KEY_SIZE characters of the
+*                lookahead are compared.  As in brute.c the match never
+*                reaches windowHead (no self-reference).
+*   Parameters : ctx - the codec context
+*                windowHead - head of sliding window
+*                uncodedHead - head of uncoded lookahead buffer
+*   Effects    : None
+*   Returned   : The sliding window index where the match starts and the
+*                length of the match.  If there is no match a length of
+*                zero will be returned.
+****************************************************************************/
+encoded_string_t FindMatch(lzss_ctx_t *ctx, const unsigned int windowHead,
+    unsigned int uncodedHead)
+{
+    const unsigned char *slidingWindow = ctx->slidingWindow;
+    const unsigned char *uncodedLookahead = ctx->uncodedLookahead;
+    const search_data_t *sd = ctx->searchData;
+    encoded_string_t matchData;
+    unsigned int i, j, k;
+    unsigned long previous;
+
+    matchData.length = 0;
+    matchData.offset = 0;
+
+    i = sd->hashTable[HashKey(uncodedLookahead, uncodedHead, MAX_CODED)];
+    previous = sd->replaced + 1;
+
+    while (i != NULL_INDEX)
+    {
+        /********************************************************************
+        * Chains run from newest to oldest.  A link to a newer entry means
+        * the index was reused, and an entry older than WINDOW_SIZE -
+        * KEY_SIZE calls contains windowHead or was overwritten.
+        ********************************************************************/
+        if ((sd->stamp[i] >= previous) ||
+            (sd->replaced - sd->stamp[i] >= WINDOW_SIZE - KEY_SIZE))
+        {
+            break;
+        }
+
+        previous = sd->stamp[i];
+
+        j = 0;
+        k = i;
+
+        while ((j < MAX_CODED) && (k != windowHead) &&
+            (slidingWindow[k] ==
+            uncodedLookahead[Wrap((uncodedHead + j), MAX_CODED)]))
+        {
+            j++;
+            k = Wrap((k + 1), WINDOW_SIZE);
+        }
+
+        if (j > matchData.length)
+        {
+            matchData.length = j;
+            matchData.offset = i;
+
+            if (j >= MAX_CODED)
+            {
+                break;
+            }
+        }
+
+        i = sd->next[i];
+    }
+
+    return matchData;
+}
+
+/****************************************************************************
+*   Function   : ReplaceChar
+*   Description: This function replaces the character stored in
+*                slidingWindow[charIndex] with the one specified by
+*                replacement.  The string ending with the new character is
+*                the newest one that does not contain the next windowHead,
+*                so it is added to the hash table.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the character to be
+*                            replaced (windowHead).
+*   Effects    : slidingWindow[charIndex] is replaced by replacement.  The
+*                hash table is updated.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int ReplaceChar(lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned char replacement)
+{
+    ctx->slidingWindow[charIndex] = replacement;
+    ctx->searchData->replaced++;
+    AddString(ctx,
+        Wrap((charIndex + WINDOW_SIZE - (KEY_SIZE - 1)), WINDOW_SIZE));
+
+    return 0;
+}
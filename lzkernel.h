@@ -0,0 +1,270 @@
+/***************************************************************************
+*  A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : lzkernel.h
+*   Purpose : LZSS encoder and decoder for one pair of bit widths.  This
+*             file is included by widths.c once for every pair it supports,
+*             so the window size and the longest match are constants in the
+*             loops of every pair.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Before including this file define
+*   KERNEL_OFFSET_BITS - bits of the offset of a pointer
+*   KERNEL_LENGTH_BITS - bits of the length of a pointer
+*   KERNEL_ENCODE      - name of the encoder, a stage_func_t
+*   KERNEL_DECODE      - name of the decoder, which also takes the character
+*                        the window is filled with
+* They are undefined at the end of the file.
+***************************************************************************/
+
+#define K_WINDOW        (1U << KERNEL_OFFSET_BITS)
+#define K_MAX_CODED     ((1U << KERNEL_LENGTH_BITS) - 1)
+
+/* the encoder keeps the window and the lookahead in a ring twice as big */
+#define K_RING_MASK     (2 * K_WINDOW - 1)
+
+/****************************************************************************
+*   Function   : KERNEL_ENCODE
+*   Description: This function writes the header of a stream with these
+*				 widths and encodes a bit file after it with the
+*				 traditional LZSS algorithm.  Matches are found on hash
+*				 chains of the positions of the last K_WINDOW characters,
+*				 keyed by the next MAX_UNCODED + 1 characters, and a match
+*				 is never longer than its offset, as DecodeLZSS requires.
+*   Parameters : bfpIn - pointer to the bit file to encode
+*                bfpOut - pointer to the bit file to write encoded output
+*   Effects    : bfpIn is encoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int KERNEL_ENCODE(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	unsigned char *ring;
+	unsigned int *head, *prev;
+	unsigned int pos, avail, cand, p, distance, limit, most, length;
+	unsigned int best, bestDistance, chain, h, i;
+	int c;
+
+	ring = (unsigned char *)malloc(K_RING_MASK + 1);
+	head = (unsigned int *)calloc(WIDTHS_HASH_SIZE, sizeof(unsigned int));
+	prev = (unsigned int *)malloc(K_WINDOW * sizeof(unsigned int));
+
+	if ((NULL == ring) || (NULL == head) || (NULL == prev))
+	{
+		free(ring);
+		free(head);
+		free(prev);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	PutWidthsHeader(bfpOut, KERNEL_OFFSET_BITS, KERNEL_LENGTH_BITS);
+
+	/* positions count the characters read, and wrap around with them */
+	pos = 0;
+	avail = 0;
+	c = 0;
+
+	while ((avail < K_MAX_CODED) && ((c = BitFileGetChar(bfpIn)) != EOF))
+	{
+		ring[avail++] = (unsigned char)c;
+	}
+
+	while (pos != avail)
+	{
+		best = 0;
+		bestDistance = 0;
+		limit = ((avail - pos) < K_MAX_CODED) ? (avail - pos) : K_MAX_CODED;
+
+		if (limit > MAX_UNCODED)
+		{
+			h = WidthsHash(ring, pos, K_RING_MASK);
+
+			/* head and prev hold positions + 1, 0 ends a chain */
+			for (cand = head[h], chain = WIDTHS_CHAIN;
+				(cand != 0) && (chain > 0); chain--)
+			{
+				p = cand - 1;
+				distance = pos - p;
+
+				if ((0 == distance) || (distance > K_WINDOW))
+				{
+					break;
+				}
+
+				most = (distance < limit) ? distance : limit;
+
+				if ((most > best) && (ring[(p + best) & K_RING_MASK] ==
+					ring[(pos + best) & K_RING_MASK]))
+				{
+					for (length = 0; (length < most) &&
+						(ring[(p + length) & K_RING_MASK] ==
+						ring[(pos + length) & K_RING_MASK]); length++)
+					{
+					}
+
+					if (length > best)
+					{
+						best = length;
+						bestDistance = distance;
+
+						if (best == limit)
+						{
+							break;
+						}
+					}
+				}
+
+				cand = prev[p & (K_WINDOW - 1)];
+			}
+		}
+
+		if (best > MAX_UNCODED)
+		{
+			/* the offset counts back from the next character, K_WINDOW is 0 */
+			distance = bestDistance & (K_WINDOW - 1);
+			BitFilePutBit(ENCODED, bfpOut);
+			BitFilePutBitsNum(bfpOut, &distance, KERNEL_OFFSET_BITS,
+				sizeof(unsigned int));
+			BitFilePutBitsNum(bfpOut, &best, KERNEL_LENGTH_BITS,
+				sizeof(unsigned int));
+		}
+		else
+		{
+			best = 1;
+			BitFilePutBit(UNCODED, bfpOut);
+			BitFilePutChar(ring[pos & K_RING_MASK], bfpOut);
+		}
+
+		/* chain the characters passed over and read as many new ones */
+		for (i = 0; i < best; i++)
+		{
+			if (avail - pos > MAX_UNCODED)
+			{
+				h = WidthsHash(ring, pos, K_RING_MASK);
+				prev[pos & (K_WINDOW - 1)] = head[h];
+				head[h] = pos + 1;
+			}
+
+			pos++;
+
+			if ((c != EOF) && ((c = BitFileGetChar(bfpIn)) != EOF))
+			{
+				ring[avail & K_RING_MASK] = (unsigned char)c;
+				avail++;
+			}
+		}
+	}
+
+	free(ring);
+	free(head);
+	free(prev);
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : KERNEL_DECODE
+*   Description: This function decodes the items of a stream with these
+*				 widths, after its header, as DecodeLZSS does.
+*   Parameters : bfpIn - pointer to the bit file to decode
+*                bfpOut - pointer to the bit file to write decoded output
+*                fill - the character the window starts filled with
+*   Effects    : bfpIn is decoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int KERNEL_DECODE(bit_file_t *bfpIn, bit_file_t *bfpOut, int fill)
+{
+	unsigned char *window;
+	unsigned char string[K_MAX_CODED];
+	unsigned int nextChar, offset, length, i;
+	int c;
+
+	window = (unsigned char *)malloc(K_WINDOW);
+
+	if (NULL == window)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	memset(window, fill, K_WINDOW);
+	nextChar = 0;
+
+	while ((c = BitFileGetBit(bfpIn)) != EOF)
+	{
+		if (c == UNCODED)
+		{
+			if ((c = BitFileGetChar(bfpIn)) == EOF)
+			{
+				break;
+			}
+
+			BitFilePutChar(c, bfpOut);
+			window[nextChar] = (unsigned char)c;
+			nextChar = (nextChar + 1) & (K_WINDOW - 1);
+		}
+		else
+		{
+			offset = 0;
+			length = 0;
+
+			if ((BitFileGetBitsNum(bfpIn, &offset, KERNEL_OFFSET_BITS,
+				sizeof(unsigned int)) == EOF) ||
+				(BitFileGetBitsNum(bfpIn, &length, KERNEL_LENGTH_BITS,
+				sizeof(unsigned int)) == EOF))
+			{
+				break;
+			}
+
+			/* read the whole string before writing it, as DecodeLZSS does */
+			offset = (nextChar - offset) & (K_WINDOW - 1);
+
+			for (i = 0; i < length; i++)
+			{
+				string[i] = window[(offset + i) & (K_WINDOW - 1)];
+				BitFilePutChar(string[i], bfpOut);
+			}
+
+			for (i = 0; i < length; i++)
+			{
+				window[(nextChar + i) & (K_WINDOW - 1)] = string[i];
+			}
+
+			nextChar = (nextChar + length) & (K_WINDOW - 1);
+		}
+	}
+
+	free(window);
+	return 0;
+}
+
+#undef K_WINDOW
+#undef K_MAX_CODED
+#undef K_RING_MASK
+
+#undef KERNEL_OFFSET_BITS
+#undef KERNEL_LENGTH_BITS
+#undef KERNEL_ENCODE
+#undef KERNEL_DECODE
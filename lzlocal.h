@@ -37,7 +37,9 @@
 /***************************************************************************
 *                             INCLUDED FILES
 ***************************************************************************/
+#include <stdio.h>
 #include <limits.h>
+#include <stddef.h>
 
 /***************************************************************************
 *                                CONSTANTS
@@ -64,6 +66,13 @@
 #define PAIR       0       /* (off,length) */
 #define TRIPLE     1       /* (off,length,slide) */
 
+/* tokens read from the input of a stage at a time */
+#define TOKEN_CHUNK     4096
+
+#if (OFFSET_BITS > 16) || (LENGTH_BITS > 8) || (SLIDE_BITS > 16)
+#error "token_buffer_t is too narrow for the bit widths"
+#endif
+
 /***************************************************************************
 *                            TYPE DEFINITIONS
 ***************************************************************************/
@@ -95,6 +104,63 @@ typedef struct item
 	int Encoded; 
 } item;
 
+/***************************************************************************
+* The state of one encoder or decoder.  Every codec has its own context, so
+* any number of them may run at the same time.  searchData belongs to the
+* match finding method (brute.c, hash.c, tree.c or sarray.c), which defines
+* struct search_data_t.  It is allocated by InitializeSearchStructures and
+* freed by FreeSearchStructures.
+***************************************************************************/
+typedef struct search_data_t search_data_t;
+
+typedef struct lzss_ctx_t
+{
+    /* cyclic buffer sliding window of already read characters */
+    unsigned char slidingWindow[WINDOW_SIZE];
+    unsigned char uncodedLookahead[MAX_CODED];
+    search_data_t *searchData;
+} lzss_ctx_t;
+
+/***************************************************************************
+* A stage of the pipeline, reading bfpIn and writing bfpOut (bitfile.h).
+***************************************************************************/
+struct bit_file_t;
+typedef int (*stage_func_t)(struct bit_file_t *bfpIn,
+    struct bit_file_t *bfpOut);
+
+/***************************************************************************
+* What SearchSegment tells about the ends of a segment of a text, so that
+* the occurrences of the pattern that cross segments can be found.  head
+* holds the first characters of the segment, up to m - 1 of them, as long
+* as they are all pattern characters.  state is the state of the KMP
+* automaton after the last character.
+***************************************************************************/
+typedef struct search_edge_t
+{
+    unsigned char *head;
+    size_t headLength;
+    size_t state;
+    unsigned long long length;  /* number of characters in the segment */
+} search_edge_t;
+
+/***************************************************************************
+* Items on their way between the stages, one array for every field, so the
+* stages pass them on without packing them to bits and reading them back.
+* A character has kind UNCODED, length 1 and the character in offset, a
+* pointer has kind ENCODED.  The bit formats are only read and written by
+* the Unpack and Pack functions of lzss.c, at the ends of a chain of stages.
+***************************************************************************/
+typedef struct token_buffer_t
+{
+    unsigned char *kind;
+    unsigned short *offset;
+    unsigned char *length;
+    unsigned short *slide;
+    size_t count;
+    size_t size;                /* tokens allocated */
+    int failed;                 /* a token was lost for memory */
+} token_buffer_t;
+
 
 /***************************************************************************
 *                                 MACROS
@@ -118,15 +184,76 @@ typedef struct item
 *
 * InitializeSearchStructures and ReplaceChar return 0 for success and -1
 * for a failure.  errno will be set in the event of a failure.
+* FreeSearchStructures releases what InitializeSearchStructures allocated
+* and may be called on a context it failed on.
 *
 * FindMatch will return the encoded_string_t value referencing the match
 * in the sliding window dictionary.  the length field will be 0 if no
 * match is found.
 ***************************************************************************/
-int InitializeSearchStructures(void);
-int ReplaceChar(const unsigned int charIndex, const unsigned char replacement);
+int InitializeSearchStructures(lzss_ctx_t *ctx);
+void FreeSearchStructures(lzss_ctx_t *ctx);
+int ReplaceChar(lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned char replacement);
 
-encoded_string_t FindMatch(const unsigned int windowHead,
+encoded_string_t FindMatch(lzss_ctx_t *ctx, const unsigned int windowHead,
     const unsigned int uncodedHead);
 
+/***************************************************************************
+* RunFileStage runs a stage on two open files and RunBufferStage on a buffer
+* in memory, allocating the output buffer (see lzss.c).  They return 0 for
+* success and -1 for failure.  errno will be set in the event of a failure.
+***************************************************************************/
+int RunFileStage(stage_func_t stage, FILE *fpIn, FILE *fpOut);
+int RunBufferStage(stage_func_t stage, const unsigned char *in,
+    size_t inSize, unsigned char **out, size_t *outSize);
+
+/***************************************************************************
+* FindStage returns the stage of a stream_stage_t (lzss.h), or NULL with
+* errno set to EINVAL.
+***************************************************************************/
+stage_func_t FindStage(int stage);
+
+/***************************************************************************
+* Checksum32 returns the XXH32 hash of the size bytes at data, which block
+* files keep for every block (see checksum.c).
+***************************************************************************/
+unsigned long Checksum32(const void *data, size_t size, unsigned long seed);
+
+/***************************************************************************
+* TokensInit makes an empty token buffer with room for TOKEN_CHUNK tokens,
+* and returns 0 for success and -1 for failure.  TokensFree frees it.
+* UnpackProject appends the items of a project format bit file to a token
+* buffer until it holds TOKEN_CHUNK tokens, and returns EOF at the end of
+* the file, 0 otherwise (see lzss.c).
+***************************************************************************/
+int TokensInit(token_buffer_t *tokens);
+void TokensFree(token_buffer_t *tokens);
+int UnpackProject(struct bit_file_t *bfpIn, token_buffer_t *tokens);
+
+/***************************************************************************
+* DecodeSlideBuf decodes a buffer written by AddSlide into a buffer it
+* allocates, without the cast stages (see lzss.c).  It returns 0 for
+* success and -1 for failure.  errno will be set in the event of a failure.
+***************************************************************************/
+int DecodeSlideBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+
+/***************************************************************************
+* Compressed matching of a text split into segments encoded on their own
+* (see SearchBlocks).  SearchSegment searches one segment and returns the
+* number of occurrences in it, or -1 for failure.  SearchStitch finds the
+* occurrences that end in the head of a segment and start before it, adds
+* their number to count, and returns the state of the automaton after the
+* segment, or -1 for failure.  errno will be set in the event of a failure.
+***************************************************************************/
+long SearchSegment(const unsigned char *in, size_t inSize,
+    const unsigned char *pattern, size_t m,
+    void (*matchFunc)(unsigned long long offset, void *userData),
+    void *userData, search_edge_t *edge);
+long SearchStitch(const unsigned char *pattern, size_t m, size_t state,
+    const search_edge_t *edge, unsigned long long start,
+    void (*matchFunc)(unsigned long long offset, void *userData),
+    void *userData, long *count);
+
 #endif      /* ndef _LZSS_LOCAL_H */
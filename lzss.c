@@ -37,8 +37,10 @@
 *                             INCLUDED FILES
 ***************************************************************************/
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include "lzss.h"
 #include "lzlocal.h"
 #include "bitfile.h"
 
@@ -55,48 +57,182 @@
 ***************************************************************************/
 
 /***************************************************************************
-*                                CONSTANTS
+* State of the slide stage: which of the last BUFFER_SIZE characters of the
+* text were encoded by pointers.
+***************************************************************************/
+typedef struct slide_t
+{
+	item Buffer[BUFFER_SIZE];
+	int BufferIndex;
+} slide_t;
+
+/***************************************************************************
+* State of the cast stage.  Buffer holds the last WINDOW_SIZE items of the
+* text, and every pointer is queued on the item it has to be written
+* before.
+***************************************************************************/
+typedef struct cast_t
+{
+	encoded Buffer[WINDOW_SIZE];
+	long long textPos[WINDOW_SIZE];         /* text position of every item */
+	unsigned int pendingFirst[WINDOW_SIZE]; /* pointers queued on an item */
+	unsigned int pendingLast[WINDOW_SIZE];
+	unsigned int pendingNext[WINDOW_SIZE];
+	unsigned int textItem[BUFFER_SIZE];     /* item at a text position */
+	unsigned int head, tail, len;
+	long long headPos, tailPos;             /* text position of head, tail */
+	unsigned int toPrintOutput;
+} cast_t;
+
+/***************************************************************************
+* State of the cast back stage.  Buffer holds the pointers read before the
+* text position they are written at, queued at that position.
+***************************************************************************/
+typedef struct cast_back_t
+{
+	encoded Buffer[BUFFER_SIZE];
+	unsigned int head;
+	unsigned int toPrintOutput;
+} cast_back_t;
+
+/* the slide and cast stages EncodeProject runs the tokens through */
+typedef struct project_t
+{
+	slide_t slide;
+	cast_t cast;
+	token_buffer_t tokens;              /* cast tokens not written yet */
+} project_t;
+
+/***************************************************************************
+* The text as the encoder sees it: the sliding window and lookahead of a
+* context with their heads, and the number of characters in the lookahead,
+* which goes down only at the end of the text.
+***************************************************************************/
+typedef struct text_t
+{
+	lzss_ctx_t ctx;
+	bit_file_t *bfpIn;
+	unsigned int windowHead, uncodedHead;
+	unsigned int len;
+} text_t;
+
+/***************************************************************************
+* The bits of an encoded buffer as DecodeFlat reads them.  The low count
+* bits of bits are the next ones of the stream, first bit highest.
 ***************************************************************************/
+typedef struct bit_reader_t
+{
+	const unsigned char *in;
+	size_t inSize;
+	size_t pos;                         /* next byte of in */
+	unsigned long long bits;
+	unsigned int count;
+} bit_reader_t;
 
 /***************************************************************************
-*                            GLOBAL VARIABLES
+*                                CONSTANTS
 ***************************************************************************/
-/* cyclic buffer sliding window of already read characters */
-unsigned char slidingWindow[WINDOW_SIZE];
-unsigned char uncodedLookahead[MAX_CODED];
+
+/* a pointer target lies up to WINDOW_SIZE + SLIDE_SIZE characters ahead of
+ * the characters DecodeProject has written out, its source just behind them */
+#define PROJECT_RING_SIZE   (2 * BUFFER_SIZE)
+
+/* characters of text the optimal parse chooses the items of at a time */
+#define OPTIMAL_CHUNK       (64U << 10)
+
+/* bytes DecodeFlat copies a string with, when there is room after it */
+#define COPY_SIZE           16
+
+/* bits of the longest item of LZSS and of project format */
+#define LZSS_ITEM_BITS      (1 + OFFSET_BITS + LENGTH_BITS)
+#define PROJECT_ITEM_BITS   (2 + OFFSET_BITS + LENGTH_BITS + SLIDE_BITS)
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
+static int EncodeLZSSBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int EncodeLZSSLazyBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int EncodeLZSSOptimalBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int EncodeProjectBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int EncodeProjectLazyBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int EncodeProjectOptimalBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int EncodeProjectSlideBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static stage_func_t ParseStage(parse_mode_t mode, int project);
+static int DecodeLZSSBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static long DecodeFlat(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *room, int grow);
+static void FillBits(bit_reader_t *reader);
+static unsigned int TakeBits(bit_reader_t *reader, unsigned int count);
+static unsigned int TakeNumber(bit_reader_t *reader, unsigned int count);
+static int AddSlideBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int DropSlideBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int CastEncodeBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int CastBackBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int AddSlideCastBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+static int DecodeProjectBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+
+static int EncodeText(bit_file_t *bfpIn, bit_file_t *bfpOut, project_t *project,
+	parse_mode_t mode);
+static int EncodeProjectText(bit_file_t *bfpIn, bit_file_t *bfpOut,
+	parse_mode_t mode);
+static int EncodeOptimal(text_t *text, bit_file_t *bfpOut, project_t *project,
+	int slides);
+static void FindSlides(unsigned int i, long long start, unsigned int offset,
+	unsigned int longest, const unsigned char *from,
+	const unsigned char *coded, unsigned char *tripled);
+static encoded_string_t NextMatch(text_t *text);
+static void Advance(text_t *text);
+static void PutLiteral(bit_file_t *bfpOut, project_t *project, int c);
+static void PutPointer(bit_file_t *bfpOut, project_t *project,
+	encoded_string_t *code);
+
+static void SlideInit(slide_t *slide);
+static void SlideChar(slide_t *slide);
+static unsigned int SlidePointer(slide_t *slide, const encoded_string_t *code);
+static void SlideTokens(slide_t *slide, token_buffer_t *in,
+	token_buffer_t *out);
+
+static void CastInit(cast_t *cast);
+static void CastPutItem(cast_t *cast, const encoded *item,
+	token_buffer_t *out);
+static void CastWriteHead(cast_t *cast, token_buffer_t *out);
+static void CastFinish(cast_t *cast, token_buffer_t *out);
+static void CastTokens(cast_t *cast, token_buffer_t *in, token_buffer_t *out);
+
+static void CastBackInit(cast_back_t *back);
+static void CastBackTokens(cast_back_t *back, token_buffer_t *in,
+	token_buffer_t *out);
+static void CastBackFinish(cast_back_t *back, token_buffer_t *out);
+
+static void PutToken(token_buffer_t *tokens, int kind, unsigned int offset,
+	unsigned int length, unsigned int slide);
+static int UnpackLZSS(bit_file_t *bfpIn, token_buffer_t *tokens);
+static unsigned int TakeField(unsigned long long word, unsigned int first,
+	unsigned int count);
+static void PackLZSS(bit_file_t *bfpOut, token_buffer_t *tokens);
+static void PackProject(bit_file_t *bfpOut, token_buffer_t *tokens);
 
 /***************************************************************************
 *                                FUNCTIONS
 ***************************************************************************/
 
 /****************************************************************************
-*   Function   : EncodeLZSS
-*   Description: This function reads an input file and writes an encoded
-*				 output file according to the traditional LZSS algorithm using Brute force
-*				 matching algorithm. The function doesnt accept self-references.
-*   Parameters : fpIn - pointer to the open binary file to encode
-*                fpOut - pointer to the open binary file to write encoded
-*                       output
-*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
-*                closed after exit.
+*   Function   : RunFileStage
+*   Description: This function runs a stage of the pipeline on two open
+*				 files.
+*   Parameters : stage - the stage to run
+*                fpIn - pointer to the open binary file to read
+*                fpOut - pointer to the open binary file to write output
+*   Effects    : fpIn is read by the stage and its output written to fpOut.
+*                Neither file is closed after exit.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ****************************************************************************/
-int EncodeLZSS(FILE *fpIn, FILE *fpOut) 
+int RunFileStage(stage_func_t stage, FILE *fpIn, FILE *fpOut)
 {
-
+	bit_file_t *bfpIn;
 	bit_file_t *bfpOut;
-	encoded_string_t matchData;
-	int c;
-	unsigned int i,toPrintOutput,len;
-	
-
-	/* head of sliding window and lookahead */
-	unsigned int windowHead, uncodedHead;
+	int result;
 
 	/* validate arguments */
 	if ((NULL == fpIn) || (NULL == fpOut))
@@ -105,1057 +241,2768 @@ int EncodeLZSS(FILE *fpIn, FILE *fpOut)
 		return -1;
 	}
 
+	/* convert input file to bitfile */
+	bfpIn = MakeBitFile(fpIn, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		perror("Making Input File a BitFile");
+		return -1;
+	}
+
 	/* convert output file to bitfile */
 	bfpOut = MakeBitFile(fpOut, BF_WRITE);
 
 	if (NULL == bfpOut)
 	{
 		perror("Making Output File a BitFile");
+		BitFileToFILE(bfpIn);
 		return -1;
 	}
 
-	windowHead = 0;
-	uncodedHead = 0;
-	DEBUG_PRINT();
-	/************************************************************************
-	* Fill the sliding window buffer with some known vales.  DecodeLZSS must
-	* use the same values.  If common characters are used, there's an
-	* increased chance of matching to the earlier strings.
-	************************************************************************/
-	memset(slidingWindow, '~', WINDOW_SIZE * sizeof(unsigned char)); // space -> metilda 
+	result = stage(bfpIn, bfpOut);
 
-	/************************************************************************
-	* Copy MAX_CODED bytes from the input file into the uncoded lookahead
-	* buffer.
-	************************************************************************/
-	for (len = 0; len < MAX_CODED && (c = getc(fpIn)) != EOF; len++)
+	/* we're done, free the bitfile structures */
+	BitFileToFILE(bfpIn);
+
+	if (BitFileToFILE(bfpOut) == NULL)
 	{
-		uncodedLookahead[len] = c;
+		result = -1;
 	}
 
-	if (0 == len)
+	return result;
+}
+
+/****************************************************************************
+*   Function   : RunBufferStage
+*   Description: This function runs a stage of the pipeline on a buffer in
+*				 memory.  The output buffer grows as the stage writes it,
+*				 starting from the size of the input.
+*   Parameters : stage - the stage to run
+*                in - the input buffer
+*                inSize - number of bytes in the input buffer
+*                out - set to the allocated output buffer, which the caller
+*                      has to free
+*                outSize - set to the number of bytes in the output buffer
+*   Effects    : in is read by the stage and its output written to *out.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int RunBufferStage(stage_func_t stage, const unsigned char *in,
+	size_t inSize, unsigned char **out, size_t *outSize)
+{
+	bit_file_t *bfpIn;
+	bit_file_t *bfpOut;
+	size_t unused;
+	int result;
+
+	/* validate arguments */
+	if (((NULL == in) && (inSize != 0)) || (NULL == out) || (NULL == outSize))
 	{
-		return 0;   /* inFile was empty */
+		errno = EINVAL;
+		return -1;
 	}
 
-	/* Look for matching string in sliding window */
-	i = InitializeSearchStructures();
+	*out = NULL;
+	*outSize = 0;
 
-	if (0 != i)
+	bfpIn = MakeMemoryBitFile(in, inSize, BF_READ);
+
+	if (NULL == bfpIn)
 	{
-		return i;       /* InitializeSearchStructures returned an error */
+		return -1;
 	}
 
-	matchData = FindMatch(windowHead, uncodedHead);
+	bfpOut = MakeMemoryBitFile(NULL, inSize, BF_WRITE);
 
-	/* now encoded the rest of the file until an EOF is read */
-	while (len > 0)
+	if (NULL == bfpOut)
 	{
-		if (matchData.length > len)
-		{
-			/* garbage beyond last data happened to extend match length */
-			matchData.length = len;
-		}
+		BitFileToMemory(bfpIn, &unused);
+		return -1;
+	}
 
-		if (matchData.length <= MAX_UNCODED)
-		{
-			/* not long enough match.  write uncoded flag and character */
-			BitFilePutBit(UNCODED, bfpOut);
-			BitFilePutChar(uncodedLookahead[uncodedHead], bfpOut);		
-			matchData.length = 1;   /* set to 1 for 1 byte uncoded */
-			if(toPrintOutput == 1)
-				printf("%c,",uncodedLookahead[uncodedHead]);
-		}
-		else
-		{
+	result = stage(bfpIn, bfpOut);
 
-			/* change the offset format */ 
-			if(windowHead > matchData.offset)
-			{
-				matchData.offset = windowHead - matchData.offset;// Wrap((windowHead - matchData.offset),WINDOW_SIZE);
-			}
-			else
-			{
-				matchData.offset = windowHead + WINDOW_SIZE - matchData.offset  ;
-			}
+	BitFileToMemory(bfpIn, &unused);
+	*out = BitFileToMemory(bfpOut, outSize);
 
+	if (NULL == *out)
+	{
+		*outSize = 0;
+		return -1;
+	}
 
+	if (result != 0)
+	{
+		free(*out);
+		*out = NULL;
+		*outSize = 0;
+	}
 
-			/* match length > MAX_UNCODED.  Encode as offset and length. */
-			BitFilePutBit(ENCODED, bfpOut);
-			BitFilePutBitsNum(bfpOut, &matchData.offset, OFFSET_BITS, sizeof(unsigned int));
-			BitFilePutBitsNum(bfpOut, &matchData.length, LENGTH_BITS, sizeof(unsigned int));
+	return result;
+}
 
-			if(toPrintOutput == 1)
-			{
-				printf("(%d,",matchData.offset);
-				printf("%d),",matchData.length);             
-			}
-			if(matchData.length > matchData.offset)
-				printf("length is %d bigger than offset %d\n",matchData.length,matchData.offset);
-		}
+/****************************************************************************
+*   Function   : EncodeLZSS
+*   Description: This function reads an input file and writes an encoded
+*				 output file according to the traditional LZSS algorithm using Brute force
+*				 matching algorithm. The function doesnt accept self-references.
+*   Parameters : fpIn - pointer to the open binary file to encode
+*                fpOut - pointer to the open binary file to write encoded
+*                       output
+*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int EncodeLZSS(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(EncodeLZSSBits, fpIn, fpOut);
+}
 
-		/********************************************************************
-		* Replace the matchData.length worth of bytes we've matched in the
-		* sliding window with new bytes from the input file.
-		********************************************************************/
-		i = 0;
-		while ((i < matchData.length) && ((c = getc(fpIn)) != EOF))
-		{
-			/* add old byte into sliding window and new into lookahead */
-			ReplaceChar(windowHead, uncodedLookahead[uncodedHead]);
-			uncodedLookahead[uncodedHead] = c;
-			windowHead = Wrap((windowHead + 1), WINDOW_SIZE);
-			uncodedHead = Wrap((uncodedHead + 1), MAX_CODED);
-			i++;
-		}
+/****************************************************************************
+*   Function   : EncodeLZSSParse
+*   Description: This function reads an input file and writes an encoded
+*				 output file according to the traditional LZSS algorithm,
+*				 choosing between characters and pointers as mode says.
+*				 PARSE_GREEDY gives the output of EncodeLZSS.
+*   Parameters : fpIn - pointer to the open binary file to encode
+*                fpOut - pointer to the open binary file to write encoded
+*                       output
+*                mode - PARSE_GREEDY, PARSE_LAZY or PARSE_OPTIMAL, and
+*                       PARSE_SLIDE is PARSE_OPTIMAL
+*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int EncodeLZSSParse(FILE *fpIn, FILE *fpOut, parse_mode_t mode)
+{
+	stage_func_t stage;
 
-		/* handle case where we hit EOF before filling lookahead */
-		while (i < matchData.length)
-		{
-			ReplaceChar(windowHead, uncodedLookahead[uncodedHead]);
-			/* nothing to add to lookahead here */
-			windowHead = Wrap((windowHead + 1), WINDOW_SIZE);
-			uncodedHead = Wrap((uncodedHead + 1), MAX_CODED);
-			len--;
-			i++;
-		}
+	stage = ParseStage(mode, 0);
 
-		/* find match for the remaining characters */
-		matchData = FindMatch(windowHead, uncodedHead);
+	if (NULL == stage)
+	{
+		return -1;
 	}
 
-	/* we've encoded everything, free bitfile structure */
-	BitFileToFILE(bfpOut);
+	return RunFileStage(stage, fpIn, fpOut);
+}
 
-	return 0;
+/****************************************************************************
+*   Function   : EncodeLZSSBits
+*                EncodeLZSSLazyBits
+*                EncodeLZSSOptimalBits
+*   Description: These functions encode a bit file according to the
+*				 traditional LZSS algorithm, parsing the text greedily,
+*				 lazily or optimally, for EncodeLZSS, EncodeLZSSParse and
+*				 their buffer versions.
+*   Parameters : bfpIn - pointer to the bit file to encode
+*                bfpOut - pointer to the bit file to write encoded output
+*   Effects    : bfpIn is encoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int EncodeLZSSBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeText(bfpIn, bfpOut, NULL, PARSE_GREEDY);
+}
+
+static int EncodeLZSSLazyBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeText(bfpIn, bfpOut, NULL, PARSE_LAZY);
+}
+
+static int EncodeLZSSOptimalBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeText(bfpIn, bfpOut, NULL, PARSE_OPTIMAL);
 }
 
+/****************************************************************************
+*   Function   : EncodeProject
+*   Description: This function reads an input file and writes it encoded
+*				 according to project format v2 in a single pass.  It gives
+*				 the same output as EncodeLZSS, AddSlide and CastEncodeLZSS
+*				 run one after the other, but the slide of every pointer is
+*				 found and the pointer is moved to its place in memory, as
+*				 the encoder produces it.
+*   Parameters : fpIn - pointer to the open binary file to encode
+*                fpOut - pointer to the open binary file to write encoded
+*                       output according to project format.
+*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int EncodeProject(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(EncodeProjectBits, fpIn, fpOut);
+}
 
 /****************************************************************************
-*   Function   : DecodeLZSS
-*   Description: This function decodes a LZSS encoded file.
-*				 The function replaces every pointer with the
-*				 substring the pointer points to.
-*   Parameters : fpIn - pointer to the open binary file to decode
-*                fpOut - pointer to the open binary file to write decoded
-*                       output
-*   Effects    : fpIn is decoded and written to fpOut.  Neither file is
+*   Function   : EncodeProjectParse
+*   Description: This function is EncodeProject, choosing between
+*				 characters and pointers as mode says.  PARSE_GREEDY gives
+*				 the output of EncodeProject.
+*   Parameters : fpIn - pointer to the open binary file to encode
+*                fpOut - pointer to the open binary file to write encoded
+*                       output according to project format.
+*                mode - PARSE_GREEDY, PARSE_LAZY, PARSE_OPTIMAL or
+*                       PARSE_SLIDE
+*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
 *                closed after exit.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ****************************************************************************/
-int DecodeLZSS(FILE *fpIn, FILE *fpOut)
+int EncodeProjectParse(FILE *fpIn, FILE *fpOut, parse_mode_t mode)
 {
-	bit_file_t *bfpIn;
-	int c;
-	unsigned int i, nextChar,toPrintOutput;
-	encoded_string_t code;              
+	stage_func_t stage;
 
-	/* use stdin if no input file */
-	if ((NULL == fpIn) || (NULL == fpOut))
+	stage = ParseStage(mode, 1);
+
+	if (NULL == stage)
 	{
-		errno = ENOENT;
 		return -1;
 	}
 
-	/* convert input file to bitfile */
-	bfpIn = MakeBitFile(fpIn, BF_READ);
+	return RunFileStage(stage, fpIn, fpOut);
+}
 
-	if (NULL == bfpIn)
+/****************************************************************************
+*   Function   : EncodeProjectBits
+*                EncodeProjectLazyBits
+*                EncodeProjectOptimalBits
+*                EncodeProjectSlideBits
+*   Description: These functions encode a bit file according to project
+*				 format v2 in a single pass, parsing the text greedily,
+*				 lazily, optimally or optimally with the slides counted,
+*				 for EncodeProject, EncodeProjectParse and their buffer
+*				 versions.
+*   Parameters : bfpIn - pointer to the bit file to encode
+*                bfpOut - pointer to the bit file to write encoded output
+*				 according to project format
+*   Effects    : bfpIn is encoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int EncodeProjectBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeProjectText(bfpIn, bfpOut, PARSE_GREEDY);
+}
+
+static int EncodeProjectLazyBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeProjectText(bfpIn, bfpOut, PARSE_LAZY);
+}
+
+static int EncodeProjectOptimalBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeProjectText(bfpIn, bfpOut, PARSE_OPTIMAL);
+}
+
+static int EncodeProjectSlideBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	return EncodeProjectText(bfpIn, bfpOut, PARSE_SLIDE);
+}
+
+/****************************************************************************
+*   Function   : EncodeProjectText
+*   Description: This function encodes a bit file according to project
+*				 format v2 in a single pass, running the tokens of
+*				 EncodeText through the slide and cast stages.
+*   Parameters : bfpIn - pointer to the bit file to encode
+*                bfpOut - pointer to the bit file to write encoded output
+*				 according to project format
+*                mode - how the text is parsed
+*   Effects    : bfpIn is encoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int EncodeProjectText(bit_file_t *bfpIn, bit_file_t *bfpOut,
+	parse_mode_t mode)
+{
+	project_t project;
+	int result;
+
+	if (TokensInit(&project.tokens) != 0)
 	{
-		perror("Making Input File a BitFile");
 		return -1;
 	}
-	
-	DEBUG_PRINT();
 
-	/************************************************************************
-	* Fill the sliding window buffer with some known vales.  EncodeLZSS must
-	* use the same values.  If common characters are used, there's an
-	* increased chance of matching to the earlier strings.
-	************************************************************************/
-	memset(slidingWindow, '~', WINDOW_SIZE * sizeof(unsigned char)); // space -> metilda 
+	SlideInit(&project.slide);
+	CastInit(&project.cast);
 
-	nextChar = 0;
+	result = EncodeText(bfpIn, bfpOut, &project, mode);
 
-	while (1)
+	/* write the items that remain in the cast buffer */
+	CastFinish(&project.cast, &project.tokens);
+	PackProject(bfpOut, &project.tokens);
+
+	if ((0 == result) && project.tokens.failed)
 	{
-		if ((c = BitFileGetBit(bfpIn)) == EOF)
-		{
-			/* we hit the EOF */
-			break;
-		}
+		errno = ENOMEM;
+		result = -1;
+	}
 
-		if (c == UNCODED)
-		{
-			/* uncoded character */
-			if ((c = BitFileGetChar(bfpIn)) == EOF)
-			{
-				break;
-			}
+	TokensFree(&project.tokens);
+	return result;
+}
 
-			/* write out byte and put it in sliding window */
-			putc(c, fpOut);
-			slidingWindow[nextChar] = c;
-			nextChar = Wrap((nextChar + 1), WINDOW_SIZE);
-			if(toPrintOutput == 1)
-				printf("%c",c);
-		}
-		else
-		{
-			/* offset and length */
-			code.offset = 0;
-			code.length = 0;
+/****************************************************************************
+*   Function   : ParseStage
+*   Description: This function finds the encoding stage of a parse mode.
+*   Parameters : mode - the parse mode
+*                project - 0 for LZSS output, 1 for project format output
+*   Effects    : None
+*   Returned   : The stage, NULL with errno set to EINVAL for an unknown
+*                mode.
+****************************************************************************/
+static stage_func_t ParseStage(parse_mode_t mode, int project)
+{
+	switch (mode)
+	{
+		case PARSE_GREEDY:
+			return project ? EncodeProjectBits : EncodeLZSSBits;
 
-			if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS,
-				sizeof(unsigned int))) == EOF)
-			{
-				break;
-			}
-
-			if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS,
-				sizeof(unsigned int))) == EOF)
-			{
-				break;
-			}
-			
-
-			/* change the offset format */ 
-			if(nextChar > code.offset)
-			{
-				code.offset = nextChar - code.offset;//Wrap((nextChar - code.offset),WINDOW_SIZE);
-			}
-			else
-			{
-				code.offset = nextChar + WINDOW_SIZE - code.offset  ;
-			}
-
-			/****************************************************************
-			* Write out decoded string to file and lookahead.  It would be
-			* nice to write to the sliding window instead of the lookahead,
-			* but we could end up overwriting the matching string with the
-			* new string if abs(offset - next char) < match length.
-			****************************************************************/
-			for (i = 0; i < code.length; i++)
-			{
-				c = slidingWindow[Wrap((code.offset + i), WINDOW_SIZE)];
-				putc(c, fpOut);
-				uncodedLookahead[i] = c;
-				if(toPrintOutput == 1)
-					printf("%c",c);
-			}
+		case PARSE_LAZY:
+			return project ? EncodeProjectLazyBits : EncodeLZSSLazyBits;
 
-			/* write out decoded string to sliding window */
-			for (i = 0; i < code.length; i++)
-			{
-				slidingWindow[Wrap((nextChar + i), WINDOW_SIZE)] =
-					uncodedLookahead[i];
-			}
+		case PARSE_OPTIMAL:
+			return project ? EncodeProjectOptimalBits : EncodeLZSSOptimalBits;
 
-			nextChar = Wrap((nextChar + code.length), WINDOW_SIZE);
-		}
+		case PARSE_SLIDE:
+			/* LZSS has no slides, so it is parsed as PARSE_OPTIMAL */
+			return project ? EncodeProjectSlideBits : EncodeLZSSOptimalBits;
 	}
 
-	/* we've decoded everything, free bitfile structure */
-	BitFileToFILE(bfpIn);
-
-	return 0;
+	errno = EINVAL;
+	return NULL;
 }
 
 /****************************************************************************
-*   Function   : diff
-*   Description: The function gets two files, and checks whether the files are the same.
-*   Parameters : fpIn1 - pointer to first file
-*                fpIn2 - pointer to second file
-*   Effects    : print to screen the result
-*   Returned   : void
+*   Function   : FindStage
+*   Description: This function finds the stage a stream runs.
+*   Parameters : stage - the stream_stage_t of the stream
+*   Effects    : None
+*   Returned   : The stage, NULL with errno set to EINVAL for an unknown
+*                stage.
 ****************************************************************************/
-void diff(FILE *fpIn1, FILE *fpIn2){
-	unsigned int C1 , C2;
-	unsigned int flag=0;
-
-	while((C1 = getc(fpIn1)) != EOF){
-		C2 = getc(fpIn2);
-		if(C1 != C2){
-			flag = 1;
-			break;
-		}
-	}
-	C2 = getc(fpIn2);
-	if(C1 != C2){
-		flag = 1;
-	}
-	if(flag == 0){
-		printf("The files are the same\n");
-	}
-	else{
-		printf("The files are not the same !!\n");
-	}
-
-}
+stage_func_t FindStage(int stage)
+{
+	switch (stage)
+	{
+		case STREAM_ENCODE_LZSS:
+			return EncodeLZSSBits;
+
+		case STREAM_ENCODE_PROJECT:
+			return EncodeProjectBits;
+
+		case STREAM_DECODE_LZSS:
+			return DecodeLZSSBits;
+
+		case STREAM_ADD_SLIDE:
+			return AddSlideBits;
+
+		case STREAM_CAST_ENCODE:
+			return CastEncodeBits;
+
+		case STREAM_CAST_BACK:
+			return CastBackBits;
+
+		case STREAM_ADD_SLIDE_CAST:
+			return AddSlideCastBits;
+
+		case STREAM_DECODE_PROJECT:
+			return DecodeProjectBits;
+	}
+
+	errno = EINVAL;
+	return NULL;
+}
 
 /****************************************************************************
-*   Function   : AddSlide
-*   Description: This function gets a LZSS compressed file and adapts it to include a slide parameter in every pointer. 
-*   Parameters : fpIn - pointer to the LZSS encoded file
-*                fpOut - pointer to the open binary file to write encoded
-*                       output with slide
-*   Effects    : fpIn get slide parameter for every poiner and written to fpOut.  Neither file is
-*                closed after exit.
+*   Function   : EncodeText
+*   Description: This function reads an input file and encodes it according
+*				 to the traditional LZSS algorithm.  The function doesn't
+*				 accept "self-references".  Without a project the tokens
+*				 are written to bfpOut in LZSS format, otherwise they go
+*				 through the slide and cast stages of the project.
+*				 PARSE_GREEDY takes the longest match at every position.
+*				 PARSE_LAZY first looks for a match at the next position
+*				 and writes a character instead if that one is longer.
+*				 PARSE_OPTIMAL and PARSE_SLIDE are done by EncodeOptimal.
+*   Parameters : bfpIn - pointer to the bitfile to encode
+*                bfpOut - pointer to the bitfile to write encoded output
+*                project - slide and cast stages, or NULL for LZSS output
+*                mode - how the text is parsed
+*   Effects    : bfpIn is encoded and written to bfpOut.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ****************************************************************************/
-int AddSlide(FILE *fpIn, FILE *fpOut)// remove pointer with length = 0
-{
-	bit_file_t *bfpIn;
-	bit_file_t *bfpOut;
-	unsigned int i,j,slide,tempIndex,toPrintOutput;
-	int c,BufferIndex;
-	item Buffer[BUFFER_SIZE];
-	encoded_string_t code;
-	int temp;
-
-	DEBUG_PRINT();
-	/* convert input file to bitfile */
-	bfpIn = MakeBitFile(fpIn, BF_READ);
+static int EncodeText(bit_file_t *bfpIn, bit_file_t *bfpOut, project_t *project,
+	parse_mode_t mode)
+{
+	text_t text;
+	encoded_string_t matchData, next;
+	unsigned int i, skip;
+	int c, result;
 
-	if (NULL == bfpIn)
+	text.bfpIn = bfpIn;
+	text.windowHead = 0;
+	text.uncodedHead = 0;
+
+	/************************************************************************
+	* Fill the sliding window buffer with some known vales.  DecodeLZSS must
+	* use the same values.  If common characters are used, there's an
+	* increased chance of matching to the earlier strings.
+	************************************************************************/
+	memset(text.ctx.slidingWindow, '~', WINDOW_SIZE * sizeof(unsigned char)); // space -> metilda 
+
+	/************************************************************************
+	* Copy MAX_CODED bytes from the input file into the uncoded lookahead
+	* buffer.
+	************************************************************************/
+	for (text.len = 0; text.len < MAX_CODED && (c = BitFileGetChar(bfpIn)) != EOF; text.len++)
 	{
-		perror("Making Input File a BitFile");
-		return -1;
+		text.ctx.uncodedLookahead[text.len] = c;
 	}
 
-	/* convert output file to bitfile */
-	bfpOut = MakeBitFile(fpOut, BF_WRITE);
+	if (0 == text.len)
+	{
+		return 0;   /* inFile was empty */
+	}
 
-	if (NULL == bfpOut)
+	/* Look for matching string in sliding window */
+	result = InitializeSearchStructures(&text.ctx);
+
+	if (0 != result)
 	{
-		perror("Making Output File a BitFile");
-		return -1;
-	}
-
-	/************************************************************************
-	* Initialize Buffer and Text arrays  
-	************************************************************************/
-	for(i = 0; i < BUFFER_SIZE; i++)
+		FreeSearchStructures(&text.ctx);
+		return result;  /* InitializeSearchStructures returned an error */
+	}
+
+	if ((PARSE_OPTIMAL == mode) || (PARSE_SLIDE == mode))
 	{
-		Buffer[i].ch = 0;
-		Buffer[i].Encoded = -1;
+		result = EncodeOptimal(&text, bfpOut, project,
+			(PARSE_SLIDE == mode) && (project != NULL));
+		FreeSearchStructures(&text.ctx);
+		return result;
 	}
-	BufferIndex = 0;
-	/************************************************************************
-	* pass over the whole file and insert slide. *  
-	************************************************************************/
 
-	while((c = BitFileGetBit(bfpIn)) != EOF)
+	matchData = NextMatch(&text);
+
+	/* now encoded the rest of the file until an EOF is read */
+	while (text.len > 0)
 	{
-		if( c == UNCODED)
+		if ((PARSE_LAZY == mode) && (matchData.length > MAX_UNCODED) &&
+			(matchData.length < MAX_CODED))
 		{
-			if ((c = BitFileGetChar(bfpIn)) == EOF)
-			{
-				break;
-			}
-			Buffer[BufferIndex].Encoded = UNCODED;
-			BitFilePutBit(UNCODED, bfpOut);
-			BitFilePutChar(c, bfpOut);
-			BufferIndex = Wrap ((BufferIndex + 1) , BUFFER_SIZE);
-			if(toPrintOutput == 1)
-				printf("%c,",c);
-		}
+			/* a longer match at the next position is worth a character */
+			c = text.ctx.uncodedLookahead[text.uncodedHead];
+			Advance(&text);
+			next = NextMatch(&text);
 
-		else // c== CODED
-		{
-			/* offset and length */
-			code.offset = 0;
-			code.length = 0;
-			if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
+			if (next.length > matchData.length)
 			{
-				break;
+				PutLiteral(bfpOut, project, c);
+				matchData = next;
+				continue;
 			}
 
-			if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-			{
-				break;
-			}
-			
-			//find slide
-			if(code.length > 0 )
-			{
-				slide = 0;
-				temp = BufferIndex - code.offset + code.length - 1;
-				tempIndex = Wrap ((temp) , BUFFER_SIZE); // give the index of the last char.
-				while(Buffer[tempIndex].Encoded == ENCODED && slide < (SLIDE_SIZE - 1))
-				{
-					slide++;
-					temp --;
-					tempIndex = Wrap ((temp) , BUFFER_SIZE); // give the index of the first char.
-				}
-				//update Buffer
-				for(j = 0; j < code.length; j++)//find how many chars are ENCODED
-				{
-					Buffer[BufferIndex].Encoded = ENCODED;
-					BufferIndex = Wrap ((BufferIndex + 1) , BUFFER_SIZE);
-				}
-				//write to file
-				if(slide == 0)
-				{
-					BitFilePutBit(ENCODED, bfpOut);
-					BitFilePutBit(PAIR, bfpOut);
-					BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-				}
-				else
-				{
-					BitFilePutBit(ENCODED, bfpOut);
-					BitFilePutBit(TRIPLE, bfpOut);
-					BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &slide, SLIDE_BITS, sizeof(unsigned int));
-				}
+			PutPointer(bfpOut, project, &matchData);
+			skip = matchData.length - 1;
+		}
+		else if (matchData.length > MAX_UNCODED)
+		{
+			/* match length > MAX_UNCODED.  Encode as offset and length. */
+			PutPointer(bfpOut, project, &matchData);
+			skip = matchData.length;
+		}
+		else
+		{
+			/* not long enough match.  write uncoded flag and character */
+			PutLiteral(bfpOut, project,
+				text.ctx.uncodedLookahead[text.uncodedHead]);
+			skip = 1;
+		}
 
-				if(toPrintOutput == 1)
-				{
-					printf("(%d,",code.offset); 
-					printf("%d,",code.length); 
-					printf("%d),",slide); 
-				}
-			}
+		/********************************************************************
+		* Replace the bytes we've encoded in the sliding window with new
+		* bytes from the input file.
+		********************************************************************/
+		for (i = 0; i < skip; i++)
+		{
+			Advance(&text);
 		}
-	}
 
-	/* we've encoded everything, free bitfile structure */
-	BitFileToFILE(bfpIn);
-	BitFileToFILE(bfpOut);
+		/* find match for the remaining characters */
+		matchData = NextMatch(&text);
+	}
 
-	return 0;
-
-}
+	FreeSearchStructures(&text.ctx);
+	return 0;
+}
 
 /****************************************************************************
-*   Function   : CastEncodeLZSS
-*   Description: This function gets a LZSS compressed file with a SLIDE parameter in all pointers, and adjusts it according to project format v2. 
-*   Parameters : fpIn - pointer to the LZSS encoded file with SLIDE parameter
-*                fpOut - pointer to the open binary file to write encoded
-*                       output according to project format. 
-*   Effects    : fpIn moves every pointer to the right place according to the OFFSET and SLIDE parameters and written to fpOut.
-*                Neither file is closed after exit.
+*   Function   : EncodeOptimal
+*   Description: This function encodes the text with the fewest bits,
+*				 OPTIMAL_CHUNK characters at a time.  The longest match at
+*				 every position of a chunk is found first, then the fewest
+*				 bits to every position of the chunk, walking forward: a
+*				 character costs 1 + 8 bits, a pointer of any length up to
+*				 the longest match 1 + OFFSET_BITS + LENGTH_BITS, and one
+*				 more for PAIR in the project format.
+*				 The slide stage makes a pointer a TRIPLE, SLIDE_BITS
+*				 longer, when the last character it copies was encoded by a
+*				 pointer.  With slides counted, FindSlides looks that
+*				 character up on the cheapest way to the position of the
+*				 pointer, and the pointer costs SLIDE_BITS more if it was.
+*				 In the project format a pointer that would be moved before
+*				 the beginning of the text is never taken.
+*   Parameters : text - the text, with the search structures initialized
+*                bfpOut - pointer to the bitfile to write encoded output
+*                project - slide and cast stages, or NULL for LZSS output
+*                slides - 1 to count the slides of pointers, 0 not to
+*   Effects    : The text is encoded and written to bfpOut.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
 *                event of a failure.
 ****************************************************************************/
-int CastEncodeLZSS(FILE *fpIn, FILE *fpOut)
+static int EncodeOptimal(text_t *text, bit_file_t *bfpOut, project_t *project,
+	int slides)
 {
-	bit_file_t *bfpIn;
-	bit_file_t *bfpOut;
-	int c;
-	unsigned int i,j,distance,temp_index,toPrintOutput;
-	encoded_string_t code;              
-	encoded Buffer[WINDOW_SIZE];
-	unsigned int head ,tail,bool_EOF,len;
-	
-	/* use stdin if no input file */
-	if ((NULL == fpIn) || (NULL == fpOut))
-	{
-		errno = ENOENT;
-		return -1;
-	}
-
-	/* convert input file to bitfile */
-	bfpIn = MakeBitFile(fpIn, BF_READ);
-
-	if (NULL == bfpIn)
+	unsigned char *chars, *lengths, *choice, *from, *coded;
+	unsigned int *offsets;
+	unsigned long *cost;
+	unsigned long bits;
+	encoded_string_t matchData;
+	unsigned int n, i, k, length, shortest, longest, literalCost, pointerCost;
+	unsigned char tripled[MAX_CODED + 1];
+	long long start;
+
+	literalCost = 1 + 8;
+	pointerCost = 1 + OFFSET_BITS + LENGTH_BITS + ((NULL == project) ? 0 : 1);
+
+	chars = (unsigned char *)malloc(OPTIMAL_CHUNK);
+	lengths = (unsigned char *)malloc(OPTIMAL_CHUNK);
+	choice = (unsigned char *)malloc(OPTIMAL_CHUNK);
+	from = (unsigned char *)malloc(OPTIMAL_CHUNK + 1);
+	coded = (unsigned char *)calloc(WINDOW_SIZE, 1);
+	offsets = (unsigned int *)malloc(OPTIMAL_CHUNK * sizeof(unsigned int));
+	cost = (unsigned long *)malloc((OPTIMAL_CHUNK + 1) * sizeof(unsigned long));
+
+	if ((NULL == chars) || (NULL == lengths) || (NULL == choice) ||
+		(NULL == from) || (NULL == coded) || (NULL == offsets) ||
+		(NULL == cost))
 	{
-		perror("Making Input File a BitFile");
+		free(chars);
+		free(lengths);
+		free(choice);
+		free(from);
+		free(coded);
+		free(offsets);
+		free(cost);
+		errno = ENOMEM;
 		return -1;
 	}
 
-	/* convert output file to bitfile */
-	bfpOut = MakeBitFile(fpOut, BF_WRITE);
+	start = 0;
 
-	if (NULL == bfpOut)
+	while (text->len > 0)
 	{
-		perror("Making Output File a BitFile");
-		return -1;
-	}
-	DEBUG_PRINT();
-	/************************************************************************
-	* Initialize Buffer and Text arrays  
-	************************************************************************/
-	for(i = 0; i < WINDOW_SIZE; i++)
-	{
-		Buffer[i].ch = 0;
-		Buffer[i].length = 0;
-		Buffer[i].offset = 0;
-		Buffer[i].slide = 0;
-		Buffer[i].bool_writed = 1; /// change to 1 !!!!!!
-	}
+		/* the longest match at every position of the chunk */
+		for (n = 0; (n < OPTIMAL_CHUNK) && (text->len > 0); n++)
+		{
+			matchData = NextMatch(text);
+			chars[n] = text->ctx.uncodedLookahead[text->uncodedHead];
+			lengths[n] = (matchData.length > MAX_UNCODED) ?
+				(unsigned char)matchData.length : 0;
+			offsets[n] = matchData.offset;
+			Advance(text);
+		}
 
-	head = 0;
-	tail = 0;
-	bool_EOF = 0;
+		/* the fewest bits to every position of the chunk, and the last item */
+		cost[0] = 0;
 
-	/************************************************************************
-	*					Fill the Buffer array  
-	************************************************************************/
-	for (len = 0; len < WINDOW_SIZE && (c = BitFileGetBit(bfpIn)) != EOF; len++)
-	{
-		if( c == UNCODED)
+		for (i = 1; i <= n; i++)
 		{
-			if ((c = BitFileGetChar(bfpIn)) == EOF)
-			{
-				break;
-			}
-			Buffer[tail].ch = c;
-			Buffer[tail].length = 1;
-			Buffer[tail].bool_writed = 0;
+			cost[i] = ULONG_MAX;
 		}
-		else
+
+		for (i = 0; i < n; i++)
 		{
-			if ((c = BitFileGetBit(bfpIn)) == EOF)
+			if (cost[i] + literalCost < cost[i + 1])
 			{
-				break;
+				cost[i + 1] = cost[i] + literalCost;
+				from[i + 1] = 1;
 			}
-			code.offset = 0;
-			code.length = 0;
-			code.slide = 0;
-			if (c == PAIR)
+
+			longest = (lengths[i] < n - i) ? lengths[i] : (n - i);
+
+			if (slides && (longest > MAX_UNCODED))
 			{
-				if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-				{
-					c = EOF;
-					break;
-				}
+				FindSlides(i, start, offsets[i], longest, from, coded,
+					tripled);
+			}
 
-				if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
-				}
+			/* the cast moves a pointer to the position after the last
+			 * character it copies, which has to be in the text */
+			shortest = MAX_UNCODED + 1;
 
+			if ((project != NULL) &&
+				((long long)offsets[i] > start + i + shortest))
+			{
+				shortest = (unsigned int)(offsets[i] - (start + i));
 			}
-			else
+
+			for (length = shortest; length <= longest; length++)
 			{
-				if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-				{
-					c = EOF;
-					break;
-				}
+				bits = cost[i] + pointerCost;
 
-				if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
+				if (slides && tripled[length])
 				{
-					break;
+					bits += SLIDE_BITS;
 				}
-				if ((BitFileGetBitsNum(bfpIn, &code.slide, SLIDE_BITS, sizeof(unsigned int))) == EOF)
+
+				if (bits < cost[i + length])
 				{
-					break;
+					cost[i + length] = bits;
+					from[i + length] = (unsigned char)length;
 				}
 			}
-
-			Buffer[tail].offset = code.offset;
-			Buffer[tail].length = code.length;
-			Buffer[tail].slide  = code.slide;
-			Buffer[tail].bool_writed = 0;
 		}
-		tail = Wrap((tail + 1), WINDOW_SIZE);
-	}
 
-	/************************************************************************
-	*					while there is charcters on file  
-	************************************************************************/
-	if(len == WINDOW_SIZE)// buffer full
-	{
-		while(1)
+		/* a pointer may be shorter than the longest match at its position */
+		for (i = n; i > 0; i -= from[i])
 		{
+			choice[i - from[i]] = from[i];
+		}
 
-			/************************************************************************
-			* Part A - check if exist pointer to BufferIndex  
-			************************************************************************/
-			//A.1 check if exist pointer to BufferIndex
-
-			temp_index = head; 
-			
-			distance = 0;
-			
-			for(j = 0; j < len; j++)
+		for (i = 0; i < n; i += choice[i])
+		{
+			if (1 == choice[i])
 			{
-				
-
-				if(Buffer[temp_index].bool_writed == 0 && 
-					Buffer[temp_index].length > 1 &&
-					distance == (Buffer[temp_index].offset - Buffer[temp_index].length + Buffer[temp_index].slide) ) 
-				{
-					// and insert the new pointer
-					code.offset = Buffer[temp_index].offset - Buffer[temp_index].length; 
-					code.length = Buffer[temp_index].length;
-					code.slide  = Buffer[temp_index].slide;
-					if(code.slide == 0)
-					{
-						BitFilePutBit(ENCODED, bfpOut);
-						BitFilePutBit(PAIR, bfpOut);
-						BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-						BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-					}
-					else
-					{
-						BitFilePutBit(ENCODED, bfpOut);
-						BitFilePutBit(TRIPLE, bfpOut);
-						BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-						BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-						BitFilePutBitsNum(bfpOut, &code.slide, SLIDE_BITS, sizeof(unsigned int));
-
-					}
+				PutLiteral(bfpOut, project, chars[i]);
+			}
+			else
+			{
+				matchData.offset = offsets[i];
+				matchData.length = choice[i];
+				PutPointer(bfpOut, project, &matchData);
+			}
 
-					if(toPrintOutput == 1)
-					{
-						printf("(%d,",code.offset);
-						printf("%d,",code.length);
-						printf("%d),",code.slide);             
-					}
-					distance+= Buffer[temp_index].length;
-					Buffer[temp_index].bool_writed = 1;
-				}
-				else
-				{
-					distance+= Buffer[temp_index].length;
-				}
-				temp_index = Wrap((temp_index + 1), WINDOW_SIZE);
+			for (k = 0; k < choice[i]; k++)
+			{
+				coded[(start + i + k) % WINDOW_SIZE] = (1 != choice[i]);
 			}
+		}
+
+		start += n;
+	}
+
+	free(chars);
+	free(lengths);
+	free(choice);
+	free(from);
+	free(coded);
+	free(offsets);
+	free(cost);
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : FindSlides
+*   Description: This function tells which pointers at a position of a
+*				 chunk would be TRIPLEs: those whose last character copied
+*				 is encoded by a pointer on the cheapest way to the
+*				 position.  The way is walked back from the position until
+*				 it passes the characters copied.  Every way starts at the
+*				 beginning of the chunk, so before it the items already
+*				 written tell.
+*   Parameters : i - the position in the chunk
+*                start - text position of the beginning of the chunk
+*                offset - offset of the longest match at i, back from i
+*                longest - length of the longest match at i
+*                from - length of the last item on the cheapest way to
+*                       every position of the chunk up to i, 1 for a
+*                       character
+*                coded - for the last WINDOW_SIZE characters before the
+*                        chunk, 1 if a pointer encoded it
+*                tripled - set to 1 for every length from MAX_UNCODED + 1
+*                          to longest that makes a TRIPLE, 0 for a PAIR
+*   Effects    : tripled is set.
+*   Returned   : None
+****************************************************************************/
+static void FindSlides(unsigned int i, long long start, unsigned int offset,
+	unsigned int longest, const unsigned char *from,
+	const unsigned char *coded, unsigned char *tripled)
+{
+	long long first, last, q, j, stop;
+
+	/* the last characters copied by the shortest and longest pointers */
+	first = (long long)i - offset + MAX_UNCODED;
+	last = (long long)i - offset + longest - 1;
+
+	for (j = i; (j > 0) && (j > first); j = stop)
+	{
+		stop = j - from[j];
+
+		for (q = (stop > first) ? stop : first; (q < j) && (q <= last); q++)
+		{
+			tripled[q - first + MAX_UNCODED + 1] = (from[j] != 1);
+		}
+	}
+
+	for (q = first; (q < 0) && (q <= last); q++)
+	{
+		tripled[q - first + MAX_UNCODED + 1] =
+			(start + q >= 0) && coded[(start + q) % WINDOW_SIZE];
+	}
+}
+
+/****************************************************************************
+*   Function   : NextMatch
+*   Description: This function finds the longest match of the lookahead of
+*				 a text in its sliding window.
+*   Parameters : text - the text
+*   Effects    : None
+*   Returned   : The match, with its offset back from the next character
+*                and its length no longer than the lookahead.
+****************************************************************************/
+static encoded_string_t NextMatch(text_t *text)
+{
+	encoded_string_t matchData;
+
+	matchData = FindMatch(&text->ctx, text->windowHead, text->uncodedHead);
+
+	if (matchData.length > text->len)
+	{
+		/* garbage beyond last data happened to extend match length */
+		matchData.length = text->len;
+	}
+
+	/* change the offset format */
+	if (text->windowHead > matchData.offset)
+	{
+		matchData.offset = text->windowHead - matchData.offset;
+	}
+	else
+	{
+		matchData.offset = text->windowHead + WINDOW_SIZE - matchData.offset;
+	}
+
+	return matchData;
+}
+
+/****************************************************************************
+*   Function   : Advance
+*   Description: This function moves the next character of a text from the
+*				 lookahead to the sliding window and reads a new one into
+*				 the lookahead.
+*   Parameters : text - the text
+*   Effects    : The heads of the text move one character.  At the end of
+*                the text the lookahead gets shorter.
+*   Returned   : None
+****************************************************************************/
+static void Advance(text_t *text)
+{
+	int c;
+
+	/* add old byte into sliding window and new into lookahead */
+	ReplaceChar(&text->ctx, text->windowHead,
+		text->ctx.uncodedLookahead[text->uncodedHead]);
+
+	if ((c = BitFileGetChar(text->bfpIn)) != EOF)
+	{
+		text->ctx.uncodedLookahead[text->uncodedHead] = c;
+	}
+	else
+	{
+		/* nothing to add to lookahead here */
+		text->len--;
+	}
+
+	text->windowHead = Wrap((text->windowHead + 1), WINDOW_SIZE);
+	text->uncodedHead = Wrap((text->uncodedHead + 1), MAX_CODED);
+}
+
+/****************************************************************************
+*   Function   : PutLiteral
+*   Description: This function writes an uncoded character, in LZSS format
+*				 or through the slide and cast stages of a project.
+*   Parameters : bfpOut - pointer to the bitfile to write encoded output
+*                project - slide and cast stages, or NULL for LZSS output
+*                c - the character
+*   Effects    : The character is written to bfpOut or queued in the cast
+*                stage.
+*   Returned   : None
+****************************************************************************/
+static void PutLiteral(bit_file_t *bfpOut, project_t *project, int c)
+{
+	encoded pointer;
+	unsigned int toPrintOutput;
+
+	DEBUG_PRINT();
+
+	if (NULL == project)
+	{
+		BitFilePutBit(UNCODED, bfpOut);
+		BitFilePutChar(c, bfpOut);
+	}
+	else
+	{
+		SlideChar(&project->slide);
+		pointer.ch = c;
+		pointer.offset = 0;
+		pointer.length = 1;
+		pointer.slide = 0;
+		CastPutItem(&project->cast, &pointer, &project->tokens);
+
+		if (project->tokens.count >= TOKEN_CHUNK)
+		{
+			PackProject(bfpOut, &project->tokens);
+		}
+	}
+
+	if(toPrintOutput == 1)
+		printf("%c,",c);
+}
+
+/****************************************************************************
+*   Function   : PutPointer
+*   Description: This function writes a pointer, in LZSS format or through
+*				 the slide and cast stages of a project.
+*   Parameters : bfpOut - pointer to the bitfile to write encoded output
+*                project - slide and cast stages, or NULL for LZSS output
+*                code - the pointer, with its offset back from the next
+*                       character
+*   Effects    : The pointer is written to bfpOut or queued in the cast
+*                stage.
+*   Returned   : None
+****************************************************************************/
+static void PutPointer(bit_file_t *bfpOut, project_t *project,
+	encoded_string_t *code)
+{
+	encoded pointer;
+	unsigned int toPrintOutput;
+
+	DEBUG_PRINT();
+
+	if (NULL == project)
+	{
+		BitFilePutBit(ENCODED, bfpOut);
+		BitFilePutBitsNum(bfpOut, &code->offset, OFFSET_BITS, sizeof(unsigned int));
+		BitFilePutBitsNum(bfpOut, &code->length, LENGTH_BITS, sizeof(unsigned int));
+	}
+	else
+	{
+		pointer.ch = 0;
+		pointer.offset = code->offset;
+		pointer.length = code->length;
+		pointer.slide = SlidePointer(&project->slide, code);
+		CastPutItem(&project->cast, &pointer, &project->tokens);
+
+		if (project->tokens.count >= TOKEN_CHUNK)
+		{
+			PackProject(bfpOut, &project->tokens);
+		}
+	}
+
+	if(toPrintOutput == 1)
+	{
+		printf("(%d,",code->offset);
+		printf("%d),",code->length);
+	}
+	if(code->length > code->offset)
+		printf("length is %d bigger than offset %d\n",code->length,code->offset);
+}
+
+
+/****************************************************************************
+*   Function   : DecodeLZSS
+*   Description: This function decodes a LZSS encoded file.
+*				 The function replaces every pointer with the
+*				 substring the pointer points to.
+*   Parameters : fpIn - pointer to the open binary file to decode
+*                fpOut - pointer to the open binary file to write decoded
+*                       output
+*   Effects    : fpIn is decoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int DecodeLZSS(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(DecodeLZSSBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : DecodeLZSSBits
+*   Description: This function decodes a LZSS encoded bit file for
+*				 DecodeLZSS and DecodeLZSSBuf.
+*   Parameters : bfpIn - pointer to the bit file to decode
+*                bfpOut - pointer to the bit file to write decoded output
+*   Effects    : bfpIn is decoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int DecodeLZSSBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	lzss_ctx_t ctx;
+	int c;
+	unsigned int i, nextChar,toPrintOutput;
+	encoded_string_t code;              
+
+	DEBUG_PRINT();
 
-			/************************************************************************
-			* Part B - write the first item (if it is not have been alredy writed
-			************************************************************************/
+	/************************************************************************
+	* Fill the sliding window buffer with some known vales.  EncodeLZSS must
+	* use the same values.  If common characters are used, there's an
+	* increased chance of matching to the earlier strings.
+	************************************************************************/
+	memset(ctx.slidingWindow, '~', WINDOW_SIZE * sizeof(unsigned char)); // space -> metilda 
+
+	nextChar = 0;
+
+	while (1)
+	{
+		if ((c = BitFileGetBit(bfpIn)) == EOF)
+		{
+			/* we hit the EOF */
+			break;
+		}
 
-			if(Buffer[head].length == 1) // if char
+		if (c == UNCODED)
+		{
+			/* uncoded character */
+			if ((c = BitFileGetChar(bfpIn)) == EOF)
 			{
-				BitFilePutBit(UNCODED, bfpOut);
-				BitFilePutChar(Buffer[head].ch, bfpOut);
+				break;
+			}
 
-				if(toPrintOutput == 1)
-					printf("%c,",Buffer[head].ch);
+			/* write out byte and put it in sliding window */
+			BitFilePutChar(c, bfpOut);
+			ctx.slidingWindow[nextChar] = c;
+			nextChar = Wrap((nextChar + 1), WINDOW_SIZE);
+			if(toPrintOutput == 1)
+				printf("%c",c);
+		}
+		else
+		{
+			/* offset and length */
+			code.offset = 0;
+			code.length = 0;
+
+			if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS,
+				sizeof(unsigned int))) == EOF)
+			{
+				break;
 			}
 
-			else if(Buffer[head].bool_writed == 0 ) // pointer that we didnt write yet
+			if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS,
+				sizeof(unsigned int))) == EOF)
 			{
-				code.offset = Buffer[head].offset - Buffer[head].length; 
-				code.length = Buffer[head].length;
-				code.slide  = Buffer[head].slide;
-				if(code.slide == 0)
-				{
-					BitFilePutBit(ENCODED, bfpOut);
-					BitFilePutBit(PAIR, bfpOut);
-					BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-				}
-				else
-				{
-					BitFilePutBit(ENCODED, bfpOut);
-					BitFilePutBit(TRIPLE, bfpOut);
-					BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.slide, SLIDE_BITS, sizeof(unsigned int));
+				break;
+			}
+			
 
-				}
+			/* change the offset format */ 
+			if(nextChar > code.offset)
+			{
+				code.offset = nextChar - code.offset;//Wrap((nextChar - code.offset),WINDOW_SIZE);
+			}
+			else
+			{
+				code.offset = nextChar + WINDOW_SIZE - code.offset  ;
+			}
 
+			/****************************************************************
+			* Write out decoded string to file and lookahead.  It would be
+			* nice to write to the sliding window instead of the lookahead,
+			* but we could end up overwriting the matching string with the
+			* new string if abs(offset - next char) < match length.
+			****************************************************************/
+			for (i = 0; i < code.length; i++)
+			{
+				c = ctx.slidingWindow[Wrap((code.offset + i), WINDOW_SIZE)];
+				BitFilePutChar(c, bfpOut);
+				ctx.uncodedLookahead[i] = c;
 				if(toPrintOutput == 1)
-				{
-					printf("Ww:(%d,",code.offset);
-					printf("%d,",code.length);
-					printf("%d),",code.slide);             
-				}
+					printf("%c",c);
+			}
+
+			/* write out decoded string to sliding window */
+			for (i = 0; i < code.length; i++)
+			{
+				ctx.slidingWindow[Wrap((nextChar + i), WINDOW_SIZE)] =
+					ctx.uncodedLookahead[i];
 			}
 
-			head = Wrap((head + 1), WINDOW_SIZE);
-			len--;
+			nextChar = Wrap((nextChar + code.length), WINDOW_SIZE);
+		}
+	}
+
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : DecodeLZSSInto
+*   Description: This function decodes a LZSS encoded buffer straight into
+*				 a buffer of the caller, as DecodeLZSS decodes a file.
+*   Parameters : in - the encoded buffer
+*                inSize - number of bytes in the encoded buffer
+*                out - the buffer to write the text to
+*                outSize - number of bytes in out.  The bytes of out after
+*                      the text may be overwritten.
+*   Effects    : in is decoded and written to out.
+*   Returned   : The number of bytes of text, -1 for failure.  errno will be
+*                set in the event of a failure, to ENOBUFS if the text is
+*                longer than outSize.
+****************************************************************************/
+long DecodeLZSSInto(const unsigned char *in, size_t inSize,
+	unsigned char *out, size_t outSize)
+{
+	/* validate arguments */
+	if (((NULL == in) && (inSize != 0)) || ((NULL == out) && (outSize != 0)))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	return DecodeFlat(in, inSize, &out, &outSize, 0);
+}
+
+/****************************************************************************
+*   Function   : DecodeFlat
+*   Description: This function decodes a LZSS encoded buffer for
+*				 DecodeLZSSBuf and DecodeLZSSInto.  The text written so far
+*				 is the sliding window, so a string is copied from the
+*				 output to the output, and a string that lies behind its
+*				 own end is copied COPY_SIZE bytes at once if there is room
+*				 for them.  Only the strings that reach back before the
+*				 start of the text, into the '~' the window starts filled
+*				 with, are copied a character at a time.
+*   Parameters : in - the encoded buffer
+*                inSize - number of bytes in the encoded buffer
+*                out - pointer to the output buffer
+*                room - pointer to the number of bytes in *out
+*                grow - whether *out may be grown with realloc(), which
+*                       updates *out and *room
+*   Effects    : in is decoded and written to *out.
+*   Returned   : The number of bytes of text, -1 for failure.  errno will be
+*                set in the event of a failure, to ENOBUFS if *out is too
+*                small and may not grow.
+****************************************************************************/
+static long DecodeFlat(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *room, int grow)
+{
+	bit_reader_t reader;
+	unsigned char chunk[COPY_SIZE];
+	unsigned char *text, *bigger;
+	size_t length, distance, i;
+	unsigned int offset, count;
+	long long from;
+
+	reader.in = in;
+	reader.inSize = inSize;
+	reader.pos = 0;
+	reader.bits = 0;
+	reader.count = 0;
+
+	text = *out;
+	length = 0;
+
+	while (1)
+	{
+		/* every item fits in the bits of one fill */
+		if (reader.count < 1 + OFFSET_BITS + LENGTH_BITS)
+		{
+			FillBits(&reader);
+		}
 
+		if (reader.count < 1)
+		{
+			/* we hit the end of the input */
+			break;
+		}
 
+		if (grow && (length + MAX_CODED + COPY_SIZE > *room))
+		{
+			bigger = (unsigned char *)realloc(text, 2 * *room);
 
-			/************************************************************************
-			* Part C - replace item, insert the next item    
-			************************************************************************/
-			c = BitFileGetBit(bfpIn);
-			if( c == UNCODED)
+			if (NULL == bigger)
 			{
-				if ((c = BitFileGetChar(bfpIn)) == EOF)
-				{
-					break;
-				}
-				Buffer[tail].ch = c;
-				Buffer[tail].bool_writed = 0;
-				Buffer[tail].offset = 0;
-				Buffer[tail].length = 1;
-				Buffer[tail].slide  = 0;
+				*out = text;
+				errno = ENOMEM;
+				return -1;
 			}
-			else
+
+			text = bigger;
+			*room *= 2;
+			*out = text;
+		}
+
+		if (TakeBits(&reader, 1) == UNCODED)
+		{
+			if (reader.count < 8)
 			{
+				break;
+			}
 
-				code.offset = 0;
-				code.length = 0;
-				code.slide = 0;
-				if ((c = BitFileGetBit(bfpIn)) == EOF)
-				{
-					break;
-				}
-				if (c == PAIR)
-				{
-					if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-					{
-						break;
-					}
+			if (length == *room)
+			{
+				errno = ENOBUFS;
+				return -1;
+			}
 
-					if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-					{
-						break;
-					}
+			text[length++] = (unsigned char)TakeBits(&reader, 8);
+			continue;
+		}
 
-				}
-				else
-				{
-					if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-					{
-						break;
-					}
+		if (reader.count < OFFSET_BITS + LENGTH_BITS)
+		{
+			break;
+		}
 
-					if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-					{
-						break;
-					}
-					if ((BitFileGetBitsNum(bfpIn, &code.slide, SLIDE_BITS, sizeof(unsigned int))) == EOF)
-					{
-						break;
-					}
+		/* the offset counts back from the next character, WINDOW_SIZE is 0 */
+		offset = TakeNumber(&reader, OFFSET_BITS);
+		count = TakeNumber(&reader, LENGTH_BITS);
+		distance = (0 == offset) ? WINDOW_SIZE : offset;
+
+		if (length + count > *room)
+		{
+			errno = ENOBUFS;
+			return -1;
+		}
+
+		if ((distance <= length) && (distance >= count) &&
+			(length + COPY_SIZE <= *room))
+		{
+			/* read all of the chunk before writing it, the two may overlap */
+			memcpy(chunk, text + length - distance, COPY_SIZE);
+			memcpy(text + length, chunk, COPY_SIZE);
+		}
+		else if ((distance <= length) && (distance >= count))
+		{
+			memcpy(text + length, text + length - distance, count);
+		}
+		else
+		{
+			/****************************************************************
+			* The string starts in the '~' before the text, or reaches past
+			* the end of the window into the characters being written,
+			* where DecodeLZSS still has the ones a window before.
+			****************************************************************/
+			for (i = 0; i < count; i++)
+			{
+				from = (long long)length - (long long)distance + (long long)i;
+
+				if (from >= (long long)length)
+				{
+					from -= WINDOW_SIZE;
+				}
+
+				text[length + i] = (from < 0) ? '~' : text[from];
+			}
+		}
+
+		length += count;
+	}
+
+	return (long)length;
+}
+
+/****************************************************************************
+*   Function   : FillBits
+*   Description: This function reads whole bytes of the input into the bits
+*				 of a reader until it holds more than 56 bits or the input
+*				 ends.
+*   Parameters : reader - the reader
+*   Effects    : Bytes of the input are moved into reader->bits.
+*   Returned   : None
+****************************************************************************/
+static void FillBits(bit_reader_t *reader)
+{
+	while ((reader->count <= 56) && (reader->pos < reader->inSize))
+	{
+		reader->bits = (reader->bits << 8) | reader->in[reader->pos++];
+		reader->count += 8;
+	}
+}
+
+/****************************************************************************
+*   Function   : TakeBits
+*   Description: This function takes the next bits of a reader, which has
+*				 to hold them, as BitFileGetBitsInt reads them.
+*   Parameters : reader - the reader
+*                count - number of bits, at most 32
+*   Effects    : The bits are removed from reader.
+*   Returned   : The bits, the first one highest.
+****************************************************************************/
+static unsigned int TakeBits(bit_reader_t *reader, unsigned int count)
+{
+	reader->count -= count;
+
+	return (unsigned int)((reader->bits >> reader->count) &
+		((1ULL << count) - 1));
+}
+
+/****************************************************************************
+*   Function   : TakeNumber
+*   Description: This function takes a number of a reader, which has to
+*				 hold it, as BitFileGetBitsNum reads it: the whole bytes
+*				 from the lowest up, then the remaining high bits.
+*   Parameters : reader - the reader
+*                count - number of bits of the number, at most 32
+*   Effects    : The bits are removed from reader.
+*   Returned   : The number.
+****************************************************************************/
+static unsigned int TakeNumber(bit_reader_t *reader, unsigned int count)
+{
+	unsigned int value, shift;
+
+	value = 0;
+
+	for (shift = 0; count >= 8; shift += 8, count -= 8)
+	{
+		value |= TakeBits(reader, 8) << shift;
+	}
+
+	if (count > 0)
+	{
+		value |= TakeBits(reader, count) << shift;
+	}
+
+	return value;
+}
+
+/****************************************************************************
+*   Function   : diff
+*   Description: The function gets two files, and checks whether the files are the same.
+*   Parameters : fpIn1 - pointer to first file
+*                fpIn2 - pointer to second file
+*   Effects    : print to screen the result
+*   Returned   : void
+****************************************************************************/
+void diff(FILE *fpIn1, FILE *fpIn2){
+	unsigned int C1 , C2;
+	unsigned int flag=0;
+
+	while((C1 = getc(fpIn1)) != EOF){
+		C2 = getc(fpIn2);
+		if(C1 != C2){
+			flag = 1;
+			break;
+		}
+	}
+	C2 = getc(fpIn2);
+	if(C1 != C2){
+		flag = 1;
+	}
+	if(flag == 0){
+		printf("The files are the same\n");
+	}
+	else{
+		printf("The files are not the same !!\n");
+	}
+
+}
+
+/****************************************************************************
+*   Function   : AddSlide
+*   Description: This function gets a LZSS compressed file and adapts it to include a slide parameter in every pointer. 
+*   Parameters : fpIn - pointer to the LZSS encoded file
+*                fpOut - pointer to the open binary file to write encoded
+*                       output with slide
+*   Effects    : fpIn get slide parameter for every poiner and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int AddSlide(FILE *fpIn, FILE *fpOut)// remove pointer with length = 0
+{
+	return RunFileStage(AddSlideBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : AddSlideBits
+*   Description: This function adds the slide parameter to every pointer of
+*				 a LZSS encoded bit file for AddSlide and AddSlideBuf.
+*   Parameters : bfpIn - pointer to the LZSS encoded bit file
+*                bfpOut - pointer to the bit file to write encoded output
+*				 with slide
+*   Effects    : bfpIn is read and written to bfpOut with the slides.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int AddSlideBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	slide_t slide;
+	token_buffer_t lzss, project;
+	int end, result;
+
+	if (TokensInit(&lzss) != 0)
+	{
+		return -1;
+	}
+
+	if (TokensInit(&project) != 0)
+	{
+		TokensFree(&lzss);
+		return -1;
+	}
+
+	SlideInit(&slide);
+
+	/************************************************************************
+	* pass over the whole file and insert slide, a chunk at a time
+	************************************************************************/
+	do
+	{
+		end = UnpackLZSS(bfpIn, &lzss);
+		SlideTokens(&slide, &lzss, &project);
+		PackProject(bfpOut, &project);
+	} while ((end != EOF) && !project.failed);
+
+	result = 0;
+
+	if (project.failed)
+	{
+		errno = ENOMEM;
+		result = -1;
+	}
+
+	TokensFree(&lzss);
+	TokensFree(&project);
+	return result;
+}
+
+/****************************************************************************
+*   Function   : DropSlideBits
+*   Description: This function takes the slides off the pointers of a bit
+*				 file written by AddSlide, which keeps the offset and length
+*				 of every pointer, and writes them as EncodeLZSS did.
+*   Parameters : bfpIn - pointer to the bit file with slides
+*                bfpOut - pointer to the bit file to write LZSS output
+*   Effects    : bfpIn is read and written to bfpOut without the slides.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int DropSlideBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	token_buffer_t tokens;
+	int end;
+
+	if (TokensInit(&tokens) != 0)
+	{
+		return -1;
+	}
+
+	do
+	{
+		end = UnpackProject(bfpIn, &tokens);
+		PackLZSS(bfpOut, &tokens);
+	} while (end != EOF);
+
+	TokensFree(&tokens);
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : DecodeSlideBuf
+*   Description: This function decodes the inSize bytes at in, written by
+*				 AddSlide, into a buffer it allocates.  The slides are
+*				 dropped and the LZSS items decoded, so the cast stages,
+*				 which lose slides that do not fit in SLIDE_BITS, are not
+*				 run.
+*   Parameters : in, inSize, out, outSize - as for DecodeLZSSBuf
+*   Effects    : *out is allocated with the decoded text.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int DecodeSlideBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	unsigned char *lzss;
+	size_t lzssSize;
+	int result;
+
+	if (RunBufferStage(DropSlideBits, in, inSize, &lzss, &lzssSize) != 0)
+	{
+		return -1;
+	}
+
+	result = DecodeLZSSBuf(lzss, lzssSize, out, outSize);
+	free(lzss);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : SlideInit
+*   Description: This function initializes the slide stage: none of the
+*				 characters before the text is encoded.
+*   Parameters : slide - the slide stage
+*   Effects    : slide is ready for the first item of the text.
+*   Returned   : None
+****************************************************************************/
+static void SlideInit(slide_t *slide)
+{
+	unsigned int i;
+
+	for(i = 0; i < BUFFER_SIZE; i++)
+	{
+		slide->Buffer[i].ch = 0;
+		slide->Buffer[i].Encoded = -1;
+	}
+	slide->BufferIndex = 0;
+}
+
+/****************************************************************************
+*   Function   : SlideChar
+*   Description: This function records an uncoded character of the text.
+*   Parameters : slide - the slide stage
+*   Effects    : The character is marked UNCODED.
+*   Returned   : None
+****************************************************************************/
+static void SlideChar(slide_t *slide)
+{
+	slide->Buffer[slide->BufferIndex].Encoded = UNCODED;
+	slide->BufferIndex = Wrap ((slide->BufferIndex + 1) , BUFFER_SIZE);
+}
+
+/****************************************************************************
+*   Function   : SlidePointer
+*   Description: This function finds the slide of a pointer: the number of
+*				 ENCODED characters walking back from the last character of
+*				 the string the pointer copies (at most SLIDE_SIZE - 1).
+*   Parameters : slide - the slide stage
+*                code - the pointer in LZSS format (offset back from the
+*				 pointer, length)
+*   Effects    : The characters of the pointer are marked ENCODED.
+*   Returned   : The slide of the pointer.
+****************************************************************************/
+static unsigned int SlidePointer(slide_t *slide, const encoded_string_t *code)
+{
+	unsigned int j,result,tempIndex;
+	int temp;
+
+	result = 0;
+	temp = slide->BufferIndex - code->offset + code->length - 1;
+	tempIndex = Wrap ((temp) , BUFFER_SIZE); // give the index of the last char.
+	while(slide->Buffer[tempIndex].Encoded == ENCODED && result < (SLIDE_SIZE - 1))
+	{
+		result++;
+		temp --;
+		tempIndex = Wrap ((temp) , BUFFER_SIZE); // give the index of the first char.
+	}
+	//update Buffer
+	for(j = 0; j < code->length; j++)
+	{
+		slide->Buffer[slide->BufferIndex].Encoded = ENCODED;
+		slide->BufferIndex = Wrap ((slide->BufferIndex + 1) , BUFFER_SIZE);
+	}
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : SlideTokens
+*   Description: This function adds the slide of every pointer of a chunk
+*				 of LZSS tokens, and drops the pointers of length 0.
+*   Parameters : slide - the slide stage
+*                in - the LZSS tokens
+*                out - the tokens to append the tokens with slides to
+*   Effects    : The tokens of in are moved to out.
+*   Returned   : None
+****************************************************************************/
+static void SlideTokens(slide_t *slide, token_buffer_t *in,
+	token_buffer_t *out)
+{
+	unsigned int toPrintOutput;
+	encoded_string_t code;
+	size_t i;
+
+	DEBUG_PRINT();
+
+	for (i = 0; i < in->count; i++)
+	{
+		if (in->kind[i] == UNCODED)
+		{
+			SlideChar(slide);
+			PutToken(out, UNCODED, in->offset[i], 1, 0);
+
+			if(toPrintOutput == 1)
+				printf("%c,",in->offset[i]);
+		}
+		else if (in->length[i] > 0)
+		{
+			code.offset = in->offset[i];
+			code.length = in->length[i];
+			code.slide = SlidePointer(slide, &code);
+			PutToken(out, ENCODED, code.offset, code.length, code.slide);
+
+			if(toPrintOutput == 1)
+			{
+				printf("(%d,",code.offset);
+				printf("%d,",code.length);
+				printf("%d),",code.slide);
+			}
+		}
+	}
+
+	in->count = 0;
+}
+
+/****************************************************************************
+*   Function   : CastEncodeLZSS
+*   Description: This function gets a LZSS compressed file with a SLIDE parameter in all pointers, and adjusts it according to project format v2. 
+*   Parameters : fpIn - pointer to the LZSS encoded file with SLIDE parameter
+*                fpOut - pointer to the open binary file to write encoded
+*                       output according to project format. 
+*   Effects    : fpIn moves every pointer to the right place according to the OFFSET and SLIDE parameters and written to fpOut.
+*                Neither file is closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int CastEncodeLZSS(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(CastEncodeBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : CastEncodeBits
+*   Description: This function moves the pointers of a LZSS encoded bit file
+*				 with a SLIDE parameter to their place in project format v2,
+*				 for CastEncodeLZSS and CastEncodeLZSSBuf.
+*   Parameters : bfpIn - pointer to the LZSS encoded bit file with SLIDE
+*				 parameter
+*                bfpOut - pointer to the bit file to write encoded output
+*				 according to project format
+*   Effects    : bfpIn is cast and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int CastEncodeBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	cast_t cast;
+	token_buffer_t slide, project;
+	int end, result;
+
+	if (TokensInit(&slide) != 0)
+	{
+		return -1;
+	}
+
+	if (TokensInit(&project) != 0)
+	{
+		TokensFree(&slide);
+		return -1;
+	}
+
+	CastInit(&cast);
+
+	do
+	{
+		end = UnpackProject(bfpIn, &slide);
+		CastTokens(&cast, &slide, &project);
+		PackProject(bfpOut, &project);
+	} while ((end != EOF) && !project.failed);
+
+	/* handle the itemes that remains in the buffer */
+	CastFinish(&cast, &project);
+	PackProject(bfpOut, &project);
+
+	result = 0;
+
+	if (project.failed)
+	{
+		errno = ENOMEM;
+		result = -1;
+	}
+
+	TokensFree(&slide);
+	TokensFree(&project);
+	return result;
+}
+
+/****************************************************************************
+*   Function   : CastInit
+*   Description: This function initializes the cast stage with an empty
+*				 buffer.
+*   Parameters : cast - the cast stage
+*   Effects    : cast is ready for the first item of the text.
+*   Returned   : None
+****************************************************************************/
+static void CastInit(cast_t *cast)
+{
+	unsigned int i,toPrintOutput;
+
+	DEBUG_PRINT();
+	cast->toPrintOutput = toPrintOutput;
+
+	for(i = 0; i < WINDOW_SIZE; i++)
+	{
+		cast->Buffer[i].ch = 0;
+		cast->Buffer[i].length = 0;
+		cast->Buffer[i].offset = 0;
+		cast->Buffer[i].slide = 0;
+		cast->Buffer[i].bool_writed = 1;
+		cast->textPos[i] = -1;
+		cast->pendingFirst[i] = WINDOW_SIZE;
+	}
+
+	for(i = 0; i < BUFFER_SIZE; i++)
+	{
+		cast->textItem[i] = WINDOW_SIZE;
+	}
+
+	cast->head = 0;
+	cast->tail = 0;
+	cast->len = 0;
+	cast->headPos = 0;
+	cast->tailPos = 0;
+}
+
+/****************************************************************************
+*   Function   : CastPutItem
+*   Description: This function adds the next item of the text (a character
+*				 or a pointer with its slide) to the cast stage.  A pointer
+*				 (offset, length, slide) is moved back to the item that
+*				 starts offset - length + slide characters before it: that
+*				 item is looked up by its text position and the pointer is
+*				 queued on it.  Once the buffer holds WINDOW_SIZE items the
+*				 first one is written.
+*   Parameters : cast - the cast stage
+*                item - the item to add
+*                out - the tokens to append the written items to
+*   Effects    : The item is added to the buffer, and the first item of the
+*				 buffer may be written to out.
+*   Returned   : None
+****************************************************************************/
+static void CastPutItem(cast_t *cast, const encoded *item,
+	token_buffer_t *out)
+{
+	unsigned int tail,index;
+	long long target;
+
+	tail = cast->tail;
+	cast->Buffer[tail] = *item;
+	cast->Buffer[tail].bool_writed = 0;
+	cast->textPos[tail] = cast->tailPos;
+	cast->textItem[cast->tailPos % BUFFER_SIZE] = tail;
+
+	if(item->length > 1)
+	{
+		/* offset + slide < BUFFER_SIZE, so textItem still holds the target */
+		target = cast->tailPos - ((long long)item->offset - item->length +
+			item->slide);
+		index = (target < 0) ? WINDOW_SIZE :
+			cast->textItem[target % BUFFER_SIZE];
+
+		if(target >= cast->headPos && target <= cast->tailPos &&
+			index != WINDOW_SIZE && cast->textPos[index] == target)
+		{
+			cast->pendingNext[tail] = WINDOW_SIZE;
+			if(cast->pendingFirst[index] == WINDOW_SIZE)
+			{
+				cast->pendingFirst[index] = tail;
+			}
+			else
+			{
+				cast->pendingNext[cast->pendingLast[index]] = tail;
+			}
+			cast->pendingLast[index] = tail;
+		}
+	}
+
+	cast->tailPos += item->length;
+	cast->tail = Wrap((tail + 1), WINDOW_SIZE);
+	cast->len++;
+
+	if(cast->len == WINDOW_SIZE)// buffer full
+	{
+		CastWriteHead(cast, out);
+	}
+}
+
+/****************************************************************************
+*   Function   : CastWriteHead
+*   Description: This function writes the first item of the cast buffer,
+*				 after the pointers that were queued on it.
+*   Parameters : cast - the cast stage
+*                out - the tokens to append the written items to
+*   Effects    : The first item is written to out and removed from the
+*				 buffer.
+*   Returned   : None
+****************************************************************************/
+static void CastWriteHead(cast_t *cast, token_buffer_t *out)
+{
+	encoded_string_t code;
+	unsigned int head,index;
+
+	head = cast->head;
+
+	/************************************************************************
+	* Part A - write the pointers that point to the head item
+	************************************************************************/
+	for(index = cast->pendingFirst[head]; index != WINDOW_SIZE; index = cast->pendingNext[index])
+	{
+		code.offset = cast->Buffer[index].offset - cast->Buffer[index].length; 
+		code.length = cast->Buffer[index].length;
+		code.slide  = cast->Buffer[index].slide;
+		PutToken(out, ENCODED, code.offset, code.length, code.slide);
+
+		if(cast->toPrintOutput == 1)
+		{
+			printf("(%d,",code.offset);
+			printf("%d,",code.length);
+			printf("%d),",code.slide);             
+		}
+		cast->Buffer[index].bool_writed = 1;
+	}
+	cast->pendingFirst[head] = WINDOW_SIZE;
+
+	/************************************************************************
+	* Part B - write the first item (if it is not have been alredy writed
+	************************************************************************/
+
+	if(cast->Buffer[head].length == 1) // if char
+	{
+		PutToken(out, UNCODED, cast->Buffer[head].ch, 1, 0);
+
+		if(cast->toPrintOutput == 1)
+			printf("%c,",cast->Buffer[head].ch);
+	}
+
+	else if(cast->Buffer[head].bool_writed == 0 ) // pointer that we didnt write yet
+	{
+		code.offset = cast->Buffer[head].offset - cast->Buffer[head].length; 
+		code.length = cast->Buffer[head].length;
+		code.slide  = cast->Buffer[head].slide;
+		PutToken(out, ENCODED, code.offset, code.length, code.slide);
+
+		if(cast->toPrintOutput == 1)
+		{
+			printf("Ww:(%d,",code.offset);
+			printf("%d,",code.length);
+			printf("%d),",code.slide);             
+		}
+	}
+
+	cast->Buffer[head].bool_writed = 1;
+	cast->headPos += cast->Buffer[head].length;
+	cast->head = Wrap((head + 1), WINDOW_SIZE);
+	cast->len--;
+}
+
+/****************************************************************************
+*   Function   : CastFinish
+*   Description: This function writes the items that remain in the cast
+*				 buffer at the end of the text.
+*   Parameters : cast - the cast stage
+*                out - the tokens to append the written items to
+*   Effects    : The buffer is emptied to out.
+*   Returned   : None
+****************************************************************************/
+static void CastFinish(cast_t *cast, token_buffer_t *out)
+{
+	while(cast->len > 0)
+	{
+		CastWriteHead(cast, out);
+	}
+}
+
+/****************************************************************************
+*   Function   : CastTokens
+*   Description: This function adds a chunk of tokens with slides to the
+*				 cast stage.  A pointer of length 1 is written as the
+*				 character 0, as CastWriteHead writes every item of length
+*				 1.
+*   Parameters : cast - the cast stage
+*                in - the tokens with slides
+*                out - the tokens to append the written items to
+*   Effects    : The tokens of in are added to the cast buffer, and the
+*                items that leave it are written to out.
+*   Returned   : None
+****************************************************************************/
+static void CastTokens(cast_t *cast, token_buffer_t *in, token_buffer_t *out)
+{
+	encoded item;
+	size_t i;
+
+	item.bool_writed = 0;
+
+	for (i = 0; i < in->count; i++)
+	{
+		if (in->kind[i] == UNCODED)
+		{
+			item.ch = in->offset[i];
+			item.offset = 0;
+			item.length = 1;
+			item.slide = 0;
+		}
+		else
+		{
+			item.ch = 0;
+			item.offset = in->offset[i];
+			item.length = in->length[i];
+			item.slide = in->slide[i];
+		}
+
+		CastPutItem(cast, &item, out);
+	}
+
+	in->count = 0;
+}
+
+/****************************************************************************
+*   Function   : CastBack
+*   Description: This function gets the encoded file according to the format V2 of the project, and transforms it to the traditional LZSS encoded file 
+*   Parameters : fpIn - pointer to the project encoded file
+*                fpOut - pointer to the open binary file to write encoded output according to LZSS format. 
+*   Effects    : fpIn moves every pointer to the right place according to the OFFSET and SLIDE parameters and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int CastBack(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(CastBackBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : CastBackBits
+*   Description: This function transforms a bit file encoded according to
+*				 format V2 of the project back to traditional LZSS, for
+*				 CastBack and CastBackBuf.
+*   Parameters : bfpIn - pointer to the project encoded bit file
+*                bfpOut - pointer to the bit file to write encoded output
+*				 according to LZSS format
+*   Effects    : bfpIn is cast back and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int CastBackBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	cast_back_t back;
+	token_buffer_t project, lzss;
+	int end, result;
+
+	if (TokensInit(&project) != 0)
+	{
+		return -1;
+	}
+
+	if (TokensInit(&lzss) != 0)
+	{
+		TokensFree(&project);
+		return -1;
+	}
+
+	CastBackInit(&back);
+
+	do
+	{
+		end = UnpackProject(bfpIn, &project);
+		CastBackTokens(&back, &project, &lzss);
+		PackLZSS(bfpOut, &lzss);
+	} while ((end != EOF) && !lzss.failed);
+
+	/* handle the itemes that remains in the buffer */
+	CastBackFinish(&back, &lzss);
+	PackLZSS(bfpOut, &lzss);
+
+	result = 0;
+
+	if (lzss.failed)
+	{
+		errno = ENOMEM;
+		result = -1;
+	}
+
+	TokensFree(&project);
+	TokensFree(&lzss);
+	return result;
+}
+
+/****************************************************************************
+*   Function   : CastBackInit
+*   Description: This function initializes the cast back stage with no
+*				 pointers queued.
+*   Parameters : back - the cast back stage
+*   Effects    : back is ready for the first item of the text.
+*   Returned   : None
+****************************************************************************/
+static void CastBackInit(cast_back_t *back)
+{
+	unsigned int i,toPrintOutput;
+
+	//toPrintOutput = 1;// debug
+	DEBUG_PRINT();
+	back->toPrintOutput = toPrintOutput;
+
+	for(i = 0; i < BUFFER_SIZE; i++)
+	{
+		back->Buffer[i].ch = 0;
+		back->Buffer[i].length = 0;
+		back->Buffer[i].offset = 0;
+		back->Buffer[i].slide = 0;
+		back->Buffer[i].bool_writed = 1;
+	}
+
+	back->head = 0;
+}
+
+/****************************************************************************
+*   Function   : CastBackTokens
+*   Description: This function casts a chunk of project tokens back to
+*				 LZSS.  A pointer is queued at the text position it is
+*				 written at, offset + slide characters after the
+*				 current one, and written before the next character
+*				 reaches that position.
+*   Parameters : back - the cast back stage
+*                in - the project tokens
+*                out - the tokens to append the LZSS tokens to
+*   Effects    : The tokens of in are cast back to out, or queued.
+*   Returned   : None
+****************************************************************************/
+static void CastBackTokens(cast_back_t *back, token_buffer_t *in,
+	token_buffer_t *out)
+{
+	unsigned int head,index;
+	size_t i;
+
+	head = back->head;
+
+	for (i = 0; i < in->count; i++)
+	{
+		if (in->kind[i] == UNCODED)
+		{
+			while(back->Buffer[head].bool_writed ==  0 ) // write pointers that should appear
+			{
+				PutToken(out, ENCODED, back->Buffer[head].offset,
+					back->Buffer[head].length, 0);
+
+				if(back->toPrintOutput == 1)
+				{
+					printf("(%d,",back->Buffer[head].offset);
+					printf("%d),",back->Buffer[head].length);
 				}
 
-				Buffer[tail].offset = code.offset;
-				Buffer[tail].length = code.length;
-				Buffer[tail].slide  = code.slide;
-				Buffer[tail].bool_writed = 0;
-				Buffer[tail].ch = 0;
-			}
-			len++;
-			tail = Wrap((tail + 1), WINDOW_SIZE);
-		}
-	}
+				back->Buffer[head].bool_writed = 1;// sign the pointer
+				head = Wrap((head + back->Buffer[head].length ), BUFFER_SIZE);
+			}
+			//write the new characters
+			PutToken(out, UNCODED, in->offset[i], 1, 0);
+
+			if(back->toPrintOutput == 1)
+				printf("%c,",in->offset[i]);
+
+			head = Wrap((head + 1), BUFFER_SIZE);
+		}
+		else // c==CODED
+		{
+			//insert the pointer to the right place at buffer
+			index = head + in->offset[i] + in->slide[i];// -1
+			index = Wrap((index), BUFFER_SIZE);
+			back->Buffer[index].offset = in->offset[i] + in->length[i];// no need Wrap, i think
+			back->Buffer[index].length = in->length[i];
+			back->Buffer[index].bool_writed = 0;
+		}
+	}
+
+	back->head = head;
+	in->count = 0;
+}
+
+/****************************************************************************
+*   Function   : CastBackFinish
+*   Description: This function writes the pointers that are still queued at
+*				 the end of the text.
+*   Parameters : back - the cast back stage
+*                out - the tokens to append the pointers to
+*   Effects    : The queued pointers are written to out.
+*   Returned   : None
+****************************************************************************/
+static void CastBackFinish(cast_back_t *back, token_buffer_t *out)
+{
+	unsigned int i,head;
+
+	head = back->head;
+
+	for(i = 0; i < BUFFER_SIZE; i++)
+	{
+		if(back->Buffer[head].bool_writed == 0 )
+		{
+			PutToken(out, ENCODED, back->Buffer[head].offset,
+				back->Buffer[head].length, 0);
+
+			if(back->toPrintOutput == 1)
+			{
+				printf("(%d,",back->Buffer[head].offset);
+				printf("%d),",back->Buffer[head].length);
+			}
+
+			back->Buffer[head].bool_writed = 1;// sign the pointer
+		}
+
+		head = Wrap((head + 1), BUFFER_SIZE);
+	}
+
+	back->head = head;
+}
+
+/****************************************************************************
+*   Function   : AddSlideCast
+*   Description: This function does AddSlide and CastEncodeLZSS in one
+*				 pass: the tokens with slides go to the cast stage as they
+*				 are, without the file between the two stages.
+*   Parameters : fpIn - pointer to the LZSS encoded file
+*                fpOut - pointer to the open binary file to write encoded
+*                       output according to project format
+*   Effects    : fpIn is written to fpOut as AddSlide and CastEncodeLZSS
+*                would.  Neither file is closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int AddSlideCast(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(AddSlideCastBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : AddSlideCastBits
+*   Description: This function runs the tokens of a LZSS encoded bit file
+*				 through the slide and cast stages, for AddSlideCast and
+*				 AddSlideCastBuf.
+*   Parameters : bfpIn - pointer to the LZSS encoded bit file
+*                bfpOut - pointer to the bit file to write encoded output
+*				 according to project format
+*   Effects    : bfpIn is read and written to bfpOut in project format.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int AddSlideCastBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	slide_t slide;
+	cast_t cast;
+	token_buffer_t lzss, slid, project;
+	int end, result;
+
+	if (TokensInit(&lzss) != 0)
+	{
+		return -1;
+	}
+
+	if (TokensInit(&slid) != 0)
+	{
+		TokensFree(&lzss);
+		return -1;
+	}
+
+	if (TokensInit(&project) != 0)
+	{
+		TokensFree(&lzss);
+		TokensFree(&slid);
+		return -1;
+	}
+
+	SlideInit(&slide);
+	CastInit(&cast);
+
+	do
+	{
+		end = UnpackLZSS(bfpIn, &lzss);
+		SlideTokens(&slide, &lzss, &slid);
+		CastTokens(&cast, &slid, &project);
+		PackProject(bfpOut, &project);
+	} while ((end != EOF) && !slid.failed && !project.failed);
+
+	/* handle the itemes that remains in the buffer */
+	CastFinish(&cast, &project);
+	PackProject(bfpOut, &project);
+
+	result = 0;
+
+	if (slid.failed || project.failed)
+	{
+		errno = ENOMEM;
+		result = -1;
+	}
+
+	TokensFree(&lzss);
+	TokensFree(&slid);
+	TokensFree(&project);
+	return result;
+}
+
+/****************************************************************************
+*   Function   : TokensInit
+*   Description: This function allocates a token buffer with room for
+*				 TOKEN_CHUNK tokens.
+*   Parameters : tokens - the token buffer
+*   Effects    : tokens is empty.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int TokensInit(token_buffer_t *tokens)
+{
+	tokens->kind = (unsigned char *)malloc(TOKEN_CHUNK);
+	tokens->offset = (unsigned short *)malloc(TOKEN_CHUNK *
+		sizeof(unsigned short));
+	tokens->length = (unsigned char *)malloc(TOKEN_CHUNK);
+	tokens->slide = (unsigned short *)malloc(TOKEN_CHUNK *
+		sizeof(unsigned short));
+	tokens->count = 0;
+	tokens->size = TOKEN_CHUNK;
+	tokens->failed = 0;
+
+	if ((NULL == tokens->kind) || (NULL == tokens->offset) ||
+		(NULL == tokens->length) || (NULL == tokens->slide))
+	{
+		TokensFree(tokens);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : TokensFree
+*   Description: This function frees the arrays of a token buffer.
+*   Parameters : tokens - the token buffer
+*   Effects    : The arrays of tokens are freed.
+*   Returned   : None
+****************************************************************************/
+void TokensFree(token_buffer_t *tokens)
+{
+	free(tokens->kind);
+	free(tokens->offset);
+	free(tokens->length);
+	free(tokens->slide);
+	tokens->kind = NULL;
+	tokens->offset = NULL;
+	tokens->length = NULL;
+	tokens->slide = NULL;
+	tokens->count = 0;
+	tokens->size = 0;
+}
+
+/****************************************************************************
+*   Function   : PutToken
+*   Description: This function appends a token to a token buffer, doubling
+*				 the buffer if it is full.
+*   Parameters : tokens - the token buffer
+*                kind - UNCODED or ENCODED
+*                offset - the offset of a pointer, or the character
+*                length - the length of a pointer, 1 for a character
+*                slide - the slide of a pointer
+*   Effects    : The token is added to tokens.  If there is no memory for
+*                it, it is lost and failed is set.
+*   Returned   : None
+****************************************************************************/
+static void PutToken(token_buffer_t *tokens, int kind, unsigned int offset,
+	unsigned int length, unsigned int slide)
+{
+	unsigned char *kinds, *lengths;
+	unsigned short *offsets, *slides;
+	size_t size;
+
+	if (tokens->count == tokens->size)
+	{
+		size = 2 * tokens->size;
+
+		/* keep the arrays that grew, each holds at least the old size */
+		kinds = (unsigned char *)realloc(tokens->kind, size);
+		if (kinds != NULL)
+		{
+			tokens->kind = kinds;
+		}
+
+		offsets = (unsigned short *)realloc(tokens->offset,
+			size * sizeof(unsigned short));
+		if (offsets != NULL)
+		{
+			tokens->offset = offsets;
+		}
+
+		lengths = (unsigned char *)realloc(tokens->length, size);
+		if (lengths != NULL)
+		{
+			tokens->length = lengths;
+		}
+
+		slides = (unsigned short *)realloc(tokens->slide,
+			size * sizeof(unsigned short));
+		if (slides != NULL)
+		{
+			tokens->slide = slides;
+		}
+
+		if ((NULL == kinds) || (NULL == offsets) || (NULL == lengths) ||
+			(NULL == slides))
+		{
+			tokens->failed = 1;
+			return;
+		}
+
+		tokens->size = size;
+	}
+
+	tokens->kind[tokens->count] = (unsigned char)kind;
+	tokens->offset[tokens->count] = (unsigned short)offset;
+	tokens->length[tokens->count] = (unsigned char)length;
+	tokens->slide[tokens->count] = (unsigned short)slide;
+	tokens->count++;
+}
+
+/****************************************************************************
+*   Function   : UnpackLZSS
+*   Description: This function reads the items of a LZSS encoded bit file
+*				 to a token buffer, until it holds TOKEN_CHUNK tokens.
+*				 Every item is taken with shifts of the bits the bit file
+*				 holds, as many items at a time as they have.
+*   Parameters : bfpIn - pointer to the LZSS encoded bit file
+*                tokens - the token buffer to append the items to
+*   Effects    : Items are read from bfpIn and appended to tokens.
+*   Returned   : 0 if there may be more items, EOF at the end of the file
+*                or of the last whole item.
+****************************************************************************/
+static int UnpackLZSS(bit_file_t *bfpIn, token_buffer_t *tokens)
+{
+	unsigned long long bits, word;
+	unsigned int count, used, size;
+	size_t n;
+
+	n = tokens->count;
 
-	/************************************************************************
-	* handle the itemes that remains in the buffer
-	************************************************************************/
-	while(len > 0)
+	while (n < TOKEN_CHUNK)
 	{
-		/************************************************************************
-		* Part A - check if exist pointer to BufferIndex  
-		************************************************************************/
-		//A.1 check if exist pointer to BufferIndex
+		count = BitFilePeekBits(bfpIn, &bits);
+		used = 0;
 
-		temp_index = head; 
-		distance = 0;
-		
-		for(j = 0; j < len; j++)
+		/* count is over LZSS_ITEM_BITS unless the file ends */
+		while ((n < TOKEN_CHUNK) && (used < count))
 		{
-			if(Buffer[temp_index].bool_writed == 0 && 
-				Buffer[temp_index].length > 1 &&
-				distance == (Buffer[temp_index].offset - Buffer[temp_index].length + Buffer[temp_index].slide) ) 
+			word = bits << used;
+
+			if ((word >> 63) == UNCODED)
 			{
-				// and insert the new pointer
-				code.offset = Buffer[temp_index].offset - Buffer[temp_index].length; 
-				code.length = Buffer[temp_index].length;
-				code.slide  = Buffer[temp_index].slide;
-				if(code.slide == 0)
-				{
-					BitFilePutBit(ENCODED, bfpOut);
-					BitFilePutBit(PAIR, bfpOut);
-					BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-				}
-				else
-				{
-					BitFilePutBit(ENCODED, bfpOut);
-					BitFilePutBit(TRIPLE, bfpOut);
-					BitFilePutBitsNum(bfpOut, &code.offset, OFFSET_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.length, LENGTH_BITS, sizeof(unsigned int));
-					BitFilePutBitsNum(bfpOut, &code.slide, SLIDE_BITS, sizeof(unsigned int));
+				size = 1 + 8;
+			}
+			else
+			{
+				size = LZSS_ITEM_BITS;
+			}
 
-				}
+			if (size > count - used)
+			{
+				break;
+			}
 
-				if(toPrintOutput == 1)
-				{
-					printf("(%d,",code.offset);
-					printf("%d,",code.length);
-					printf("%d),",code.slide);             
-				}
-				distance+= Buffer[temp_index].length;
-				Buffer[temp_index].bool_writed = 1;
+			if (size == 1 + 8)
+			{
+				tokens->kind[n] = UNCODED;
+				tokens->offset[n] = (unsigned short)TakeField(word, 1, 8);
+				tokens->length[n] = 1;
 			}
 			else
 			{
-				distance+= Buffer[temp_index].length;
+				tokens->kind[n] = ENCODED;
+				tokens->offset[n] = (unsigned short)TakeField(word, 1,
+					OFFSET_BITS);
+				tokens->length[n] = (unsigned char)TakeField(word,
+					1 + OFFSET_BITS, LENGTH_BITS);
 			}
 
-			temp_index = Wrap((temp_index + 1), WINDOW_SIZE);
+			tokens->slide[n] = 0;
+			used += size;
+			n++;
 		}
 
-		/************************************************************************
-		* Part B - write the first item (if it is not have been alredy writed
-		************************************************************************/
+		BitFileSkipBits(bfpIn, used);
 
-		if(Buffer[head].length == 1) // if char
+		if (0 == used)
 		{
-			BitFilePutBit(UNCODED, bfpOut);
-			BitFilePutChar(Buffer[head].ch, bfpOut);
-
-			if(toPrintOutput == 1)
-				printf("%c,",Buffer[head].ch);
+			/* not even one whole item is left */
+			tokens->count = n;
+			return EOF;
 		}
+	}
+
+	tokens->count = n;
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : UnpackProject
+*   Description: This function reads the items of a bit file with a SLIDE
+*				 parameter, or in project format, to a token buffer, until
+*				 it holds TOKEN_CHUNK tokens.  A PAIR has slide 0.  Every
+*				 item is taken with shifts of the bits the bit file holds,
+*				 as many items at a time as they have.
+*   Parameters : bfpIn - pointer to the bit file to read
+*                tokens - the token buffer to append the items to
+*   Effects    : Items are read from bfpIn and appended to tokens.
+*   Returned   : 0 if there may be more items, EOF at the end of the file
+*                or of the last whole item.
+****************************************************************************/
+int UnpackProject(bit_file_t *bfpIn, token_buffer_t *tokens)
+{
+	unsigned long long bits, word;
+	unsigned int count, used, size;
+	size_t n;
+
+	n = tokens->count;
+
+	while (n < TOKEN_CHUNK)
+	{
+		count = BitFilePeekBits(bfpIn, &bits);
+		used = 0;
 
-		else if(Buffer[head].bool_writed == 0 ) // pointer that we didnt write yet
+		/* count is over PROJECT_ITEM_BITS unless the file ends */
+		while ((n < TOKEN_CHUNK) && (used < count))
 		{
-			code.offset = 0;
-			code.length = 0;
-			code.slide = 0;
-			if ((c = BitFileGetChar(bfpIn)) == EOF)
+			word = bits << used;
+
+			if ((word >> 63) == UNCODED)
+			{
+				size = 1 + 8;
+			}
+			else if (count - used < 2)
 			{
 				break;
 			}
-			if (c == PAIR)
+			else if (((word >> 62) & 1) == TRIPLE)
 			{
-				if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
-				}
+				size = PROJECT_ITEM_BITS;
+			}
+			else
+			{
+				size = PROJECT_ITEM_BITS - SLIDE_BITS;
+			}
 
-				if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
-				}
+			if (size > count - used)
+			{
+				break;
+			}
 
+			if (size == 1 + 8)
+			{
+				tokens->kind[n] = UNCODED;
+				tokens->offset[n] = (unsigned short)TakeField(word, 1, 8);
+				tokens->length[n] = 1;
+				tokens->slide[n] = 0;
 			}
 			else
 			{
-				if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
-				}
-
-				if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
-				}
-				if ((BitFileGetBitsNum(bfpIn, &code.slide, SLIDE_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
-				}
+				tokens->kind[n] = ENCODED;
+				tokens->offset[n] = (unsigned short)TakeField(word, 2,
+					OFFSET_BITS);
+				tokens->length[n] = (unsigned char)TakeField(word,
+					2 + OFFSET_BITS, LENGTH_BITS);
+				tokens->slide[n] = (size == PROJECT_ITEM_BITS) ?
+					(unsigned short)TakeField(word,
+					2 + OFFSET_BITS + LENGTH_BITS, SLIDE_BITS) : 0;
 			}
 
-			Buffer[tail].offset = code.offset;
-			Buffer[tail].length = code.length;
-			Buffer[tail].slide  = code.slide;
-			Buffer[tail].bool_writed = 0;
-			Buffer[tail].ch = 0;
+			used += size;
+			n++;
 		}
 
-		head = Wrap((head + 1), WINDOW_SIZE);
-		len--;
+		BitFileSkipBits(bfpIn, used);
+
+		if (0 == used)
+		{
+			/* not even one whole item is left */
+			tokens->count = n;
+			return EOF;
+		}
 	}
 
+	tokens->count = n;
+	return 0;
+}
 
+/****************************************************************************
+*   Function   : TakeField
+*   Description: This function takes a field of an item from the bits of a
+*				 bit file, as BitFileGetBitsNum reads it: the first 8 bits
+*				 are the low byte, the next 8 the byte above it, and the
+*				 bits left over the low bits of the last byte.
+*   Parameters : word - the bits, the first one the msb
+*                first - the number of bits before the field
+*                count - the number of bits of the field
+*   Effects    : None
+*   Returned   : The field.
+****************************************************************************/
+static unsigned int TakeField(unsigned long long word, unsigned int first,
+	unsigned int count)
+{
+	unsigned long long raw;
+	unsigned int value, shift;
 
+	raw = (word << first) >> (64 - count);
+	value = 0;
 
-	/* we've decoded everything, free bitfile structure */
-	BitFileToFILE(bfpIn);
-	BitFileToFILE(bfpOut);
+	for (shift = 0; count >= 8; shift += 8, count -= 8)
+	{
+		value |= (unsigned int)((raw >> (count - 8)) & 0xFF) << shift;
+	}
 
-	return 0;
+	return value | ((unsigned int)raw & ((1U << count) - 1)) << shift;
 }
 
 /****************************************************************************
-*   Function   : CastBack
-*   Description: This function gets the encoded file according to the format V2 of the project, and transforms it to the traditional LZSS encoded file 
-*   Parameters : fpIn - pointer to the project encoded file
-*                fpOut - pointer to the open binary file to write encoded output according to LZSS format. 
-*   Effects    : fpIn moves every pointer to the right place according to the OFFSET and SLIDE parameters and written to fpOut.  Neither file is
-*                closed after exit.
-*   Returned   : 0 for success, -1 for failure.  errno will be set in the
-*                event of a failure.
+*   Function   : PackLZSS
+*   Description: This function writes the tokens of a token buffer in LZSS
+*				 format, without their slides.
+*   Parameters : bfpOut - pointer to the bit file to write to
+*                tokens - the token buffer
+*   Effects    : The tokens are written to bfpOut and tokens is emptied.
+*   Returned   : None
 ****************************************************************************/
-int CastBack(FILE *fpIn, FILE *fpOut)
+static void PackLZSS(bit_file_t *bfpOut, token_buffer_t *tokens)
 {
-	bit_file_t *bfpIn;
-	bit_file_t *bfpOut;
-	int c;
-	unsigned int i,toPrintOutput;
-	encoded_string_t code;              
-	encoded Buffer[BUFFER_SIZE];
-	unsigned int head ,index;
-	encoded Pointer;
+	unsigned int offset, length;
+	size_t i;
 
-	/* use stdin if no input file */
-	if ((NULL == fpIn) || (NULL == fpOut))
+	for (i = 0; i < tokens->count; i++)
 	{
-		errno = ENOENT;
-		return -1;
+		if (tokens->kind[i] == UNCODED)
+		{
+			BitFilePutBit(UNCODED, bfpOut);
+			BitFilePutChar(tokens->offset[i], bfpOut);
+		}
+		else
+		{
+			offset = tokens->offset[i];
+			length = tokens->length[i];
+			BitFilePutBit(ENCODED, bfpOut);
+			BitFilePutBitsNum(bfpOut, &offset, OFFSET_BITS,
+				sizeof(unsigned int));
+			BitFilePutBitsNum(bfpOut, &length, LENGTH_BITS,
+				sizeof(unsigned int));
+		}
 	}
 
-	/* convert input file to bitfile */
-	bfpIn = MakeBitFile(fpIn, BF_READ);
+	tokens->count = 0;
+}
 
-	if (NULL == bfpIn)
+/****************************************************************************
+*   Function   : PackProject
+*   Description: This function writes the tokens of a token buffer
+*				 according to project format v2: a pointer is a PAIR if
+*				 there is no slide, otherwise a TRIPLE.
+*   Parameters : bfpOut - pointer to the bit file to write to
+*                tokens - the token buffer
+*   Effects    : The tokens are written to bfpOut and tokens is emptied.
+*   Returned   : None
+****************************************************************************/
+static void PackProject(bit_file_t *bfpOut, token_buffer_t *tokens)
+{
+	unsigned int offset, length, slide;
+	size_t i;
+
+	for (i = 0; i < tokens->count; i++)
 	{
-		perror("Making Input File a BitFile");
-		return -1;
+		if (tokens->kind[i] == UNCODED)
+		{
+			BitFilePutBit(UNCODED, bfpOut);
+			BitFilePutChar(tokens->offset[i], bfpOut);
+			continue;
+		}
+
+		offset = tokens->offset[i];
+		length = tokens->length[i];
+		slide = tokens->slide[i];
+		BitFilePutBit(ENCODED, bfpOut);
+		BitFilePutBit((0 == slide) ? PAIR : TRIPLE, bfpOut);
+		BitFilePutBitsNum(bfpOut, &offset, OFFSET_BITS, sizeof(unsigned int));
+		BitFilePutBitsNum(bfpOut, &length, LENGTH_BITS, sizeof(unsigned int));
+
+		if (slide != 0)
+		{
+			BitFilePutBitsNum(bfpOut, &slide, SLIDE_BITS,
+				sizeof(unsigned int));
+		}
 	}
 
-	/* convert output file to bitfile */
-	bfpOut = MakeBitFile(fpOut, BF_WRITE);
+	tokens->count = 0;
+}
 
-	if (NULL == bfpOut)
+/****************************************************************************
+*   Function   : DecodeProject
+*   Description: This function decodes a file encoded according to project
+*				 format v2 directly, without casting it back to LZSS.  A
+*				 pointer is read before its target: the characters it
+*				 copies are already known, so they are copied into the
+*				 text ring at the target right away, and the target is
+*				 written out when the next character is reached.
+*   Parameters : fpIn - pointer to the project encoded file
+*                fpOut - pointer to the open binary file to write decoded
+*                       output
+*   Effects    : fpIn is decoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int DecodeProject(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(DecodeProjectBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : DecodeProjectBits
+*   Description: This function decodes a bit file encoded according to
+*				 project format v2 for DecodeProject and DecodeProjectBuf.
+*   Parameters : bfpIn - pointer to the project encoded bit file
+*                bfpOut - pointer to the bit file to write decoded output
+*   Effects    : bfpIn is decoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int DecodeProjectBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	encoded item;
+	token_buffer_t tokens;
+	unsigned int i, length, head, index, source, toPrintOutput;
+	int end;
+	size_t t;
+
+	/* text ring, and the length of the target that starts at every index */
+	unsigned char Text[PROJECT_RING_SIZE];
+	unsigned int pending[PROJECT_RING_SIZE];
+
+	DEBUG_PRINT();
+
+	if (TokensInit(&tokens) != 0)
 	{
-		perror("Making Output File a BitFile");
 		return -1;
 	}
-	//toPrintOutput = 1;// debug
-	DEBUG_PRINT();
-	/************************************************************************
-	* Initialize Buffer and Text arrays  
-	************************************************************************/
-	for(i = 0; i < BUFFER_SIZE; i++)
+
+	/* the characters before the text are the ones EncodeLZSS fills the window with */
+	memset(Text, '~', PROJECT_RING_SIZE * sizeof(unsigned char));
+
+	for(i = 0; i < PROJECT_RING_SIZE; i++)
 	{
-		Buffer[i].ch = 0;
-		Buffer[i].length = 0;
-		Buffer[i].offset = 0;
-		Buffer[i].slide = 0;
-		Buffer[i].bool_writed = 1;
+		pending[i] = 0;
 	}
 
 	head = 0;
 
-	while (1)
+	do
 	{
-		if ((c = BitFileGetBit(bfpIn)) == EOF)
-		{
-			/* we hit the EOF */
-			break;
-		}
-		if (c == UNCODED)
-		{
-			if ((c = BitFileGetChar(bfpIn)) == EOF)//replace if and while
-			{
-				break;
-			}
-			
-			while(Buffer[head].bool_writed ==  0 ) // write pointers that should appear
-			{
-				Pointer.offset = Buffer[head].offset; 
-				Pointer.length = Buffer[head].length;
-
-				BitFilePutBit(ENCODED, bfpOut);
-				BitFilePutBitsNum(bfpOut, &Pointer.offset, OFFSET_BITS, sizeof(unsigned int));
-				BitFilePutBitsNum(bfpOut, &Pointer.length, LENGTH_BITS, sizeof(unsigned int));
-
-				if(toPrintOutput == 1)
-				{
-					printf("(%d,",Pointer.offset);
-					printf("%d),",Pointer.length);
-
-				}
-
-				Buffer[head].bool_writed = 1;// sign the pointer
-				head = Wrap((head + Buffer[head].length ), BUFFER_SIZE);
-			}
-			//write the new characters
-			BitFilePutBit(UNCODED, bfpOut);
-			BitFilePutChar(c, bfpOut);
-
-			if(toPrintOutput == 1)
-				printf("%c,",c);
+		end = UnpackProject(bfpIn, &tokens);
 
-			head = Wrap((head + 1), BUFFER_SIZE);
-
-		}
-		else // c==CODED
+		for (t = 0; t < tokens.count; t++)
 		{
-			//insert the pointer to the right place at buffer
-			code.offset = 0;
-			code.length = 0;
-			code.slide = 0;
+			/* a pointer of length 1 is taken for the character 0 */
+			item.ch = (tokens.kind[t] == UNCODED) ? tokens.offset[t] : 0;
+			item.offset = (tokens.kind[t] == UNCODED) ? 0 : tokens.offset[t];
+			item.length = tokens.length[t];
+			item.slide = tokens.slide[t];
 
-			if ((c = BitFileGetBit(bfpIn)) == EOF)
-			{
-				/* we hit the EOF */
-				break;
-			}
-			if( c == PAIR)
+			if(item.length == 1) // if char
 			{
-				if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
+				/* write the targets that come before the character */
+				while(pending[head] != 0)
 				{
-					c = EOF;
-					break;
-				}
+					length = pending[head];
+					pending[head] = 0;
 
-				if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
+					for(i = 0; i < length; i++)
+					{
+						BitFilePutChar(Text[head], bfpOut);
+						if(toPrintOutput == 1)
+							printf("%c",Text[head]);
+						head = Wrap((head + 1), PROJECT_RING_SIZE);
+					}
 				}
 
+				BitFilePutChar(item.ch, bfpOut);
+				Text[head] = item.ch;
+				head = Wrap((head + 1), PROJECT_RING_SIZE);
+
+				if(toPrintOutput == 1)
+					printf("%c",item.ch);
 			}
 			else
 			{
-				if ((BitFileGetBitsNum(bfpIn, &code.offset, OFFSET_BITS, sizeof(unsigned int))) == EOF)
-				{
-					c = EOF;
-					break;
-				}
+				/* the target is offset + slide characters after head, the source
+				 * is offset + length characters before the target */
+				index = Wrap((head + item.offset + item.slide), PROJECT_RING_SIZE);
+				source = Wrap((index + PROJECT_RING_SIZE - (item.offset + item.length)),
+					PROJECT_RING_SIZE);
 
-				if ((BitFileGetBitsNum(bfpIn, &code.length, LENGTH_BITS, sizeof(unsigned int))) == EOF)
+				for(i = 0; i < item.length; i++)
 				{
-					break;
-				}
-				if ((BitFileGetBitsNum(bfpIn, &code.slide, SLIDE_BITS, sizeof(unsigned int))) == EOF)
-				{
-					break;
+					Text[Wrap((index + i), PROJECT_RING_SIZE)] =
+						Text[Wrap((source + i), PROJECT_RING_SIZE)];
 				}
+
+				pending[index] = item.length;
 			}
+		}
 
-			index = head + code.offset + code.slide;// -1
-			index = Wrap((index), BUFFER_SIZE);
-			Buffer[index].offset = code.offset + code.length;// no need Wrap, i think
-			Buffer[index].length = code.length;
-			Buffer[index].bool_writed = 0;
+		tokens.count = 0;
+	} while (end != EOF);
+
+	TokensFree(&tokens);
+
+	/* write the targets that remain after the last character */
+	while(pending[head] != 0)
+	{
+		length = pending[head];
+		pending[head] = 0;
+
+		for(i = 0; i < length; i++)
+		{
+			BitFilePutChar(Text[head], bfpOut);
+			if(toPrintOutput == 1)
+				printf("%c",Text[head]);
+			head = Wrap((head + 1), PROJECT_RING_SIZE);
 		}
 	}
 
-	/************************************************************************
-	* handle the itemes that remains in the buffer
-	************************************************************************/
 
-	for(i = 0; i < BUFFER_SIZE; i++)
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : EncodeLZSSBuf
+*                EncodeProjectBuf
+*                EncodeLZSSParseBuf
+*                EncodeProjectParseBuf
+*                DecodeLZSSBuf
+*                AddSlideBuf
+*                CastEncodeLZSSBuf
+*                CastBackBuf
+*                AddSlideCastBuf
+*                DecodeProjectBuf
+*   Description: These functions are the in memory versions of the stages
+*				 with the same names.  They read the inSize bytes at in and
+*				 allocate the buffer they write.
+*   Parameters : in - the input buffer
+*                inSize - number of bytes in the input buffer
+*                mode - how the text is parsed, for the Parse versions
+*                out - set to the allocated output buffer, which the caller
+*                      has to free
+*                outSize - set to the number of bytes in the output buffer
+*   Effects    : in is read and the output of the stage written to *out.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int EncodeLZSSBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(EncodeLZSSBits, in, inSize, out, outSize);
+}
+
+int EncodeProjectBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(EncodeProjectBits, in, inSize, out, outSize);
+}
+
+int EncodeLZSSParseBuf(const unsigned char *in, size_t inSize,
+	parse_mode_t mode, unsigned char **out, size_t *outSize)
+{
+	stage_func_t stage;
+
+	stage = ParseStage(mode, 0);
+
+	if (NULL == stage)
 	{
-		if(Buffer[head].bool_writed == 0 )
-		{
-			Pointer.offset = Buffer[head].offset; 
-			Pointer.length = Buffer[head].length;
+		return -1;
+	}
 
-			BitFilePutBit(ENCODED, bfpOut);
-			BitFilePutBitsNum(bfpOut, &Pointer.offset, OFFSET_BITS, sizeof(unsigned int));
-			BitFilePutBitsNum(bfpOut, &Pointer.length, LENGTH_BITS, sizeof(unsigned int));
+	return RunBufferStage(stage, in, inSize, out, outSize);
+}
 
-			if(toPrintOutput == 1)
-			{
-				printf("(%d,",Pointer.offset);
-				printf("%d),",Pointer.length);
+int EncodeProjectParseBuf(const unsigned char *in, size_t inSize,
+	parse_mode_t mode, unsigned char **out, size_t *outSize)
+{
+	stage_func_t stage;
 
-			}
+	stage = ParseStage(mode, 1);
+
+	if (NULL == stage)
+	{
+		return -1;
+	}
 
-			Buffer[head].bool_writed = 1;// sign the pointer
+	return RunBufferStage(stage, in, inSize, out, outSize);
+}
 
-		}
+int DecodeLZSSBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	size_t room;
+	long length;
 
-		head = Wrap((head + 1), BUFFER_SIZE);
+	/* validate arguments */
+	if (((NULL == in) && (inSize != 0)) || (NULL == out) || (NULL == outSize))
+	{
+		errno = EINVAL;
+		return -1;
 	}
 
-	/* we've decoded everything, free bitfile structure */
-	BitFileToFILE(bfpIn);
-	BitFileToFILE(bfpOut);
+	/* a pointer of 17 bits copies at most MAX_CODED characters, so this is
+	 * only grown for input that is not LZSS */
+	room = (inSize * 8 / (1 + OFFSET_BITS + LENGTH_BITS)) * MAX_CODED +
+		WINDOW_SIZE;
+	*out = (unsigned char *)malloc(room);
+	*outSize = 0;
+
+	if (NULL == *out)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	length = DecodeFlat(in, inSize, out, &room, 1);
 
+	if (length < 0)
+	{
+		free(*out);
+		*out = NULL;
+		return -1;
+	}
+
+	*outSize = (size_t)length;
 	return 0;
 }
 
+int AddSlideBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(AddSlideBits, in, inSize, out, outSize);
+}
+
+int CastEncodeLZSSBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(CastEncodeBits, in, inSize, out, outSize);
+}
+
+int CastBackBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(CastBackBits, in, inSize, out, outSize);
+}
 
+int AddSlideCastBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(AddSlideCastBits, in, inSize, out, outSize);
+}
 
+int DecodeProjectBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(DecodeProjectBits, in, inSize, out, outSize);
+}
@@ -33,6 +33,70 @@
 #ifndef _LZSS_H
 #define _LZSS_H
 
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stddef.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* block sizes for EncodeBlocks */
+#define BLOCK_DEFAULT_SIZE  (4UL << 20)
+#define BLOCK_MAX_SIZE      (1UL << 30)
+
+/* bytes of text between the checkpoints of IndexLZSS */
+#define CHECKPOINT_DEFAULT_INTERVAL (256UL << 10)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/* called by the compressed matching routines for every occurrence found */
+typedef void (*match_func_t)(unsigned long long offset, void *userData);
+
+/* the same for SearchCompressedMulti, with the index of the pattern */
+typedef void (*multi_match_func_t)(unsigned int id, unsigned long long offset,
+    void *userData);
+
+/* how the encoder chooses between characters and pointers */
+typedef enum
+{
+    PARSE_GREEDY = 0,           /* the longest match at every position */
+    PARSE_LAZY = 1,             /* unless the next position has a longer one */
+    PARSE_OPTIMAL = 2,          /* the fewest bits, 64 KiB of text at a time */
+    PARSE_SLIDE = 3             /* the same, counting the slides of TRIPLEs */
+} parse_mode_t;
+
+/* how the blocks of a block file are encoded (see EncodeBlocks) */
+typedef enum
+{
+    BLOCK_LZSS = 0,             /* EncodeLZSS */
+    BLOCK_PROJECT = 1,          /* EncodeProject */
+    BLOCK_SLIDE = 2             /* EncodeLZSS and AddSlide */
+} block_format_t;
+
+/* the stage a stream or a pipeline runs (see StreamOpen, RunPipeline) */
+typedef enum
+{
+    STREAM_ENCODE_LZSS = 0,     /* EncodeLZSS */
+    STREAM_ENCODE_PROJECT = 1,  /* EncodeProject */
+    STREAM_DECODE_LZSS = 2,     /* DecodeLZSS */
+    STREAM_ADD_SLIDE = 3,       /* AddSlide */
+    STREAM_CAST_ENCODE = 4,     /* CastEncodeLZSS */
+    STREAM_CAST_BACK = 5,       /* CastBack */
+    STREAM_DECODE_PROJECT = 6,  /* DecodeProject */
+    STREAM_ADD_SLIDE_CAST = 7   /* AddSlideCast */
+} stream_stage_t;
+
+/* a stage running on input that is fed to it in pieces (see StreamOpen) */
+typedef struct lzss_stream_t lzss_stream_t;
+
+/* a stage of the pipeline working on buffers in memory (see EncodeLZSSBuf) */
+typedef int (*buffer_func_t)(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
 
 /***************************************************************************
 *                               PROTOTYPES
@@ -50,10 +114,210 @@
 * set in the event of a failure. 
 ***************************************************************************/
 int EncodeLZSS(FILE *fpIn, FILE *fpOut);
+int EncodeProject(FILE *fpIn, FILE *fpOut);
 int DecodeLZSS(FILE *fpIn, FILE *fpOut);
 void diff(FILE *fpIn1, FILE *fpIn2);
 int CastEncodeLZSS(FILE *fpIn, FILE *fpOut);
 int AddSlide(FILE *fpIn, FILE *fpOut);
 int CastBack(FILE *fpIn, FILE *fpOut);
+int DecodeProject(FILE *fpIn, FILE *fpOut);
+
+/***************************************************************************
+* AddSlideCast writes the file AddSlide and then CastEncodeLZSS would, in
+* one pass without the file between them.
+***************************************************************************/
+int AddSlideCast(FILE *fpIn, FILE *fpOut);
+
+/***************************************************************************
+* EncodeLZSS and EncodeProject choose the longest match at every position.
+* These versions parse the text as mode says; PARSE_LAZY and PARSE_OPTIMAL
+* give smaller LZSS files for more encoding time.  The optimal cost does not
+* count the slides of TRIPLEs, so in the project format PARSE_OPTIMAL may
+* even be larger than PARSE_GREEDY; use PARSE_SLIDE there.  The files are
+* decoded as usual.
+***************************************************************************/
+int EncodeLZSSParse(FILE *fpIn, FILE *fpOut, parse_mode_t mode);
+int EncodeProjectParse(FILE *fpIn, FILE *fpOut, parse_mode_t mode);
+
+/***************************************************************************
+* The same functions working on buffers in memory.  They read the inSize
+* bytes at in and set *out to a buffer they allocate with the *outSize
+* bytes of output, which the caller has to free().
+*
+* These functions return 0 for success and -1 for failure.  errno will be
+* set in the event of a failure.
+***************************************************************************/
+int EncodeLZSSBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int EncodeProjectBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int DecodeLZSSBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int AddSlideBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int CastEncodeLZSSBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int CastBackBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int AddSlideCastBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int DecodeProjectBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+int EncodeLZSSParseBuf(const unsigned char *in, size_t inSize,
+    parse_mode_t mode, unsigned char **out, size_t *outSize);
+int EncodeProjectParseBuf(const unsigned char *in, size_t inSize,
+    parse_mode_t mode, unsigned char **out, size_t *outSize);
+
+/***************************************************************************
+* DecodeLZSSInto decodes the inSize bytes at in, encoded with EncodeLZSS,
+* into the outSize bytes at out, which the caller provides.  The bytes of
+* out after the text may be overwritten.
+*
+* It returns the number of bytes of text and -1 for failure.  errno will be
+* set in the event of a failure, to ENOBUFS if the text does not fit.
+***************************************************************************/
+long DecodeLZSSInto(const unsigned char *in, size_t inSize,
+    unsigned char *out, size_t outSize);
+
+/***************************************************************************
+* LZSS with the widths of the offset and length chosen for every stream.
+* EncodeLZSSWidths writes a header with the widths and the window fill
+* followed by the items, and DecodeLZSSWidths decodes with the widths of
+* the header.  The pairs of widths supported are 12 and 4, 16 and 8, and 20
+* and 8 (a 1 MiB window and matches of up to 255 characters).
+*
+* These functions return 0 for success and -1 for failure.  errno will be
+* set in the event of a failure, to ENOTSUP for other widths.
+***************************************************************************/
+int EncodeLZSSWidths(FILE *fpIn, FILE *fpOut, unsigned int offsetBits,
+    unsigned int lengthBits);
+int DecodeLZSSWidths(FILE *fpIn, FILE *fpOut);
+int EncodeLZSSWidthsBuf(const unsigned char *in, size_t inSize,
+    unsigned int offsetBits, unsigned int lengthBits,
+    unsigned char **out, size_t *outSize);
+int DecodeLZSSWidthsBuf(const unsigned char *in, size_t inSize,
+    unsigned char **out, size_t *outSize);
+
+/***************************************************************************
+* Streams run a stage on input that arrives in pieces, such as a log being
+* written or data from a socket.  StreamOpen starts the stage on a thread of
+* its own.  StreamFeed passes it the next size bytes of input, and waits
+* only while a lot of earlier input has not been read yet.  StreamDrain
+* copies up to size bytes of the output written so far to out without
+* waiting, and returns their number.  StreamFinish ends the input and waits
+* for the stage to finish; the rest of the output can be drained after it.
+* StreamClose frees a stream, finishing it first if needed.
+*
+* Output is passed on in blocks of a few KiB, and the last bits of it only
+* after StreamFinish.
+*
+* StreamOpen returns NULL, StreamFeed and StreamFinish -1 for failure.
+* errno will be set in the event of a failure.
+***************************************************************************/
+lzss_stream_t *StreamOpen(stream_stage_t stage);
+int StreamFeed(lzss_stream_t *stream, const unsigned char *data,
+    size_t size);
+size_t StreamDrain(lzss_stream_t *stream, unsigned char *out, size_t size);
+int StreamFinish(lzss_stream_t *stream);
+void StreamClose(lzss_stream_t *stream);
+
+/***************************************************************************
+* RunPipeline runs a chain of count stages on fpIn, each stage reading the
+* output of the one before it, and writes the output of the last stage to
+* fpOut.  The stages run at the same time on threads of their own, so the
+* chain takes about as long as its slowest stage.  For example
+* {STREAM_ENCODE_LZSS, STREAM_ADD_SLIDE, STREAM_CAST_ENCODE} encodes fpIn to
+* the project format.
+*
+* It returns 0 for success and -1 for failure.  errno will be set in the
+* event of a failure.
+***************************************************************************/
+int RunPipeline(FILE *fpIn, FILE *fpOut, const stream_stage_t *stages,
+    unsigned int count);
+
+/***************************************************************************
+* MapFileStage runs one of the buffer functions above on the file inName,
+* mapped into memory, and writes the output to the file outName.
+*
+* It returns 0 for success and -1 for failure.  errno will be set in the
+* event of a failure.
+***************************************************************************/
+int MapFileStage(buffer_func_t func, const char *inName, const char *outName);
+
+/***************************************************************************
+* Block file prototypes.  EncodeBlocks splits fpIn into blocks of blockSize
+* bytes and encodes each block on its own, as if it were a file of its own,
+* using threads threads (0 for one on every processor).  The blocks are
+* written to fpOut with a table of the blocks.  The file records the
+* format, the bit widths and the window fill it was written with, and a
+* checksum of every block.  DecodeBlocks decodes such a file, which has to
+* be seekable, the same way, and checks the checksums.
+*
+* The project format can't hold every text, so EncodeBlocks decodes every
+* BLOCK_PROJECT block again and fails with errno set to ENOTSUP if it does
+* not come back, rather than write a file that can't be decoded.
+*
+* These functions return 0 for success and -1 for failure.  errno will be
+* set in the event of a failure.
+*
+* VerifyBlocks checks the checksums of the blocks without decoding them and
+* returns the number of damaged blocks, or -1 for failure.
+***************************************************************************/
+int EncodeBlocks(FILE *fpIn, FILE *fpOut, block_format_t format,
+    size_t blockSize, unsigned int threads);
+int DecodeBlocks(FILE *fpIn, FILE *fpOut, unsigned int threads);
+long VerifyBlocks(FILE *fpIn, unsigned int threads);
+
+/***************************************************************************
+* Random access prototypes.  IndexLZSS writes an index of a file encoded
+* with EncodeLZSS to fpIndex, with a checkpoint every interval bytes of text
+* (at least 4096).  DecodeRange decodes the length bytes of text at offset
+* start of such a file into out, from the last checkpoint before start.
+* fpIndex may be NULL, then decoding starts at the beginning of the file.
+* Both files have to be seekable.
+*
+* IndexLZSS returns 0 for success, DecodeRange the number of bytes decoded,
+* which is less than length at the end of the text.  Both return -1 for
+* failure.  errno will be set in the event of a failure.
+***************************************************************************/
+int IndexLZSS(FILE *fpIn, FILE *fpIndex, unsigned long interval);
+long DecodeRange(FILE *fpIn, FILE *fpIndex, unsigned long long start,
+    unsigned char *out, size_t length);
+
+/***************************************************************************
+* Compressed matching prototypes.  These functions look for a pattern
+* directly in a file encoded according to the project format (the output of
+* CastEncodeLZSS), without decoding it.  SearchCompressed prints the offset
+* of every occurrence in the original text, SearchCompressedEx passes it to
+* matchFunc instead.  SearchCompressedHorspool finds the same occurrences
+* with Horspool's algorithm, which looks at fewer characters the longer the
+* pattern is.  SearchCompressedMulti looks for count patterns in one pass
+* and passes the index of the pattern with every offset, in order of the
+* position the occurrences end at.
+*
+* These functions return the number of occurrences found and -1 for
+* failure.  errno will be set in the event of a failure.
+***************************************************************************/
+long SearchCompressed(FILE *compProject, const unsigned char *pattern,
+    size_t m);
+long SearchCompressedEx(FILE *compProject, const unsigned char *pattern,
+    size_t m, match_func_t matchFunc, void *userData);
+long SearchCompressedHorspool(FILE *compProject, const unsigned char *pattern,
+    size_t m, match_func_t matchFunc, void *userData);
+long SearchCompressedMulti(FILE *compProject,
+    const unsigned char *const *patterns, const size_t *lengths,
+    unsigned int count, multi_match_func_t matchFunc, void *userData);
+
+/***************************************************************************
+* SearchBlocks looks for a pattern in a block file encoded with
+* BLOCK_PROJECT (see EncodeBlocks), searching the blocks on threads threads
+* (0 for one on every processor).  The occurrences, including the ones that
+* cross blocks, are passed to matchFunc in order from the calling thread.
+*
+* It returns the number of occurrences found and -1 for failure.  errno
+* will be set in the event of a failure.
+***************************************************************************/
+long SearchBlocks(FILE *blocks, const unsigned char *pattern, size_t m,
+    match_func_t matchFunc, void *userData, unsigned int threads);
 
 #endif      /* ndef _LZSS_H */
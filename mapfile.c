@@ -0,0 +1,258 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : mapfile.c
+*   Purpose : Run the stages of the lzss library on a file mapped into
+*             memory instead of reading it through stdio.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "lzss.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int MapFile(const char *name, unsigned char **data, size_t *size);
+static void UnmapFile(unsigned char *data, size_t size);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+#ifndef _WIN32
+
+/****************************************************************************
+*   Function   : MapFile
+*   Description: This function maps a file into memory for reading.  The
+*				 stages read their input once from start to end, so the
+*				 kernel is told to read ahead.
+*   Parameters : name - name of the file
+*                data - set to the mapped file, NULL for an empty file
+*                size - set to the size of the file
+*   Effects    : The file is mapped until UnmapFile is called.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int MapFile(const char *name, unsigned char **data, size_t *size)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	*data = NULL;
+	*size = 0;
+
+	if ((fd = open(name, O_RDONLY)) < 0)
+	{
+		return -1;
+	}
+
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	/* mmap refuses empty files */
+	if (st.st_size > 0)
+	{
+		map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (MAP_FAILED == map)
+		{
+			close(fd);
+			return -1;
+		}
+
+		madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+		*data = map;
+		*size = (size_t)st.st_size;
+	}
+
+	/* the mapping stays valid after the file is closed */
+	close(fd);
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : UnmapFile
+*   Description: This function unmaps a file mapped by MapFile.
+*   Parameters : data - the mapped file
+*                size - the size of the file
+*   Effects    : The file is unmapped.
+*   Returned   : None
+****************************************************************************/
+static void UnmapFile(unsigned char *data, size_t size)
+{
+	if (data != NULL)
+	{
+		munmap(data, size);
+	}
+}
+
+#else
+
+/****************************************************************************
+*   Function   : MapFile
+*   Description: This function reads a whole file into memory, where there
+*				 is no mmap.
+*   Parameters : name - name of the file
+*                data - set to the file data, NULL for an empty file
+*                size - set to the size of the file
+*   Effects    : The data is kept until UnmapFile is called.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int MapFile(const char *name, unsigned char **data, size_t *size)
+{
+	FILE *fp;
+	long length;
+
+	*data = NULL;
+	*size = 0;
+
+	if ((fp = fopen(name, "rb")) == NULL)
+	{
+		return -1;
+	}
+
+	if ((fseek(fp, 0, SEEK_END) != 0) || ((length = ftell(fp)) < 0))
+	{
+		fclose(fp);
+		return -1;
+	}
+
+	rewind(fp);
+
+	if (length > 0)
+	{
+		if ((*data = malloc((size_t)length)) == NULL)
+		{
+			fclose(fp);
+			errno = ENOMEM;
+			return -1;
+		}
+
+		if (fread(*data, 1, (size_t)length, fp) != (size_t)length)
+		{
+			free(*data);
+			*data = NULL;
+			fclose(fp);
+			errno = EIO;
+			return -1;
+		}
+
+		*size = (size_t)length;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : UnmapFile
+*   Description: This function frees a file read by MapFile.
+*   Parameters : data - the file data
+*                size - the size of the file
+*   Effects    : The data is freed.
+*   Returned   : None
+****************************************************************************/
+static void UnmapFile(unsigned char *data, size_t size)
+{
+	(void)size;
+	free(data);
+}
+
+#endif
+
+/****************************************************************************
+*   Function   : MapFileStage
+*   Description: This function maps the file inName into memory, runs a
+*				 stage that works on buffers on it, and writes the output
+*				 of the stage to the file outName.
+*   Parameters : func - the stage, one of the Buf functions of lzss.h
+*                inName - name of the file to read
+*                outName - name of the file to write
+*   Effects    : outName is created with the output of the stage.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int MapFileStage(buffer_func_t func, const char *inName, const char *outName)
+{
+	unsigned char *in, *out;
+	size_t inSize, outSize;
+	FILE *fpOut;
+	int result;
+
+	/* validate arguments */
+	if ((NULL == func) || (NULL == inName) || (NULL == outName))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (MapFile(inName, &in, &inSize) != 0)
+	{
+		return -1;
+	}
+
+	result = func(in, inSize, &out, &outSize);
+	UnmapFile(in, inSize);
+
+	if (result != 0)
+	{
+		return -1;
+	}
+
+	if ((fpOut = fopen(outName, "wb")) == NULL)
+	{
+		free(out);
+		return -1;
+	}
+
+	if (fwrite(out, 1, outSize, fpOut) != outSize)
+	{
+		result = -1;
+	}
+
+	if (fclose(fpOut) != 0)
+	{
+		result = -1;
+	}
+
+	free(out);
+	return result;
+}
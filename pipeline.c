@@ -0,0 +1,438 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : pipeline.c
+*   Purpose : Run a chain of stages of the pipeline at the same time, every
+*             stage on a thread of its own, passing the output of every
+*             stage to the next one through a ring in memory.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "lzss.h"
+#include "lzlocal.h"
+#include "bitfile.h"
+
+/***************************************************************************
+* Every ring has one writer, the stage before it, and one reader, the stage
+* after it, so it needs no lock: head is only stored by the writer and tail
+* only by the reader.  A stage that finds its ring full or empty yields its
+* processor until the other stage moved on.  The first stage reads fpIn and
+* the last one writes fpOut, as RunFileStage does.
+***************************************************************************/
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* bytes of a ring, a power of 2 */
+#define PIPE_RING_SIZE      (1U << 20)
+
+/* bytes the bit files of the rings read and write at a time */
+#define PIPE_BLOCK_SIZE     (64U << 10)
+
+/* keeps the fields the writer and the reader store on their own cache lines */
+#define PIPE_LINE_SIZE      64
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/***************************************************************************
+* A ring between two stages.  head and tail count the bytes written and
+* read, the bytes between them are at data + (tail & (PIPE_RING_SIZE - 1)).
+* closed is set by the writer after its last byte, abandoned by the reader
+* when it stops reading.
+***************************************************************************/
+typedef struct pipe_ring_t
+{
+	unsigned char *data;
+	char pad1[PIPE_LINE_SIZE];
+	atomic_size_t head;
+	atomic_int closed;
+	char pad2[PIPE_LINE_SIZE];
+	atomic_size_t tail;
+	atomic_int abandoned;
+	char pad3[PIPE_LINE_SIZE];
+} pipe_ring_t;
+
+/* a stage of the chain and the bit files it reads and writes */
+typedef struct pipe_stage_t
+{
+	stage_func_t stage;
+	bit_file_t *bfpIn;
+	bit_file_t *bfpOut;
+	pipe_ring_t *in;                    /* NULL for the first stage */
+	pipe_ring_t *out;                   /* NULL for the last stage */
+	int result;
+	int error;                          /* errno of a failed stage */
+} pipe_stage_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void *PipeWorker(void *arg);
+static void RunPipeStage(pipe_stage_t *stage);
+static size_t PipeRead(void *handle, unsigned char *data, size_t size);
+static size_t PipeWrite(void *handle, unsigned char *data, size_t size);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : RunPipeline
+*   Description: This function runs a chain of stages on two open files.
+*				 The first stage reads fpIn, every stage reads the output
+*				 of the one before it, and the last stage writes fpOut.
+*				 All the stages run at the same time, the last one on the
+*				 calling thread.
+*   Parameters : fpIn - pointer to the open binary file to read
+*                fpOut - pointer to the open binary file to write output
+*                stages - the stages, in order
+*                count - number of stages
+*   Effects    : fpIn is read by the chain and its output written to fpOut.
+*                Neither file is closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to the errno of the first stage that
+*                failed.
+****************************************************************************/
+int RunPipeline(FILE *fpIn, FILE *fpOut, const stream_stage_t *stages,
+	unsigned int count)
+{
+	pipe_stage_t *chain;
+	pipe_ring_t *rings;
+	pthread_t *thread;
+	unsigned int i, created;
+	int result, error;
+
+	/* validate arguments */
+	if ((NULL == fpIn) || (NULL == fpOut) || (NULL == stages) ||
+		(0 == count))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	chain = (pipe_stage_t *)calloc(count, sizeof(pipe_stage_t));
+	rings = (pipe_ring_t *)calloc(count, sizeof(pipe_ring_t));
+	thread = (pthread_t *)malloc(count * sizeof(pthread_t));
+
+	if ((NULL == chain) || (NULL == rings) || (NULL == thread))
+	{
+		free(chain);
+		free(rings);
+		free(thread);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	result = 0;
+	error = 0;
+
+	/* ring i is between stage i and stage i + 1 */
+	for (i = 0; (i < count) && (0 == result); i++)
+	{
+		chain[i].stage = FindStage(stages[i]);
+
+		if (NULL == chain[i].stage)
+		{
+			error = errno;
+			result = -1;
+			break;
+		}
+
+		if (i + 1 < count)
+		{
+			rings[i].data = (unsigned char *)malloc(PIPE_RING_SIZE);
+			atomic_init(&rings[i].head, 0);
+			atomic_init(&rings[i].closed, 0);
+			atomic_init(&rings[i].tail, 0);
+			atomic_init(&rings[i].abandoned, 0);
+			chain[i].out = &rings[i];
+			chain[i].bfpOut = MakeCallbackBitFile(PipeWrite, &rings[i],
+				PIPE_BLOCK_SIZE, BF_WRITE);
+		}
+		else
+		{
+			chain[i].bfpOut = MakeBitFile(fpOut, BF_WRITE);
+		}
+
+		if (0 == i)
+		{
+			chain[i].bfpIn = MakeBitFile(fpIn, BF_READ);
+		}
+		else
+		{
+			chain[i].in = &rings[i - 1];
+			chain[i].bfpIn = MakeCallbackBitFile(PipeRead, &rings[i - 1],
+				PIPE_BLOCK_SIZE, BF_READ);
+		}
+
+		if ((NULL == chain[i].bfpIn) || (NULL == chain[i].bfpOut) ||
+			((chain[i].out != NULL) && (NULL == chain[i].out->data)))
+		{
+			error = ENOMEM;
+			result = -1;
+		}
+	}
+
+	created = 0;
+
+	if (0 == result)
+	{
+		for (created = 0; created + 1 < count; created++)
+		{
+			if (pthread_create(&thread[created], NULL, PipeWorker,
+				&chain[created]) != 0)
+			{
+				/* the stages before it end when it does not read */
+				if (created > 0)
+				{
+					atomic_store(&rings[created - 1].abandoned, 1);
+				}
+
+				error = EAGAIN;
+				result = -1;
+				break;
+			}
+		}
+	}
+
+	if (0 == result)
+	{
+		RunPipeStage(&chain[count - 1]);
+	}
+
+	for (i = 0; i < created; i++)
+	{
+		pthread_join(thread[i], NULL);
+	}
+
+	/* report the first stage that failed */
+	for (i = 0; (i < count) && (0 == result); i++)
+	{
+		if (chain[i].result != 0)
+		{
+			error = chain[i].error;
+			result = -1;
+		}
+	}
+
+	/* the bit files of the files, and of stages that never ran */
+	for (i = 0; i < count; i++)
+	{
+		if (chain[i].bfpIn != NULL)
+		{
+			if (chain[i].in != NULL)
+			{
+				BitFileClose(chain[i].bfpIn);
+			}
+			else
+			{
+				BitFileToFILE(chain[i].bfpIn);
+			}
+		}
+
+		if (chain[i].bfpOut != NULL)
+		{
+			if (chain[i].out != NULL)
+			{
+				BitFileClose(chain[i].bfpOut);
+			}
+			else
+			{
+				BitFileToFILE(chain[i].bfpOut);
+			}
+		}
+
+		free(rings[i].data);
+	}
+
+	free(chain);
+	free(rings);
+	free(thread);
+
+	if (result != 0)
+	{
+		errno = error;
+	}
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : PipeWorker
+*   Description: This function is the thread of a stage of a chain.
+*   Parameters : arg - the stage
+*   Effects    : The stage is run (see RunPipeStage).
+*   Returned   : NULL
+****************************************************************************/
+static void *PipeWorker(void *arg)
+{
+	RunPipeStage((pipe_stage_t *)arg);
+	return NULL;
+}
+
+/****************************************************************************
+*   Function   : RunPipeStage
+*   Description: This function runs a stage of a chain, and tells the
+*				 stages next to it that it ended.
+*   Parameters : stage - the stage
+*   Effects    : The stage reads its input and writes its output.  The bit
+*                file of its output ring is closed, which writes its last
+*                bits, and the rings are marked closed and abandoned.
+*   Returned   : None
+****************************************************************************/
+static void RunPipeStage(pipe_stage_t *stage)
+{
+	stage->result = stage->stage(stage->bfpIn, stage->bfpOut);
+	stage->error = errno;
+
+	if (stage->out != NULL)
+	{
+		BitFileClose(stage->bfpOut);
+		stage->bfpOut = NULL;
+		atomic_store_explicit(&stage->out->closed, 1, memory_order_release);
+	}
+
+	if (stage->in != NULL)
+	{
+		atomic_store_explicit(&stage->in->abandoned, 1,
+			memory_order_release);
+	}
+}
+
+/****************************************************************************
+*   Function   : PipeRead
+*   Description: This function reads the ring before a stage for its input
+*				 bit file, waiting until there are bytes in it or the stage
+*				 before it closed it.
+*   Parameters : handle - the ring
+*                data - the buffer to read to
+*                size - number of bytes in data
+*   Effects    : Up to size bytes are moved from the ring to data.
+*   Returned   : The number of bytes read, 0 at the end of the input.
+****************************************************************************/
+static size_t PipeRead(void *handle, unsigned char *data, size_t size)
+{
+	pipe_ring_t *ring = (pipe_ring_t *)handle;
+	size_t head, tail, pos, first;
+
+	tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	while ((head = atomic_load_explicit(&ring->head,
+		memory_order_acquire)) == tail)
+	{
+		if (atomic_load_explicit(&ring->closed, memory_order_acquire))
+		{
+			/* the writer may have written more before it closed */
+			head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+			if (head == tail)
+			{
+				return 0;
+			}
+
+			break;
+		}
+
+		sched_yield();
+	}
+
+	if (size > head - tail)
+	{
+		size = head - tail;
+	}
+
+	/* the bytes may wrap around the end of the ring */
+	pos = tail & (PIPE_RING_SIZE - 1);
+	first = (size < PIPE_RING_SIZE - pos) ? size : PIPE_RING_SIZE - pos;
+	memcpy(data, ring->data + pos, first);
+	memcpy(data + first, ring->data, size - first);
+
+	atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+
+	return size;
+}
+
+/****************************************************************************
+*   Function   : PipeWrite
+*   Description: This function writes the ring after a stage for its output
+*				 bit file, waiting while the ring is full.
+*   Parameters : handle - the ring
+*                data - the output
+*                size - number of bytes of output
+*   Effects    : The output is copied to the ring.
+*   Returned   : size for success, fewer if the stage after the ring stopped
+*                reading it.
+****************************************************************************/
+static size_t PipeWrite(void *handle, unsigned char *data, size_t size)
+{
+	pipe_ring_t *ring = (pipe_ring_t *)handle;
+	size_t head, tail, pos, first, room, written;
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	written = 0;
+
+	while (written < size)
+	{
+		tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		room = PIPE_RING_SIZE - (head - tail);
+
+		if (0 == room)
+		{
+			if (atomic_load_explicit(&ring->abandoned, memory_order_acquire))
+			{
+				break;
+			}
+
+			sched_yield();
+			continue;
+		}
+
+		if (room > size - written)
+		{
+			room = size - written;
+		}
+
+		pos = head & (PIPE_RING_SIZE - 1);
+		first = (room < PIPE_RING_SIZE - pos) ? room : PIPE_RING_SIZE - pos;
+		memcpy(ring->data + pos, data + written, first);
+		memcpy(ring->data, data + written + first, room - first);
+
+		head += room;
+		written += room;
+		atomic_store_explicit(&ring->head, head, memory_order_release);
+	}
+
+	return written;
+}
@@ -37,6 +37,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "lzss.h"
 
 #include "lzlocal.h"
@@ -57,8 +58,18 @@ int main(int argc, char *argv[])
 	FILE *comp;            
 	FILE *compWithSlide;   
 	FILE *compProject;
+	FILE *compProjectFused;
 	FILE *compBackToLzss;
-	FILE *decomp;            
+	FILE *blocks;
+	FILE *index;
+	unsigned char range[64];
+	long rangeLength;
+	const char *tildes = "b~a~~~~~~~a~~aa~~a~aa~b~b~b~~bab~~b~~";
+	unsigned char *parsed, *parsedBack;
+	size_t parsedSize, parsedBackSize;
+	FILE *decomp;
+	const stream_stage_t pipeline[] = {STREAM_ENCODE_LZSS, STREAM_ADD_SLIDE,
+		STREAM_CAST_ENCODE, STREAM_CAST_BACK, STREAM_DECODE_LZSS};            
 	FILE *print;
 	FILE *slideP;
 	unsigned int i;
@@ -155,13 +166,74 @@ int main(int argc, char *argv[])
 	fclose(compProject);
 
 	
+/***************************************************************************
+*                    Encode to Project format in one pass
+***************************************************************************/
+
+	org = fopen("org.txt", "rb");
+
+	if (org == NULL)
+	{
+		perror("Opening input file");
+	}
+
+	compProjectFused = fopen("compProjectFused", "wb");
+
+	if (compProjectFused == NULL)
+	{
+		perror("Opening output file");
+	}
+	printf("\n");
+	printf("Encode To Project Format.....\n");
+	EncodeProject(org, compProjectFused);
+
+	fclose(org);
+	fclose(compProjectFused);
+
+	compProject = fopen("compProject", "rb");
+	compProjectFused = fopen("compProjectFused", "rb");
+
+	if ((compProject == NULL) || (compProjectFused == NULL))
+	{
+		perror("Opening input file");
+	}
+	diff(compProject, compProjectFused);
+	printf("\n");
+
+	fclose(compProject);
+	fclose(compProjectFused);
+
+/***************************************************************************
+*                    Encode a mapped file in memory
+***************************************************************************/
+
+	printf("Encode Mapped File To Project Format.....\n");
+
+	if (MapFileStage(EncodeProjectBuf, "org.txt", "compProjectMapped") != 0)
+	{
+		perror("Encoding mapped file");
+	}
+
+	compProject = fopen("compProject", "rb");
+	compProjectFused = fopen("compProjectMapped", "rb");
+
+	if ((compProject == NULL) || (compProjectFused == NULL))
+	{
+		perror("Opening input file");
+	}
+	diff(compProject, compProjectFused);
+	printf("\n");
+
+	fclose(compProject);
+	fclose(compProjectFused);
+
 /***************************************************************************
 *                         Cast back to lzss
 ***************************************************************************/
 	
 	
 	 
-	compProject = fopen("compProject", "rb"); 
+	compProject = fopen("compProject", "rb");
 	
 	if (compProject == NULL)
 	{
@@ -239,10 +311,283 @@ int main(int argc, char *argv[])
 	diff(org, decomp); 
 
 	
-	fclose(comp);
+	fclose(org);
+	fclose(decomp);
+
+	printf("\n");
+
+/***************************************************************************
+*                    Decode Project format directly
+***************************************************************************/
+
+	compProject = fopen("compProject", "rb");
+
+	if (compProject == NULL)
+	{
+		perror("Opening input file");
+	}
+
+	decomp = fopen("decompProject.txt", "wb");
+
+	if (decomp == NULL)
+	{
+		perror("Opening output file");
+	}
+	printf("Decoding Project Format.....\n");
+	DecodeProject(compProject, decomp);
+
+	fclose(compProject);
+	fclose(decomp);
+
+	org = fopen("org.txt", "rb");
+	decomp = fopen("decompProject.txt", "rb");
+
+	if ((org == NULL) || (decomp == NULL))
+	{
+		perror("Opening input file");
+	}
+	diff(org, decomp);
+	printf("\n");
+
+	fclose(org);
+	fclose(decomp);
+
+/***************************************************************************
+*                    All the stages at once, on threads
+***************************************************************************/
+
+	org = fopen("org.txt", "rb");
+
+	if (org == NULL)
+	{
+		perror("Opening input file");
+	}
+
+	decomp = fopen("decompPipeline.txt", "w+b");
+
+	if (decomp == NULL)
+	{
+		perror("Opening output file");
+	}
+	printf("Encoding, Casting and Decoding in a Pipeline.....\n");
+
+	if (RunPipeline(org, decomp, pipeline,
+		sizeof(pipeline) / sizeof(pipeline[0])) != 0)
+	{
+		perror("Running pipeline");
+	}
+
+	rewind(org);
+	rewind(decomp);
+	diff(org, decomp);
+	printf("\n");
+
+	fclose(org);
+	fclose(decomp);
+
+/***************************************************************************
+*                    Encode in independent blocks
+***************************************************************************/
+
+	org = fopen("org.txt", "rb");
+
+	if (org == NULL)
+	{
+		perror("Opening input file");
+	}
+
+	blocks = fopen("compBlocks", "wb");
+
+	if (blocks == NULL)
+	{
+		perror("Opening output file");
+	}
+	printf("Encoding Blocks.....\n");
+	EncodeBlocks(org, blocks, BLOCK_LZSS, BLOCK_DEFAULT_SIZE, 0);
+
+	fclose(org);
+	fclose(blocks);
+
+	blocks = fopen("compBlocks", "rb");
+
+	if (blocks == NULL)
+	{
+		perror("Opening input file");
+	}
+
+	decomp = fopen("decompBlocks.txt", "wb");
+
+	if (decomp == NULL)
+	{
+		perror("Opening output file");
+	}
+	printf("Verifying Blocks.....\n");
+	printf("%ld damaged blocks\n", VerifyBlocks(blocks, 0));
+	printf("Decoding Blocks.....\n");
+	DecodeBlocks(blocks, decomp, 0);
+
+	fclose(blocks);
 	fclose(decomp);
 
+	org = fopen("org.txt", "rb");
+	decomp = fopen("decompBlocks.txt", "rb");
+
+	if ((org == NULL) || (decomp == NULL))
+	{
+		perror("Opening input file");
+	}
+	diff(org, decomp);
 	printf("\n");
+
+	fclose(org);
+	fclose(decomp);
+
+/***************************************************************************
+*                    Blocks of a repeated string
+***************************************************************************/
+
+	org = tmpfile();
+	blocks = tmpfile();
+	decomp = tmpfile();
+
+	if ((org == NULL) || (blocks == NULL) || (decomp == NULL))
+	{
+		perror("Opening temporary files");
+	}
+
+	/* long repeats slide further than the project format holds */
+	for (i = 0; i < 200000; i++)
+	{
+		fputs("the quick brown fox ", org);
+	}
+
+	printf("Encoding and Decoding Slide Blocks of a Repeated String.....\n");
+	rewind(org);
+
+	if (EncodeBlocks(org, blocks, BLOCK_SLIDE, BLOCK_DEFAULT_SIZE, 0) != 0)
+	{
+		perror("Encoding blocks");
+	}
+
+	rewind(blocks);
+
+	if (DecodeBlocks(blocks, decomp, 0) != 0)
+	{
+		perror("Decoding blocks");
+	}
+
+	rewind(org);
+	rewind(decomp);
+	diff(org, decomp);
+
+	fclose(blocks);
+	blocks = tmpfile();
+
+	if (blocks == NULL)
+	{
+		perror("Opening temporary file");
+	}
+
+	printf("Encoding Project Blocks of a Repeated String.....\n");
+	rewind(org);
+
+	if ((EncodeBlocks(org, blocks, BLOCK_PROJECT, BLOCK_DEFAULT_SIZE,
+		0) != 0) && (errno == ENOTSUP))
+	{
+		printf("Refused, the project format can't hold it\n");
+	}
+	else
+	{
+		printf("Not refused !!\n");
+	}
+	printf("\n");
+
+	fclose(org);
+	fclose(blocks);
+	fclose(decomp);
+
+/***************************************************************************
+*                    Optimal parse of a text of tildes
+***************************************************************************/
+
+	/* pointers into the tildes before the text must not move before it */
+	printf("Optimal Parse of a Text of Tildes.....\n");
+
+	if ((EncodeProjectParseBuf((const unsigned char *)tildes, strlen(tildes),
+		PARSE_OPTIMAL, &parsed, &parsedSize) != 0) ||
+		(DecodeProjectBuf(parsed, parsedSize, &parsedBack,
+		&parsedBackSize) != 0))
+	{
+		perror("Parsing");
+	}
+	else
+	{
+		if ((parsedBackSize == strlen(tildes)) &&
+			(memcmp(parsedBack, tildes, parsedBackSize) == 0))
+		{
+			printf("The texts are the same\n");
+		}
+		else
+		{
+			printf("The texts are not the same !!\n");
+		}
+
+		free(parsed);
+		free(parsedBack);
+	}
+	printf("\n");
+
+/***************************************************************************
+*                    Random access with a checkpoint index
+***************************************************************************/
+
+	comp = fopen("comp.txt", "rb");
+
+	if (comp == NULL)
+	{
+		perror("Opening input file");
+	}
+
+	index = fopen("compIndex", "w+b");
+
+	if (index == NULL)
+	{
+		perror("Opening output file");
+	}
+	printf("Indexing.....\n");
+	IndexLZSS(comp, index, CHECKPOINT_DEFAULT_INTERVAL);
+
+	printf("Decoding %lu bytes at 1000000.....\n", (unsigned long)sizeof(range));
+	rangeLength = DecodeRange(comp, index, 1000000, range, sizeof(range));
+
+	if (rangeLength > 0)
+	{
+		fwrite(range, 1, (size_t)rangeLength, stdout);
+	}
+	printf("\n\n");
+
+	fclose(comp);
+	fclose(index);
+
+/***************************************************************************
+*                         Compressed Matching
+***************************************************************************/
+
+	if (argc > 1)
+	{
+		compProject = fopen("compProject", "rb");
+
+		if (compProject == NULL)
+		{
+			perror("Opening input file");
+		}
+		printf("Searching \"%s\".....\n", argv[1]);
+		printf("%ld occurrences\n", SearchCompressed(compProject,
+			(const unsigned char *)argv[1], strlen(argv[1])));
+
+		fclose(compProject);
+		printf("\n");
+	}
 	
 
 	return 0;
@@ -0,0 +1,510 @@
+/***************************************************************************
+*          LZSS Encoding and Decoding
+*
+*   File    : sarray.c
+*   Purpose : Implement suffix array matching of uncoded strings for LZSS
+*             algorithm.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*   Based on : Michael Dipperstein implementation Version 0.7
+*			   http://michael.dipperstein.com/lzss/
+*
+*
+****************************************************************************
+*
+* Sarray: Suffix array matching routines used by LZSS Encoding/Decoding
+*         Routine
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "lzlocal.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* number of ReplaceChar calls between rebuilds of the suffix array */
+#define REBUILD_INTERVAL    128
+
+/* strings of the window that do not contain windowHead */
+#define ARRAY_SIZE          (WINDOW_SIZE - MAX_CODED)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/***************************************************************************
+* suffixArray holds the window indices sorted by the MAX_CODED long string
+* starting at each of them, as it was when the array was built with
+* windowHead at builtHead.  builtWindow is a copy of the window at that time
+* for the binary search.  Since then, replaced characters were written from
+* builtHead on; the strings containing them are out of date, and FindMatch
+* compares them directly instead.
+***************************************************************************/
+struct search_data_t
+{
+    unsigned int suffixArray[ARRAY_SIZE];
+    unsigned int mergeArray[ARRAY_SIZE];
+    unsigned int addedArray[REBUILD_INTERVAL];
+    unsigned char builtWindow[WINDOW_SIZE];
+    unsigned int builtHead;
+    unsigned int replaced;
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int CompareSuffix(const unsigned char *window, const unsigned int j,
+    const unsigned int k);
+static void SortSuffixes(const unsigned char *window, unsigned int *array,
+    const unsigned int count, unsigned int *scratch);
+static void BuildArray(lzss_ctx_t *ctx, const unsigned int windowHead);
+static void UpdateArray(lzss_ctx_t *ctx, const unsigned int windowHead);
+static unsigned int MatchLength(const lzss_ctx_t *ctx,
+    const unsigned int charIndex, const unsigned int windowHead,
+    const unsigned int uncodedHead);
+static int IsOutOfDate(const search_data_t *sd, const unsigned int charIndex);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : CompareSuffix
+*   Description: This function compares the MAX_CODED long window strings
+*                starting at two window indices.
+*   Parameters : window - the sliding window
+*                j, k - the window indices
+*   Effects    : None
+*   Returned   : < 0, 0 or > 0 as the first string is less than, equal to
+*                or greater than the second one.
+****************************************************************************/
+static int CompareSuffix(const unsigned char *window, const unsigned int j,
+    const unsigned int k)
+{
+    unsigned int i, a, b;
+    int result;
+
+    a = j;
+    b = k;
+
+    for (i = 0; i < MAX_CODED; i++)
+    {
+        result = (int)window[a] - (int)window[b];
+
+        if (result != 0)
+        {
+            return result;
+        }
+
+        a = Wrap((a + 1), WINDOW_SIZE);
+        b = Wrap((b + 1), WINDOW_SIZE);
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : SortSuffixes
+*   Description: This function sorts window indices by the strings starting
+*                at them.  qsort can't pass the window of the context to
+*                the comparison, so a bottom up merge sort is used.  It is
+*                stable, so equal strings keep their order.
+*   Parameters : window - the sliding window
+*                array - the window indices to sort
+*                count - number of indices in array
+*                scratch - room for count indices
+*   Effects    : array is sorted.  scratch is overwritten.
+*   Returned   : None
+****************************************************************************/
+static void SortSuffixes(const unsigned char *window, unsigned int *array,
+    const unsigned int count, unsigned int *scratch)
+{
+    unsigned int *from, *to, *swap;
+    unsigned int width, start, middle, end, i, j, k;
+
+    from = array;
+    to = scratch;
+
+    for (width = 1; width < count; width *= 2)
+    {
+        for (start = 0; start < count; start += 2 * width)
+        {
+            middle = (start + width < count) ? (start + width) : count;
+            end = (middle + width < count) ? (middle + width) : count;
+
+            i = start;
+            j = middle;
+
+            for (k = start; k < end; k++)
+            {
+                if ((i < middle) && ((j == end) ||
+                    (CompareSuffix(window, from[i], from[j]) <= 0)))
+                {
+                    to[k] = from[i++];
+                }
+                else
+                {
+                    to[k] = from[j++];
+                }
+            }
+        }
+
+        swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != array)
+    {
+        memcpy(array, from, count * sizeof(unsigned int));
+    }
+}
+
+/****************************************************************************
+*   Function   : BuildArray
+*   Description: This function sorts the strings of the window that do not
+*                contain windowHead.
+*   Parameters : ctx - the codec context
+*                windowHead - head of sliding window
+*   Effects    : suffixArray is rebuilt and the replace count is reset.
+*   Returned   : None
+****************************************************************************/
+static void BuildArray(lzss_ctx_t *ctx, const unsigned int windowHead)
+{
+    search_data_t *sd = ctx->searchData;
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        sd->suffixArray[i] = Wrap((windowHead + 1 + i), WINDOW_SIZE);
+    }
+
+    SortSuffixes(ctx->slidingWindow, sd->suffixArray, ARRAY_SIZE,
+        sd->mergeArray);
+
+    memcpy(sd->builtWindow, ctx->slidingWindow, WINDOW_SIZE);
+    sd->builtHead = windowHead;
+    sd->replaced = 0;
+}
+
+/****************************************************************************
+*   Function   : UpdateArray
+*   Description: This function brings the suffix array up to date without
+*                sorting it all again.  The strings that are still up to
+*                date keep their order.  The replaced strings that no longer
+*                contain windowHead are sorted and merged in.
+*   Parameters : ctx - the codec context
+*                windowHead - head of sliding window
+*   Effects    : suffixArray is rebuilt and the replace count is reset.
+*   Returned   : None
+****************************************************************************/
+static void UpdateArray(lzss_ctx_t *ctx, const unsigned int windowHead)
+{
+    search_data_t *sd = ctx->searchData;
+    unsigned int i, j, k, first;
+
+    /* strings from the first one that contained builtHead */
+    first = Wrap((sd->builtHead + WINDOW_SIZE - (MAX_CODED - 1)),
+        WINDOW_SIZE);
+
+    for (i = 0; i < sd->replaced; i++)
+    {
+        sd->addedArray[i] = Wrap((first + i), WINDOW_SIZE);
+    }
+
+    SortSuffixes(ctx->slidingWindow, sd->addedArray, sd->replaced,
+        sd->mergeArray);
+
+    i = 0;
+    j = 0;
+
+    for (k = 0; k < ARRAY_SIZE; k++)
+    {
+        while ((i < ARRAY_SIZE) && IsOutOfDate(sd, sd->suffixArray[i]))
+        {
+            i++;
+        }
+
+        if ((j < sd->replaced) && ((i == ARRAY_SIZE) ||
+            (CompareSuffix(ctx->slidingWindow, sd->addedArray[j],
+            sd->suffixArray[i]) < 0)))
+        {
+            sd->mergeArray[k] = sd->addedArray[j];
+            j++;
+        }
+        else
+        {
+            sd->mergeArray[k] = sd->suffixArray[i];
+            i++;
+        }
+    }
+
+    memcpy(sd->suffixArray, sd->mergeArray, sizeof(sd->suffixArray));
+    memcpy(sd->builtWindow, ctx->slidingWindow, WINDOW_SIZE);
+    sd->builtHead = windowHead;
+    sd->replaced = 0;
+}
+
+/****************************************************************************
+*   Function   : IsOutOfDate
+*   Description: This function tells whether the string starting at
+*                charIndex changed since the suffix array was built, or is
+*                the current windowHead.
+*   Parameters : sd - the suffix array
+*                charIndex - sliding window index of the string
+*   Effects    : None
+*   Returned   : Non-zero if the string must not be taken from the array.
+****************************************************************************/
+static int IsOutOfDate(const search_data_t *sd, const unsigned int charIndex)
+{
+    unsigned int distance;
+
+    /* distance from the first string that contains builtHead */
+    distance = Wrap((charIndex + WINDOW_SIZE - (sd->builtHead + WINDOW_SIZE -
+        (MAX_CODED - 1)) % WINDOW_SIZE), WINDOW_SIZE);
+
+    return (distance <= sd->replaced + MAX_CODED - 1);
+}
+
+/****************************************************************************
+*   Function   : MatchLength
+*   Description: This function compares the string starting at charIndex
+*                with the uncoded lookahead, stopping before windowHead (no
+*                self-reference).
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the string
+*                windowHead - head of sliding window
+*                uncodedHead - head of uncoded lookahead buffer
+*   Effects    : None
+*   Returned   : The number of matching characters.
+****************************************************************************/
+static unsigned int MatchLength(const lzss_ctx_t *ctx,
+    const unsigned int charIndex, const unsigned int windowHead,
+    const unsigned int uncodedHead)
+{
+    const unsigned char *slidingWindow = ctx->slidingWindow;
+    const unsigned char *uncodedLookahead = ctx->uncodedLookahead;
+    unsigned int j, k;
+
+    j = 0;
+    k = charIndex;
+
+    while ((j < MAX_CODED) && (k != windowHead) && (slidingWindow[k] ==
+        uncodedLookahead[Wrap((uncodedHead + j), MAX_CODED)]))
+    {
+        j++;
+        k = Wrap((k + 1), WINDOW_SIZE);
+    }
+
+    return j;
+}
+
+/****************************************************************************
+*   Function   : InitializeSearchStructures
+*   Description: This function builds the suffix array of the pre-filled
+*                sliding window (windowHead is 0 at the start of encoding).
+*   Parameters : ctx - the codec context
+*   Effects    : The suffix array is allocated and built.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int InitializeSearchStructures(lzss_ctx_t *ctx)
+{
+    ctx->searchData = (search_data_t *)malloc(sizeof(search_data_t));
+
+    if (ctx->searchData == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    BuildArray(ctx, 0);
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : FreeSearchStructures
+*   Description: This function frees the suffix array.
+*   Parameters : ctx - the codec context
+*   Effects    : The suffix array is freed.
+*   Returned   : None
+****************************************************************************/
+void FreeSearchStructures(lzss_ctx_t *ctx)
+{
+    free(ctx->searchData);
+    ctx->searchData = NULL;
+}
+
+/****************************************************************************
+*   Function   : FindMatch
+*   Description: This function will search through the slidingWindow
+*                dictionary for the longest sequence matching the MAX_CODED
+*                long string stored in uncodedLookahed.  A binary search in
+*                the copy of the window the suffix array was sorted by finds
+*                where the lookahead belongs in the suffix array; the
+*                longest match among the strings that are still up to date
+*                is the nearest one on either side.  The strings that
+*                changed since the array was built are compared directly.
+*   Parameters : ctx - the codec context
+*                windowHead - head of sliding window
+*                uncodedHead - head of uncoded lookahead buffer
+*   Effects    : None
+*   Returned   : The sliding window index where the match starts and the
+*                length of the match.  If there is no match a length of
+*                zero will be returned.
+****************************************************************************/
+encoded_string_t FindMatch(lzss_ctx_t *ctx, const unsigned int windowHead,
+    unsigned int uncodedHead)
+{
+    const unsigned char *uncodedLookahead = ctx->uncodedLookahead;
+    const search_data_t *sd = ctx->searchData;
+    encoded_string_t matchData;
+    unsigned int low, high, middle, i, j, k, length;
+    int result;
+
+    matchData.length = 0;
+    matchData.offset = 0;
+
+    /* find the first string that is not less than the lookahead */
+    low = 0;
+    high = ARRAY_SIZE;
+
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        j = sd->suffixArray[middle];
+        k = uncodedHead;
+        result = 0;
+
+        for (i = 0; i < MAX_CODED; i++)
+        {
+            result = (int)sd->builtWindow[j] - (int)uncodedLookahead[k];
+
+            if (result != 0)
+            {
+                break;
+            }
+
+            j = Wrap((j + 1), WINDOW_SIZE);
+            k = Wrap((k + 1), MAX_CODED);
+        }
+
+        if (result < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    /* nearest up to date string at or after the insertion point */
+    for (i = low; i < ARRAY_SIZE; i++)
+    {
+        if (!IsOutOfDate(sd, sd->suffixArray[i]))
+        {
+            length = MatchLength(ctx, sd->suffixArray[i], windowHead,
+                uncodedHead);
+            if (length > matchData.length)
+            {
+                matchData.length = length;
+                matchData.offset = sd->suffixArray[i];
+            }
+            break;
+        }
+    }
+
+    /* nearest up to date string before the insertion point */
+    for (i = low; i > 0; i--)
+    {
+        if (!IsOutOfDate(sd, sd->suffixArray[i - 1]))
+        {
+            length = MatchLength(ctx, sd->suffixArray[i - 1], windowHead,
+                uncodedHead);
+            if (length > matchData.length)
+            {
+                matchData.length = length;
+                matchData.offset = sd->suffixArray[i - 1];
+            }
+            break;
+        }
+    }
+
+    if (matchData.length >= MAX_CODED)
+    {
+        return matchData;
+    }
+
+    /* strings that changed since the array was built */
+    i = Wrap((sd->builtHead + WINDOW_SIZE - (MAX_CODED - 1)), WINDOW_SIZE);
+
+    while (i != windowHead)
+    {
+        length = MatchLength(ctx, i, windowHead, uncodedHead);
+
+        if (length > matchData.length)
+        {
+            matchData.length = length;
+            matchData.offset = i;
+
+            if (length >= MAX_CODED)
+            {
+                break;
+            }
+        }
+
+        i = Wrap((i + 1), WINDOW_SIZE);
+    }
+
+    return matchData;
+}
+
+/****************************************************************************
+*   Function   : ReplaceChar
+*   Description: This function replaces the character stored in
+*                slidingWindow[charIndex] with the one specified by
+*                replacement.  Every REBUILD_INTERVAL calls the suffix array
+*                is brought up to date.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the character to be
+*                            replaced (windowHead).
+*   Effects    : slidingWindow[charIndex] is replaced by replacement.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int ReplaceChar(lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned char replacement)
+{
+    ctx->slidingWindow[charIndex] = replacement;
+    ctx->searchData->replaced++;
+
+    if (ctx->searchData->replaced >= REBUILD_INTERVAL)
+    {
+        UpdateArray(ctx, Wrap((charIndex + 1), WINDOW_SIZE));
+    }
+
+    return 0;
+}
@@ -0,0 +1,1461 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : search.c
+*   Purpose : Pattern matching directly on a file in the project format
+*             (the output of CastEncodeLZSS), without decoding it, for one
+*             pattern (KMP or Horspool) or many (Aho-Corasick).
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*   Based on : S. T. Klein and D. Shapira, "A New Compression Method for
+*              Compressed Matching", DCC 2000 (see Article.pdf)
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "lzss.h"
+#include "lzlocal.h"
+#include "bitfile.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* a pointer read at position pos writes at most up to pos + 2 * WINDOW_SIZE
+ * and reads at most MAX_CODED characters back, so this ring never wraps
+ * onto a slot that is still in use */
+#define SCAN_RING_SIZE  (2 * BUFFER_SIZE)
+#define SCAN_RING_MASK  (SCAN_RING_SIZE - 1)
+
+#define NO_CLASS        (-1)    /* character class of a non pattern char */
+#define NO_STATE        (-1)    /* no state or no pattern */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/***************************************************************************
+* Project format items as they are read from the compressed file.  Pairs
+* are returned as triples with slide = 0.
+***************************************************************************/
+typedef enum
+{
+	TOKEN_EOF,
+	TOKEN_CHAR,
+	TOKEN_POINTER
+} token_kind_t;
+
+/***************************************************************************
+* The items of the compressed file, read TOKEN_CHUNK at a time by
+* UnpackProject.  next is the next item of tokens, and end is set once
+* UnpackProject reached the end of the file.
+***************************************************************************/
+typedef struct token_reader_t
+{
+	bit_file_t *bfpIn;
+	token_buffer_t tokens;
+	size_t next;
+	int end;
+} token_reader_t;
+
+/***************************************************************************
+* The buffer of the compressed matching algorithm.  Only the characters of
+* the pattern are kept (sym); every other character of the text is known to
+* be irrelevant and is never stored.  symPos holds the text position that
+* the slot currently describes, so stale slots need no clearing.
+* cover is the length of a pointer target starting at the slot, coverRel
+* tells if any character of the pattern was copied into it and coverSrc is
+* where it was copied from.
+***************************************************************************/
+typedef struct scan_t
+{
+	short sym[SCAN_RING_SIZE];
+	long long symPos[SCAN_RING_SIZE];
+	unsigned char cover[SCAN_RING_SIZE];
+	unsigned char coverRel[SCAN_RING_SIZE];
+	long long coverSrc[SCAN_RING_SIZE];
+	unsigned char inPattern[UCHAR_MAX + 1];
+	long long current;          /* position of the next character */
+	long long relevant;         /* last position holding a pattern char */
+} scan_t;
+
+/***************************************************************************
+* KMP state for a single pattern.  nextPos is the position the automaton
+* expects next; a gap means irrelevant characters were skipped.
+***************************************************************************/
+typedef struct kmp_t
+{
+	const unsigned char *pattern;
+	size_t m;
+	size_t *failure;
+	size_t q;
+	long long nextPos;
+	long count;
+	match_func_t matchFunc;
+	void *userData;
+	unsigned char *head;        /* see search_edge_t, NULL if not needed */
+	size_t headLength;
+} kmp_t;
+
+/***************************************************************************
+* Horspool state for a single pattern.  end is the text position the last
+* character of the pattern is lined up with next.  shift is the bad
+* character table, m for a character that is not in the pattern.
+***************************************************************************/
+typedef struct horspool_t
+{
+	const unsigned char *pattern;
+	size_t m;
+	size_t shift[UCHAR_MAX + 1];
+	long long end;
+	long count;
+	match_func_t matchFunc;
+	void *userData;
+} horspool_t;
+
+/***************************************************************************
+* Aho-Corasick automaton for several patterns.  The characters of the
+* patterns are numbered 0 to classes - 1 (cls, NO_CLASS for the others) and
+* delta is the complete transition table, classes entries per state, with
+* state 0 the root.  out is the first pattern that ends at a state (next
+* links the patterns that are the same) and dict the closest state on the
+* failure path where a pattern ends.  state keeps the state the automaton
+* was in after every position still in the buffer, so a pointer target can
+* take the states of its source.
+***************************************************************************/
+typedef struct ac_t
+{
+	int *delta;
+	int *dict;
+	int *out;
+	int *next;
+	const size_t *lengths;
+	unsigned int classes;
+	short cls[UCHAR_MAX + 1];
+	int q;
+	long long nextPos;
+	long count;
+	multi_match_func_t matchFunc;
+	void *userData;
+	int state[SCAN_RING_SIZE];
+	long long statePos[SCAN_RING_SIZE];
+} ac_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static long SearchBits(bit_file_t *bfpIn, const unsigned char *pattern,
+	size_t m, match_func_t matchFunc, void *userData, int skip,
+	search_edge_t *edge);
+static token_kind_t ReadToken(token_reader_t *reader, int *ch,
+	encoded_string_t *code);
+static void ScanInit(scan_t *scan, const unsigned char *pattern, size_t m);
+static int ScanLiteral(scan_t *scan, int c);
+static void ScanPointer(scan_t *scan, const encoded_string_t *code);
+static void ScanFlush(scan_t *scan, kmp_t *kmp);
+static int KmpInit(kmp_t *kmp, const unsigned char *pattern, size_t m,
+	match_func_t matchFunc, void *userData);
+static void KmpFeed(kmp_t *kmp, long long pos, int c);
+static void HorspoolInit(horspool_t *hp, const unsigned char *pattern,
+	size_t m, match_func_t matchFunc, void *userData);
+static void HorspoolAdvance(horspool_t *hp, const scan_t *scan);
+static int ScanAt(const scan_t *scan, long long pos);
+static long SearchMultiBits(bit_file_t *bfpIn, ac_t *ac);
+static int AcInit(ac_t *ac, const unsigned char *const *patterns,
+	const size_t *lengths, unsigned int count);
+static void AcFree(ac_t *ac);
+static void AcFeed(ac_t *ac, long long pos, int c);
+static void AcCopy(ac_t *ac, const scan_t *scan, long long dst, long long src,
+	unsigned int length);
+static void AcFlush(scan_t *scan, ac_t *ac);
+static int AcStateAt(const ac_t *ac, long long pos, int *q);
+static void AcReport(ac_t *ac, long long pos);
+static void PrintMatch(unsigned long long offset, void *userData);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : SearchCompressed
+*   Description: This function finds every occurrence of a pattern in a file
+*				 encoded according to the project format, and prints the
+*				 offset of each occurrence in the original text.
+*   Parameters : compProject - pointer to the project encoded file
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*   Effects    : compProject is read to its end.  It is not closed.
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+long SearchCompressed(FILE *compProject, const unsigned char *pattern,
+	size_t m)
+{
+	return SearchCompressedEx(compProject, pattern, m, PrintMatch, NULL);
+}
+
+/****************************************************************************
+*   Function   : SearchCompressedEx
+*   Description: This function implements the compressed matching algorithm
+*				 of the article.  The items of the project file are read in
+*				 order.  A character is stored only if it appears in the
+*				 pattern.  A pointer copies the pattern characters among the
+*				 last length characters (moved by slide) to their place
+*				 offset characters ahead, so the characters it refers to
+*				 are never expanded.  Stored characters are passed to a KMP
+*				 automaton in text order; skipped positions reset it.
+*   Parameters : compProject - pointer to the project encoded file
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence
+*                userData - passed to matchFunc
+*   Effects    : compProject is read to its end.  It is not closed.
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+long SearchCompressedEx(FILE *compProject, const unsigned char *pattern,
+	size_t m, match_func_t matchFunc, void *userData)
+{
+	bit_file_t *bfpIn;
+	long count;
+
+	if ((NULL == compProject) || (NULL == pattern) || (NULL == matchFunc))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	/* convert input file to bitfile */
+	bfpIn = MakeBitFile(compProject, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		perror("Making Input File a BitFile");
+		return -1;
+	}
+
+	count = SearchBits(bfpIn, pattern, m, matchFunc, userData, 0, NULL);
+
+	BitFileToFILE(bfpIn);
+
+	return count;
+}
+
+/****************************************************************************
+*   Function   : SearchCompressedHorspool
+*   Description: This function finds every occurrence of a pattern in a file
+*				 encoded according to the project format like
+*				 SearchCompressedEx, but lines the pattern up with the text
+*				 the way Horspool's algorithm does instead of passing every
+*				 pattern character to a KMP automaton.  Pointer targets are
+*				 passed over by their length, and only the characters an
+*				 alignment looks at are examined, so the longer the pattern
+*				 the fewer characters are looked at.
+*   Parameters : compProject - pointer to the project encoded file
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence
+*                userData - passed to matchFunc
+*   Effects    : compProject is read to its end.  It is not closed.
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+long SearchCompressedHorspool(FILE *compProject, const unsigned char *pattern,
+	size_t m, match_func_t matchFunc, void *userData)
+{
+	bit_file_t *bfpIn;
+	long count;
+
+	if ((NULL == compProject) || (NULL == pattern) || (NULL == matchFunc))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	/* convert input file to bitfile */
+	bfpIn = MakeBitFile(compProject, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		perror("Making Input File a BitFile");
+		return -1;
+	}
+
+	count = SearchBits(bfpIn, pattern, m, matchFunc, userData, 1, NULL);
+
+	BitFileToFILE(bfpIn);
+
+	return count;
+}
+
+/****************************************************************************
+*   Function   : SearchCompressedMulti
+*   Description: This function finds every occurrence of several patterns
+*				 in a file encoded according to the project format in a
+*				 single pass.  The buffer of the article keeps the
+*				 characters of any of the patterns, and the stored
+*				 characters are passed to an Aho-Corasick automaton.  Once
+*				 the automaton is in the same state in a pointer target as
+*				 it was in its source, it takes the states of the source
+*				 for the rest of the target instead of computing them.
+*   Parameters : compProject - pointer to the project encoded file
+*                patterns - the patterns to look for
+*                lengths - lengths of the patterns, none of them 0
+*                count - number of patterns
+*                matchFunc - called with the index of the pattern and the
+*                            offset of every occurrence
+*                userData - passed to matchFunc
+*   Effects    : compProject is read to its end.  It is not closed.
+*   Returned   : The number of occurrences of all the patterns, -1 for
+*                failure.  errno will be set in the event of a failure.
+****************************************************************************/
+long SearchCompressedMulti(FILE *compProject,
+	const unsigned char *const *patterns, const size_t *lengths,
+	unsigned int count, multi_match_func_t matchFunc, void *userData)
+{
+	bit_file_t *bfpIn;
+	ac_t *ac;
+	long found;
+
+	if ((NULL == compProject) || (NULL == patterns) || (NULL == lengths) ||
+		(NULL == matchFunc))
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	ac = (ac_t *)malloc(sizeof(ac_t));
+
+	if (NULL == ac)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (AcInit(ac, patterns, lengths, count) != 0)
+	{
+		free(ac);
+		return -1;
+	}
+
+	ac->matchFunc = matchFunc;
+	ac->userData = userData;
+
+	/* convert input file to bitfile */
+	bfpIn = MakeBitFile(compProject, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		perror("Making Input File a BitFile");
+		AcFree(ac);
+		free(ac);
+		return -1;
+	}
+
+	found = SearchMultiBits(bfpIn, ac);
+
+	BitFileToFILE(bfpIn);
+	AcFree(ac);
+	free(ac);
+
+	return found;
+}
+
+/****************************************************************************
+*   Function   : SearchSegment
+*   Description: This function finds every occurrence of a pattern in a
+*				 segment of a text, encoded according to the project format
+*				 in memory, and tells what is needed to find the
+*				 occurrences that cross into the next segments.
+*   Parameters : in - the project encoded segment
+*                inSize - number of bytes in the segment
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence in
+*                            the segment
+*                userData - passed to matchFunc
+*                edge - set to the ends of the segment.  edge->head has to
+*                       have room for m - 1 characters.
+*   Effects    : None
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+long SearchSegment(const unsigned char *in, size_t inSize,
+	const unsigned char *pattern, size_t m, match_func_t matchFunc,
+	void *userData, search_edge_t *edge)
+{
+	bit_file_t *bfpIn;
+	unsigned char *unused;
+	size_t unusedSize;
+	long count;
+
+	if (((NULL == in) && (inSize != 0)) || (NULL == pattern) ||
+		(NULL == matchFunc) || (NULL == edge))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	bfpIn = MakeMemoryBitFile(in, inSize, BF_READ);
+
+	if (NULL == bfpIn)
+	{
+		return -1;
+	}
+
+	count = SearchBits(bfpIn, pattern, m, matchFunc, userData, 0, edge);
+
+	unused = BitFileToMemory(bfpIn, &unusedSize);
+	(void)unused;
+
+	return count;
+}
+
+/****************************************************************************
+*   Function   : SearchStitch
+*   Description: This function finds the occurrences of a pattern that end
+*				 in the head of a segment and start before it.  The KMP
+*				 automaton is started in the state it had at the end of the
+*				 text before the segment, and the characters of the head are
+*				 passed to it.  They are fewer than m, so every occurrence
+*				 found starts before the segment.
+*   Parameters : pattern - the pattern to look for
+*                m - length of the pattern
+*                state - state of the automaton before the segment
+*                edge - the ends of the segment, set by SearchSegment
+*                start - offset of the segment in the text
+*                matchFunc - called with the offset of every occurrence
+*                userData - passed to matchFunc
+*                count - the number of occurrences found is added to it
+*   Effects    : None
+*   Returned   : The state of the automaton after the segment, -1 for
+*                failure.  errno will be set in the event of a failure.
+****************************************************************************/
+long SearchStitch(const unsigned char *pattern, size_t m, size_t state,
+	const search_edge_t *edge, unsigned long long start,
+	match_func_t matchFunc, void *userData, long *count)
+{
+	kmp_t kmp;
+	size_t i;
+
+	if (KmpInit(&kmp, pattern, m, matchFunc, userData) != 0)
+	{
+		return -1;
+	}
+
+	kmp.q = state;
+	kmp.nextPos = (long long)start;
+
+	for (i = 0; i < edge->headLength; i++)
+	{
+		KmpFeed(&kmp, (long long)(start + i), edge->head[i]);
+	}
+
+	free(kmp.failure);
+	*count += kmp.count;
+
+	/* a segment that is all head leaves the state of the automaton fed */
+	if ((unsigned long long)edge->headLength == edge->length)
+	{
+		return (long)kmp.q;
+	}
+
+	return (long)edge->state;
+}
+
+/****************************************************************************
+*   Function   : SearchBits
+*   Description: This function implements the compressed matching algorithm
+*				 of the article for SearchCompressedEx, SearchSegment and
+*				 SearchCompressedHorspool.
+*   Parameters : bfpIn - the project encoded bit file
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence
+*                userData - passed to matchFunc
+*                skip - non-zero to match with Horspool's algorithm.  The
+*                       last m characters have to still be in the buffer,
+*                       so KMP is used for patterns over WINDOW_SIZE.
+*                edge - set to the ends of the text, or NULL.  Only KMP
+*                       sets it.
+*   Effects    : bfpIn is read to its end.
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+static long SearchBits(bit_file_t *bfpIn, const unsigned char *pattern,
+	size_t m, match_func_t matchFunc, void *userData, int skip,
+	search_edge_t *edge)
+{
+	scan_t *scan;
+	kmp_t kmp;
+	horspool_t hp;
+	kmp_t *feed;
+	token_reader_t reader;
+	encoded_string_t code;
+	token_kind_t kind;
+	int c;
+
+	if (0 == m)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	scan = (scan_t *)malloc(sizeof(scan_t));
+
+	if ((NULL == scan) ||
+		(KmpInit(&kmp, pattern, m, matchFunc, userData) != 0))
+	{
+		free(scan);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (TokensInit(&reader.tokens) != 0)
+	{
+		free(scan);
+		free(kmp.failure);
+		return -1;
+	}
+
+	reader.bfpIn = bfpIn;
+	reader.next = 0;
+	reader.end = 0;
+
+	if (edge != NULL)
+	{
+		kmp.head = edge->head;
+	}
+
+	/* with Horspool's algorithm the characters are not fed to KMP */
+	skip = skip && (m <= WINDOW_SIZE) && (NULL == edge);
+	feed = skip ? NULL : &kmp;
+	HorspoolInit(&hp, pattern, m, matchFunc, userData);
+
+	ScanInit(scan, pattern, m);
+
+	/************************************************************************
+	* pass over the compressed file
+	************************************************************************/
+	while ((kind = ReadToken(&reader, &c, &code)) != TOKEN_EOF)
+	{
+		if (kind == TOKEN_POINTER)
+		{
+			ScanPointer(scan, &code);
+			continue;
+		}
+
+		/* pointer targets that end at the current position come first */
+		ScanFlush(scan, feed);
+
+		if (ScanLiteral(scan, c) && !skip)
+		{
+			KmpFeed(&kmp, scan->current, c);
+		}
+
+		scan->current++;
+
+		if (skip)
+		{
+			HorspoolAdvance(&hp, scan);
+		}
+	}
+
+	/* the remaining pointers point past the last character */
+	ScanFlush(scan, feed);
+
+	if (skip)
+	{
+		HorspoolAdvance(&hp, scan);
+	}
+
+	if (edge != NULL)
+	{
+		/* the state only holds if the last character was a pattern one */
+		edge->headLength = kmp.headLength;
+		edge->state = (kmp.nextPos == scan->current) ? kmp.q : 0;
+		edge->length = (unsigned long long)scan->current;
+	}
+
+	TokensFree(&reader.tokens);
+	free(scan);
+	free(kmp.failure);
+
+	return skip ? hp.count : kmp.count;
+}
+
+/****************************************************************************
+*   Function   : SearchMultiBits
+*   Description: This function implements the compressed matching algorithm
+*				 of the article for SearchCompressedMulti.
+*   Parameters : bfpIn - the project encoded bit file
+*                ac - the automaton of the patterns
+*   Effects    : bfpIn is read to its end.
+*   Returned   : The number of occurrences, -1 for failure.  errno will be
+*                set in the event of a failure.
+****************************************************************************/
+static long SearchMultiBits(bit_file_t *bfpIn, ac_t *ac)
+{
+	scan_t *scan;
+	token_reader_t reader;
+	encoded_string_t code;
+	token_kind_t kind;
+	int c;
+
+	scan = (scan_t *)malloc(sizeof(scan_t));
+
+	if (NULL == scan)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (TokensInit(&reader.tokens) != 0)
+	{
+		free(scan);
+		return -1;
+	}
+
+	reader.bfpIn = bfpIn;
+	reader.next = 0;
+	reader.end = 0;
+
+	/* the characters of all the patterns are kept */
+	ScanInit(scan, NULL, 0);
+
+	for (c = 0; c <= UCHAR_MAX; c++)
+	{
+		scan->inPattern[c] = (ac->cls[c] != NO_CLASS);
+	}
+
+	/************************************************************************
+	* pass over the compressed file
+	************************************************************************/
+	while ((kind = ReadToken(&reader, &c, &code)) != TOKEN_EOF)
+	{
+		if (kind == TOKEN_POINTER)
+		{
+			ScanPointer(scan, &code);
+			continue;
+		}
+
+		/* pointer targets that end at the current position come first */
+		AcFlush(scan, ac);
+
+		if (ScanLiteral(scan, c))
+		{
+			AcFeed(ac, scan->current, c);
+		}
+
+		scan->current++;
+	}
+
+	/* the remaining pointers point past the last character */
+	AcFlush(scan, ac);
+
+	TokensFree(&reader.tokens);
+	free(scan);
+
+	return ac->count;
+}
+
+/****************************************************************************
+*   Function   : ReadToken
+*   Description: This function returns the next item of a project encoded
+*				 file, reading the next chunk of items when the ones read
+*				 are used up.
+*   Parameters : reader - the items of the project encoded bit file
+*                ch - set to the character of an uncoded item
+*                code - set to the offset, length and slide of a pointer
+*   Effects    : The item is consumed from reader.
+*   Returned   : The kind of the item, TOKEN_EOF at the end of the file.
+****************************************************************************/
+static token_kind_t ReadToken(token_reader_t *reader, int *ch,
+	encoded_string_t *code)
+{
+	token_buffer_t *tokens = &reader->tokens;
+	size_t i;
+
+	if (reader->next == tokens->count)
+	{
+		if (reader->end)
+		{
+			return TOKEN_EOF;
+		}
+
+		tokens->count = 0;
+		reader->next = 0;
+		reader->end = (UnpackProject(reader->bfpIn, tokens) == EOF);
+
+		if (0 == tokens->count)
+		{
+			return TOKEN_EOF;
+		}
+	}
+
+	i = reader->next++;
+
+	if (tokens->kind[i] == UNCODED)
+	{
+		*ch = tokens->offset[i];
+		return TOKEN_CHAR;
+	}
+
+	code->offset = tokens->offset[i];
+	code->length = tokens->length[i];
+	code->slide = tokens->slide[i];
+
+	return TOKEN_POINTER;
+}
+
+/****************************************************************************
+*   Function   : ScanInit
+*   Description: This function empties the buffer of the compressed
+*				 matching algorithm and marks the characters of the pattern.
+*   Parameters : scan - the buffer
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*   Effects    : scan is initialized
+*   Returned   : None
+****************************************************************************/
+static void ScanInit(scan_t *scan, const unsigned char *pattern, size_t m)
+{
+	size_t i;
+
+	memset(scan->cover, 0, sizeof(scan->cover));
+	memset(scan->coverRel, 0, sizeof(scan->coverRel));
+	memset(scan->inPattern, 0, sizeof(scan->inPattern));
+	for (i = 0; i < SCAN_RING_SIZE; i++)
+	{
+		scan->symPos[i] = -1;
+	}
+
+	for (i = 0; i < m; i++)
+	{
+		scan->inPattern[pattern[i]] = 1;
+	}
+
+	scan->current = 0;
+	scan->relevant = -1;
+}
+
+/****************************************************************************
+*   Function   : ScanLiteral
+*   Description: This function stores an uncoded character of the text at
+*				 the current position if it is a pattern character.
+*   Parameters : scan - the buffer
+*                c - the character
+*   Effects    : c is stored in scan
+*   Returned   : 1 if c was stored, 0 if it is not in the pattern
+****************************************************************************/
+static int ScanLiteral(scan_t *scan, int c)
+{
+	unsigned int slot;
+
+	if (!scan->inPattern[c])
+	{
+		return 0;
+	}
+
+	slot = (unsigned int)(scan->current & SCAN_RING_MASK);
+	scan->sym[slot] = (short)c;
+	scan->symPos[slot] = scan->current;
+	if (scan->current > scan->relevant)
+	{
+		scan->relevant = scan->current;
+	}
+
+	return 1;
+}
+
+/****************************************************************************
+*   Function   : ScanPointer
+*   Description: This function handles a pointer (copyrelevantchar in the
+*				 article).  Only the pattern characters among the length
+*				 characters preceding current + slide are copied, offset
+*				 characters ahead.  The characters before the start of the
+*				 text are the '~' that EncodeLZSS fills its window with.
+*   Parameters : scan - the buffer
+*                code - offset, length and slide of the pointer
+*   Effects    : The target of the pointer is registered in scan
+*   Returned   : None
+****************************************************************************/
+static void ScanPointer(scan_t *scan, const encoded_string_t *code)
+{
+	long long src, dst, pos;
+	unsigned int i, slot, rel;
+	short c;
+
+	src = scan->current + code->slide - code->length;
+	dst = scan->current + code->slide + code->offset;
+	rel = 0;
+
+	if (scan->relevant >= src || (src < 0 && scan->inPattern['~']))
+	{
+		for (i = 0; i < code->length; i++)
+		{
+			pos = src + i;
+
+			if (pos < 0)
+			{
+				if (!scan->inPattern['~'])
+				{
+					continue;
+				}
+				c = '~';
+			}
+			else
+			{
+				slot = (unsigned int)(pos & SCAN_RING_MASK);
+				if (scan->symPos[slot] != pos)
+				{
+					continue;
+				}
+				c = scan->sym[slot];
+			}
+
+			/* a pattern character, copy it to the target */
+			slot = (unsigned int)((dst + i) & SCAN_RING_MASK);
+			scan->sym[slot] = c;
+			scan->symPos[slot] = dst + i;
+			rel = 1;
+		}
+
+		if (rel && (dst + code->length - 1 > scan->relevant))
+		{
+			scan->relevant = dst + code->length - 1;
+		}
+	}
+
+	slot = (unsigned int)(dst & SCAN_RING_MASK);
+	scan->cover[slot] = (unsigned char)code->length;
+	scan->coverRel[slot] = (unsigned char)rel;
+	scan->coverSrc[slot] = src;
+}
+
+/****************************************************************************
+*   Function   : ScanFlush
+*   Description: This function passes over the pointer targets that start at
+*				 the current position.  A target without pattern characters
+*				 is skipped at once.
+*   Parameters : scan - the buffer
+*                kmp - the automaton the stored characters are passed to,
+*                      NULL to skip every target at once
+*   Effects    : scan->current is moved past the targets
+*   Returned   : None
+****************************************************************************/
+static void ScanFlush(scan_t *scan, kmp_t *kmp)
+{
+	unsigned int slot, length, i;
+
+	slot = (unsigned int)(scan->current & SCAN_RING_MASK);
+
+	while ((length = scan->cover[slot]) != 0)
+	{
+		scan->cover[slot] = 0;
+
+		if (scan->coverRel[slot] && (kmp != NULL))
+		{
+			for (i = 0; i < length; i++)
+			{
+				slot = (unsigned int)((scan->current + i) & SCAN_RING_MASK);
+				if (scan->symPos[slot] == scan->current + i)
+				{
+					KmpFeed(kmp, scan->current + i, scan->sym[slot]);
+				}
+			}
+		}
+
+		scan->current += length;
+		slot = (unsigned int)(scan->current & SCAN_RING_MASK);
+	}
+}
+
+/****************************************************************************
+*   Function   : KmpInit
+*   Description: This function computes the KMP failure function of the
+*				 pattern and starts the automaton in its first state.
+*   Parameters : kmp - the automaton
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence
+*                userData - passed to matchFunc
+*   Effects    : kmp is initialized.  kmp->failure has to be freed.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int KmpInit(kmp_t *kmp, const unsigned char *pattern, size_t m,
+	match_func_t matchFunc, void *userData)
+{
+	size_t i, k;
+
+	kmp->failure = (size_t *)malloc(m * sizeof(size_t));
+
+	if (NULL == kmp->failure)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	kmp->failure[0] = 0;
+	k = 0;
+	for (i = 1; i < m; i++)
+	{
+		while (k > 0 && pattern[i] != pattern[k])
+		{
+			k = kmp->failure[k - 1];
+		}
+		if (pattern[i] == pattern[k])
+		{
+			k++;
+		}
+		kmp->failure[i] = k;
+	}
+
+	kmp->pattern = pattern;
+	kmp->m = m;
+	kmp->q = 0;
+	kmp->nextPos = 0;
+	kmp->count = 0;
+	kmp->matchFunc = matchFunc;
+	kmp->userData = userData;
+	kmp->head = NULL;
+	kmp->headLength = 0;
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : KmpFeed
+*   Description: This function advances the KMP automaton (findpat in the
+*				 article) with a pattern character found in the text.
+*   Parameters : kmp - the automaton
+*                pos - position of the character in the text
+*                c - the character
+*   Effects    : matchFunc is called for an occurrence ending at pos
+*   Returned   : None
+****************************************************************************/
+static void KmpFeed(kmp_t *kmp, long long pos, int c)
+{
+	if (pos != kmp->nextPos)
+	{
+		/* characters that are not in the pattern were skipped */
+		kmp->q = 0;
+	}
+	kmp->nextPos = pos + 1;
+
+	/* the first characters of the text, while none was skipped */
+	if ((kmp->head != NULL) && (pos == (long long)kmp->headLength) &&
+		(kmp->headLength + 1 < kmp->m))
+	{
+		kmp->head[kmp->headLength++] = (unsigned char)c;
+	}
+
+	while (kmp->q > 0 && kmp->pattern[kmp->q] != c)
+	{
+		kmp->q = kmp->failure[kmp->q - 1];
+	}
+
+	if (kmp->pattern[kmp->q] == c)
+	{
+		kmp->q++;
+	}
+
+	if (kmp->q == kmp->m)
+	{
+		kmp->count++;
+		kmp->matchFunc((unsigned long long)(pos + 1 - kmp->m), kmp->userData);
+		kmp->q = kmp->failure[kmp->m - 1];
+	}
+}
+
+/****************************************************************************
+*   Function   : HorspoolInit
+*   Description: This function computes the bad character table of the
+*				 pattern and lines the pattern up with the start of the
+*				 text.
+*   Parameters : hp - the matcher
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*                matchFunc - called with the offset of every occurrence
+*                userData - passed to matchFunc
+*   Effects    : hp is initialized
+*   Returned   : None
+****************************************************************************/
+static void HorspoolInit(horspool_t *hp, const unsigned char *pattern,
+	size_t m, match_func_t matchFunc, void *userData)
+{
+	size_t i;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		hp->shift[i] = m;
+	}
+
+	for (i = 0; i + 1 < m; i++)
+	{
+		hp->shift[pattern[i]] = m - 1 - i;
+	}
+
+	hp->pattern = pattern;
+	hp->m = m;
+	hp->end = (long long)m - 1;
+	hp->count = 0;
+	hp->matchFunc = matchFunc;
+	hp->userData = userData;
+}
+
+/****************************************************************************
+*   Function   : HorspoolAdvance
+*   Description: This function tries the alignments of the pattern that end
+*				 before the current position.  The character under the end
+*				 of the pattern is looked at first; a character that is not
+*				 in the pattern was never stored, and moves the pattern
+*				 past it.
+*   Parameters : hp - the matcher
+*                scan - the buffer
+*   Effects    : matchFunc is called for every occurrence found
+*   Returned   : None
+****************************************************************************/
+static void HorspoolAdvance(horspool_t *hp, const scan_t *scan)
+{
+	long long start;
+	size_t i;
+	int c;
+
+	while (hp->end < scan->current)
+	{
+		if ((c = ScanAt(scan, hp->end)) < 0)
+		{
+			hp->end += (long long)hp->m;
+			continue;
+		}
+
+		if (c == hp->pattern[hp->m - 1])
+		{
+			start = hp->end + 1 - (long long)hp->m;
+
+			for (i = hp->m - 1; i > 0; i--)
+			{
+				if (ScanAt(scan, start + (long long)i - 1) !=
+					hp->pattern[i - 1])
+				{
+					break;
+				}
+			}
+
+			if (0 == i)
+			{
+				hp->count++;
+				hp->matchFunc((unsigned long long)start, hp->userData);
+			}
+		}
+
+		hp->end += (long long)hp->shift[c];
+	}
+}
+
+/****************************************************************************
+*   Function   : ScanAt
+*   Description: This function looks up a character of the text that is
+*				 still in the buffer.
+*   Parameters : scan - the buffer
+*                pos - position of the character in the text
+*   Effects    : None
+*   Returned   : The character, -1 if it is not in the pattern
+****************************************************************************/
+static int ScanAt(const scan_t *scan, long long pos)
+{
+	unsigned int slot;
+
+	slot = (unsigned int)(pos & SCAN_RING_MASK);
+
+	return (scan->symPos[slot] == pos) ? scan->sym[slot] : -1;
+}
+
+/****************************************************************************
+*   Function   : AcInit
+*   Description: This function builds the Aho-Corasick automaton of a set
+*				 of patterns: the trie of the patterns, then the failure
+*				 links in breadth first order, which complete the
+*				 transition table.
+*   Parameters : ac - the automaton
+*                patterns - the patterns to look for
+*                lengths - lengths of the patterns
+*                count - number of patterns
+*   Effects    : ac is initialized.  AcFree has to be called.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int AcInit(ac_t *ac, const unsigned char *const *patterns,
+	const size_t *lengths, unsigned int count)
+{
+	int *fail, *queue;
+	size_t states, i;
+	unsigned int id, a, head, tail;
+	int s, t;
+
+	states = 1;
+	ac->classes = 0;
+
+	for (i = 0; i <= UCHAR_MAX; i++)
+	{
+		ac->cls[i] = NO_CLASS;
+	}
+
+	for (id = 0; id < count; id++)
+	{
+		if ((0 == lengths[id]) || (NULL == patterns[id]))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		for (i = 0; i < lengths[id]; i++)
+		{
+			if (ac->cls[patterns[id][i]] == NO_CLASS)
+			{
+				ac->cls[patterns[id][i]] = (short)ac->classes++;
+			}
+		}
+
+		states += lengths[id];
+	}
+
+	ac->delta = NULL;
+	ac->dict = (int *)malloc(states * sizeof(int));
+	ac->out = (int *)malloc(states * sizeof(int));
+	ac->next = (int *)malloc((count + 1) * sizeof(int));
+	fail = (int *)malloc(states * sizeof(int));
+	queue = (int *)malloc(states * sizeof(int));
+
+	if ((states <= (size_t)INT_MAX / (ac->classes + 1)) &&
+		(states * (ac->classes + 1) <= ((size_t)-1) / sizeof(int)))
+	{
+		ac->delta = (int *)malloc(states * (ac->classes + 1) * sizeof(int));
+	}
+
+	if ((NULL == ac->delta) || (NULL == ac->dict) || (NULL == ac->out) ||
+		(NULL == ac->next) || (NULL == fail) || (NULL == queue))
+	{
+		AcFree(ac);
+		free(fail);
+		free(queue);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* the trie of the patterns */
+	for (i = 0; i < states * ac->classes; i++)
+	{
+		ac->delta[i] = NO_STATE;
+	}
+
+	ac->out[0] = NO_STATE;
+	states = 1;
+
+	for (id = 0; id < count; id++)
+	{
+		s = 0;
+
+		for (i = 0; i < lengths[id]; i++)
+		{
+			a = (unsigned int)ac->cls[patterns[id][i]];
+			t = ac->delta[s * ac->classes + a];
+
+			if (NO_STATE == t)
+			{
+				t = (int)states++;
+				ac->delta[s * ac->classes + a] = t;
+				ac->out[t] = NO_STATE;
+			}
+
+			s = t;
+		}
+
+		/* the same pattern given twice is reported twice */
+		ac->next[id] = ac->out[s];
+		ac->out[s] = (int)id;
+	}
+
+	/* failure links, breadth first */
+	head = 0;
+	tail = 0;
+	fail[0] = 0;
+	ac->dict[0] = NO_STATE;
+
+	for (a = 0; a < ac->classes; a++)
+	{
+		t = ac->delta[a];
+
+		if (NO_STATE == t)
+		{
+			ac->delta[a] = 0;
+		}
+		else
+		{
+			fail[t] = 0;
+			ac->dict[t] = NO_STATE;
+			queue[tail++] = t;
+		}
+	}
+
+	while (head < tail)
+	{
+		s = queue[head++];
+
+		for (a = 0; a < ac->classes; a++)
+		{
+			t = ac->delta[s * ac->classes + a];
+
+			if (NO_STATE == t)
+			{
+				ac->delta[s * ac->classes + a] =
+					ac->delta[fail[s] * ac->classes + a];
+				continue;
+			}
+
+			fail[t] = ac->delta[fail[s] * ac->classes + a];
+			ac->dict[t] = (ac->out[fail[t]] != NO_STATE) ?
+				fail[t] : ac->dict[fail[t]];
+			queue[tail++] = t;
+		}
+	}
+
+	free(fail);
+	free(queue);
+
+	for (i = 0; i < SCAN_RING_SIZE; i++)
+	{
+		ac->statePos[i] = -1;
+	}
+
+	ac->lengths = lengths;
+	ac->q = 0;
+	ac->nextPos = 0;
+	ac->count = 0;
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : AcFree
+*   Description: This function frees the tables of an automaton.
+*   Parameters : ac - the automaton
+*   Effects    : The tables are freed.  ac itself is not.
+*   Returned   : None
+****************************************************************************/
+static void AcFree(ac_t *ac)
+{
+	free(ac->delta);
+	free(ac->dict);
+	free(ac->out);
+	free(ac->next);
+}
+
+/****************************************************************************
+*   Function   : AcFeed
+*   Description: This function advances the automaton with a pattern
+*				 character found in the text.
+*   Parameters : ac - the automaton
+*                pos - position of the character in the text
+*                c - the character
+*   Effects    : matchFunc is called for every occurrence ending at pos
+*   Returned   : None
+****************************************************************************/
+static void AcFeed(ac_t *ac, long long pos, int c)
+{
+	unsigned int slot;
+
+	if (pos != ac->nextPos)
+	{
+		/* characters that are in no pattern were skipped */
+		ac->q = 0;
+	}
+	ac->nextPos = pos + 1;
+
+	ac->q = ac->delta[ac->q * ac->classes + (unsigned int)ac->cls[c]];
+
+	slot = (unsigned int)(pos & SCAN_RING_MASK);
+	ac->state[slot] = ac->q;
+	ac->statePos[slot] = pos;
+
+	AcReport(ac, pos);
+}
+
+/****************************************************************************
+*   Function   : AcCopy
+*   Description: This function passes the characters of a pointer target
+*				 to the automaton.  The target holds the same characters as
+*				 its source, so once the automaton is in the state it was
+*				 in at the same place in the source, it goes through the
+*				 same states as it did there, which are taken from the
+*				 buffer instead of the transition table.
+*   Parameters : ac - the automaton
+*                scan - the buffer
+*                dst - position of the target
+*                src - position of the source
+*                length - length of the target
+*   Effects    : matchFunc is called for every occurrence ending in the
+*                target
+*   Returned   : None
+****************************************************************************/
+static void AcCopy(ac_t *ac, const scan_t *scan, long long dst, long long src,
+	unsigned int length)
+{
+	unsigned int i, slot;
+	long long pos;
+	int c, q, same;
+
+	same = 0;
+
+	for (i = 0; i < length; i++)
+	{
+		pos = dst + (long long)i;
+		c = ScanAt(scan, pos);
+
+		/* the '~' before the text were never passed to the automaton */
+		if ((src + (long long)i < 0) || (ScanAt(scan, src + i) != c))
+		{
+			same = 0;
+		}
+
+		if (c < 0)
+		{
+			continue;
+		}
+
+		if (same && AcStateAt(ac, src + i, &q))
+		{
+			ac->q = q;
+			ac->nextPos = pos + 1;
+			slot = (unsigned int)(pos & SCAN_RING_MASK);
+			ac->state[slot] = q;
+			ac->statePos[slot] = pos;
+			AcReport(ac, pos);
+			continue;
+		}
+
+		AcFeed(ac, pos, c);
+		same = (src + (long long)i >= 0) && (ScanAt(scan, src + i) == c) &&
+			AcStateAt(ac, src + i, &q) && (q == ac->q);
+	}
+}
+
+/****************************************************************************
+*   Function   : AcFlush
+*   Description: This function passes over the pointer targets that start at
+*				 the current position, like ScanFlush does for KMP.
+*   Parameters : scan - the buffer
+*                ac - the automaton the stored characters are passed to
+*   Effects    : scan->current is moved past the targets
+*   Returned   : None
+****************************************************************************/
+static void AcFlush(scan_t *scan, ac_t *ac)
+{
+	unsigned int slot, length;
+
+	slot = (unsigned int)(scan->current & SCAN_RING_MASK);
+
+	while ((length = scan->cover[slot]) != 0)
+	{
+		scan->cover[slot] = 0;
+
+		if (scan->coverRel[slot])
+		{
+			AcCopy(ac, scan, scan->current, scan->coverSrc[slot], length);
+		}
+
+		scan->current += length;
+		slot = (unsigned int)(scan->current & SCAN_RING_MASK);
+	}
+}
+
+/****************************************************************************
+*   Function   : AcStateAt
+*   Description: This function looks up the state the automaton was in after
+*				 a position that is still in the buffer.
+*   Parameters : ac - the automaton
+*                pos - position in the text
+*                q - set to the state
+*   Effects    : None
+*   Returned   : 1 if the state is known, 0 if not
+****************************************************************************/
+static int AcStateAt(const ac_t *ac, long long pos, int *q)
+{
+	unsigned int slot;
+
+	slot = (unsigned int)(pos & SCAN_RING_MASK);
+
+	if (ac->statePos[slot] != pos)
+	{
+		return 0;
+	}
+
+	*q = ac->state[slot];
+	return 1;
+}
+
+/****************************************************************************
+*   Function   : AcReport
+*   Description: This function reports the patterns that end at a position,
+*				 the longest first.
+*   Parameters : ac - the automaton, in the state after pos
+*                pos - position in the text
+*   Effects    : matchFunc is called for every pattern ending at pos
+*   Returned   : None
+****************************************************************************/
+static void AcReport(ac_t *ac, long long pos)
+{
+	int s, id;
+
+	s = (ac->out[ac->q] != NO_STATE) ? ac->q : ac->dict[ac->q];
+
+	for (; s != NO_STATE; s = ac->dict[s])
+	{
+		for (id = ac->out[s]; id != NO_STATE; id = ac->next[id])
+		{
+			ac->count++;
+			ac->matchFunc((unsigned int)id,
+				(unsigned long long)(pos + 1 - (long long)ac->lengths[id]),
+				ac->userData);
+		}
+	}
+}
+
+/****************************************************************************
+*   Function   : PrintMatch
+*   Description: This function prints the offset of an occurrence.
+*   Parameters : offset - offset of the occurrence in the original text
+*                userData - not used
+*   Effects    : The offset is printed to stdout
+*   Returned   : None
+****************************************************************************/
+static void PrintMatch(unsigned long long offset, void *userData)
+{
+	(void)userData;
+	printf("%llu\n", offset);
+}
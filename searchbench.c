@@ -0,0 +1,315 @@
+/***************************************************************************
+*                     Compressed Matching Benchmark
+*
+*   File    : searchbench.c
+*   Purpose : Compare searching a file in the project format directly (KMP
+*             and Horspool) with decoding it and searching the text
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzss.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* patterns searched when none are given, from short to long */
+static const char *defaultPatterns[] =
+{
+	"God",
+	"the\r\nLORD",
+	"and\r\nthe\r\nLORD\r\nsaid",
+	"And\r\nthe\r\nevening\r\nand\r\nthe\r\nmorning",
+	"In\r\nthe\r\nbeginning\r\nGod\r\ncreated\r\nthe\r\nheaven\r\n"
+	"and\r\nthe\r\nearth",
+	"And\r\nthe\r\nevening\r\nand\r\nthe\r\nmorning\r\nwere\r\nthe\r\n"
+	"first\r\nday\r\nAnd\r\nGod\r\nsaid\r\nLet\r\nthere\r\nbe\r\na\r\n"
+	"firmament"
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static long SearchDecoded(FILE *compProject, const unsigned char *pattern,
+	size_t m);
+static void CountMatch(unsigned long long offset, void *userData);
+static void CountMultiMatch(unsigned int id, unsigned long long offset,
+	void *userData);
+static double Seconds(clock_t start);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : main
+*   Description: This function encodes a file (org.txt by default) to the
+*				 project format in a temporary file and looks for every
+*				 pattern in it three ways: decoding it and searching the
+*				 text, SearchCompressedEx and SearchCompressedHorspool.  It
+*				 prints the time each way took and checks that they all
+*				 find the same number of occurrences.  Then all the
+*				 patterns are looked for at once with SearchCompressedMulti
+*				 and compared with running KMP once for every pattern.
+*   Parameters : argv[1] - optional name of the file to encode
+*                argv[2..] - optional patterns, "\r" and "\n" stand for
+*                            a carriage return and a newline
+*   Effects    : Results are printed to stdout
+*   Returned   : 0 for success, 1 for failure
+****************************************************************************/
+int main(int argc, char *argv[])
+{
+	const char *name;
+	unsigned char **patterns, *pattern;
+	size_t *lengths;
+	FILE *org, *comp;
+	const char *p;
+	clock_t start;
+	double tDecoded, tKmp, tHorspool, tAllKmp;
+	long nDecoded, nKmp, nHorspool, nAll, nMulti, unused;
+	size_t m;
+	int i, count, result;
+
+	name = (argc > 1) ? argv[1] : "org.txt";
+
+	org = fopen(name, "rb");
+	comp = tmpfile();
+
+	if ((org == NULL) || (comp == NULL))
+	{
+		perror("Opening files");
+		return 1;
+	}
+
+	if (EncodeProject(org, comp) != 0)
+	{
+		perror("Encoding");
+		return 1;
+	}
+
+	fclose(org);
+
+	count = (argc > 2) ? (argc - 2) :
+		(int)(sizeof(defaultPatterns) / sizeof(defaultPatterns[0]));
+	result = 0;
+	tAllKmp = 0;
+	nAll = 0;
+
+	patterns = (unsigned char **)malloc(count * sizeof(unsigned char *));
+	lengths = (size_t *)malloc(count * sizeof(size_t));
+
+	if ((NULL == patterns) || (NULL == lengths))
+	{
+		perror("Allocating patterns");
+		return 1;
+	}
+
+	printf("%5s %10s %10s %10s %10s  %s\n", "m", "decoded s", "kmp s",
+		"horspool s", "matches", "check");
+
+	for (i = 0; i < count; i++)
+	{
+		p = (argc > 2) ? argv[i + 2] : defaultPatterns[i];
+
+		/* patterns given on the command line spell line ends as \r\n */
+		pattern = (unsigned char *)malloc(strlen(p) + 1);
+		patterns[i] = pattern;
+
+		if (NULL == pattern)
+		{
+			perror("Allocating pattern");
+			return 1;
+		}
+
+		for (m = 0; *p != '\0'; p++)
+		{
+			if ((p[0] == '\\') && ((p[1] == 'n') || (p[1] == 'r')))
+			{
+				pattern[m++] = (p[1] == 'n') ? '\n' : '\r';
+				p++;
+			}
+			else
+			{
+				pattern[m++] = (unsigned char)*p;
+			}
+		}
+
+		lengths[i] = m;
+
+		rewind(comp);
+		start = clock();
+		nDecoded = SearchDecoded(comp, pattern, m);
+		tDecoded = Seconds(start);
+
+		rewind(comp);
+		unused = 0;
+		start = clock();
+		nKmp = SearchCompressedEx(comp, pattern, m, CountMatch, &unused);
+		tKmp = Seconds(start);
+		tAllKmp += tKmp;
+		nAll += nKmp;
+
+		rewind(comp);
+		start = clock();
+		nHorspool = SearchCompressedHorspool(comp, pattern, m, CountMatch,
+			&unused);
+		tHorspool = Seconds(start);
+
+		printf("%5lu %10.3f %10.3f %10.3f %10ld  %s\n", (unsigned long)m,
+			tDecoded, tKmp, tHorspool, nDecoded,
+			((nDecoded == nKmp) && (nDecoded == nHorspool)) ?
+			"ok" : "COUNTS DIFFER");
+
+		if ((nDecoded != nKmp) || (nDecoded != nHorspool))
+		{
+			result = 1;
+		}
+	}
+
+	/* all the patterns in one pass */
+	rewind(comp);
+	unused = 0;
+	start = clock();
+	nMulti = SearchCompressedMulti(comp,
+		(const unsigned char *const *)patterns, lengths, (unsigned int)count,
+		CountMultiMatch, &unused);
+
+	printf("\n%d patterns: kmp %.3f s, one pass %.3f s, %ld matches  %s\n",
+		count, tAllKmp, Seconds(start), nMulti,
+		(nMulti == nAll) ? "ok" : "COUNTS DIFFER");
+
+	if (nMulti != nAll)
+	{
+		result = 1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		free(patterns[i]);
+	}
+
+	free(patterns);
+	free(lengths);
+	fclose(comp);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : SearchDecoded
+*   Description: This function decodes a file in the project format into
+*				 memory and counts the occurrences of a pattern in the text
+*				 by comparing it at every position.
+*   Parameters : compProject - pointer to the project encoded file
+*                pattern - the pattern to look for
+*                m - length of the pattern
+*   Effects    : compProject is read to its end.
+*   Returned   : The number of occurrences, -1 for failure
+****************************************************************************/
+static long SearchDecoded(FILE *compProject, const unsigned char *pattern,
+	size_t m)
+{
+	unsigned char *in, *text;
+	size_t inSize, textSize, i;
+	long found;
+
+	if ((fseek(compProject, 0, SEEK_END) != 0) ||
+		((found = ftell(compProject)) < 0))
+	{
+		return -1;
+	}
+
+	rewind(compProject);
+	inSize = (size_t)found;
+	in = (unsigned char *)malloc(inSize + 1);
+
+	if ((NULL == in) || (fread(in, 1, inSize, compProject) != inSize) ||
+		(DecodeProjectBuf(in, inSize, &text, &textSize) != 0))
+	{
+		free(in);
+		return -1;
+	}
+
+	free(in);
+	found = 0;
+
+	for (i = 0; (m > 0) && (i + m <= textSize); i++)
+	{
+		if (memcmp(text + i, pattern, m) == 0)
+		{
+			found++;
+		}
+	}
+
+	free(text);
+	return found;
+}
+
+/****************************************************************************
+*   Function   : CountMatch
+*   Description: This function counts an occurrence.
+*   Parameters : offset - offset of the occurrence in the original text
+*                userData - the counter
+*   Effects    : The counter is incremented
+*   Returned   : None
+****************************************************************************/
+static void CountMatch(unsigned long long offset, void *userData)
+{
+	(void)offset;
+	(*(long *)userData)++;
+}
+
+/****************************************************************************
+*   Function   : CountMultiMatch
+*   Description: This function counts an occurrence of any pattern.
+*   Parameters : id - index of the pattern
+*                offset - offset of the occurrence in the original text
+*                userData - the counter
+*   Effects    : The counter is incremented
+*   Returned   : None
+****************************************************************************/
+static void CountMultiMatch(unsigned int id, unsigned long long offset,
+	void *userData)
+{
+	(void)id;
+	(void)offset;
+	(*(long *)userData)++;
+}
+
+/****************************************************************************
+*   Function   : Seconds
+*   Description: This function tells the processor time since start.
+*   Parameters : start - the clock() value to measure from
+*   Effects    : None
+*   Returned   : Seconds since start
+****************************************************************************/
+static double Seconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
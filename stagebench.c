@@ -0,0 +1,691 @@
+/***************************************************************************
+*                        Pipeline Stage Benchmark
+*
+*   File    : stagebench.c
+*   Purpose : Time every stage of the pipeline on org.txt and on generated
+*             corpora, and write the results as JSON so they can be
+*             compared from one release to the next
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lzss.h"
+#include "lzlocal.h"
+#include "bitfile.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define CORPUS_SIZE     (1 << 20)   /* bytes of every generated corpus */
+#define CORPUS_SEED     0x2016ULL   /* the corpora are the same every run */
+#define BENCH_RUNS      3           /* the fastest of these runs is kept */
+#define BENCH_VERSION   2           /* of the JSON output */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* a stage, run on the output of the stage before it */
+typedef struct bench_stage_t
+{
+	const char *name;
+	stream_stage_t stage;
+} bench_stage_t;
+
+/* the results of a stage on a corpus */
+typedef struct stage_result_t
+{
+	size_t inSize;
+	size_t outSize;
+	double seconds;
+} stage_result_t;
+
+/* a generated corpus */
+typedef struct corpus_t
+{
+	const char *name;
+	void (*make)(unsigned char *data, size_t size);
+} corpus_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int BenchCorpus(const char *name, const unsigned char *data,
+	size_t size, FILE *table, FILE *json, int first);
+static int CountItems(const unsigned char *project, size_t size,
+	unsigned long *literals, unsigned long *pairs, unsigned long *triples);
+static long PeakRSS(void);
+static unsigned char *ReadFile(const char *name, size_t *size);
+static double Seconds(clock_t start);
+
+static unsigned int NextRandom(void);
+static void MakeRandom(unsigned char *data, size_t size);
+static void MakeRepetitive(unsigned char *data, size_t size);
+static void MakeBinary(unsigned char *data, size_t size);
+static void MakeText(unsigned char *data, size_t size);
+
+/***************************************************************************
+*                            GLOBAL VARIABLES
+***************************************************************************/
+
+/***************************************************************************
+* The stages in the order of sample.c, each one reads the output of the
+* last.  They are run on buffers with the cores of the functions they are
+* named after, so DecodeLZSS is the bit file decoder and not the faster one
+* of DecodeLZSSBuf.
+***************************************************************************/
+static const bench_stage_t stages[] =
+{
+	{"EncodeLZSS", STREAM_ENCODE_LZSS},
+	{"AddSlide", STREAM_ADD_SLIDE},
+	{"CastEncodeLZSS", STREAM_CAST_ENCODE},
+	{"CastBack", STREAM_CAST_BACK},
+	{"DecodeLZSS", STREAM_DECODE_LZSS}
+};
+
+#define STAGE_COUNT     (sizeof(stages) / sizeof(stages[0]))
+#define PROJECT_STAGE   3           /* outputs[] index of the project format */
+
+static const corpus_t corpora[] =
+{
+	{"random", MakeRandom},
+	{"repetitive", MakeRepetitive},
+	{"binary", MakeBinary},
+	{"text", MakeText}
+};
+
+/* words of the generated text, the common ones first */
+static const char *words[] =
+{
+	"the", "and", "of", "to", "that", "in", "he", "shall", "unto", "for",
+	"i", "his", "a", "lord", "they", "be", "is", "him", "not", "them",
+	"it", "with", "all", "thou", "thy", "was", "god", "which", "my", "me",
+	"said", "but", "ye", "their", "have", "will", "thee", "from", "as",
+	"are", "when", "this", "out", "were", "upon", "man", "by", "you",
+	"israel", "king", "son", "up", "there", "hath", "then", "people",
+	"came", "had", "house", "into", "on", "her", "come", "one", "we",
+	"children", "before", "your", "also", "day", "land", "men", "against",
+	"shalt", "if", "hand", "went", "us", "made", "no", "saying", "go",
+	"jerusalem", "earth", "waters", "evening", "morning", "firmament"
+};
+
+static unsigned long long randomState;
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : main
+*   Description: This function runs every stage of the pipeline on a file
+*				 (org.txt by default) and on generated random, repetitive,
+*				 binary and text corpora.  Every stage is run BENCH_RUNS
+*				 times on the output of the stage before it and the fastest
+*				 run is kept.  A table is printed and the same results are
+*				 written as JSON.
+*   Parameters : -o name - optional name of the JSON file, bench.json by
+*                          default, "-" for stdout
+*                name - optional name of the file to benchmark
+*   Effects    : Results are printed to stdout (stderr with -o -) and
+*                written to the JSON file
+*   Returned   : 0 for success, 1 for failure
+****************************************************************************/
+int main(int argc, char *argv[])
+{
+	const char *name, *jsonName;
+	unsigned char *data;
+	size_t size;
+	FILE *table, *json;
+	unsigned int i;
+	int arg, result;
+
+	name = "org.txt";
+	jsonName = "bench.json";
+
+	for (arg = 1; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "-o") == 0) && (arg + 1 < argc))
+		{
+			jsonName = argv[++arg];
+		}
+		else
+		{
+			name = argv[arg];
+		}
+	}
+
+	data = ReadFile(name, &size);
+
+	if (NULL == data)
+	{
+		perror(name);
+		return 1;
+	}
+
+	json = (strcmp(jsonName, "-") == 0) ? stdout : fopen(jsonName, "w");
+
+	if (NULL == json)
+	{
+		perror("Opening JSON file");
+		return 1;
+	}
+
+	/* the table goes to stderr when the JSON goes to stdout */
+	table = (json == stdout) ? stderr : stdout;
+
+	fprintf(table, "%-12s %-15s %10s %10s %7s %9s %8s\n", "corpus", "stage",
+		"in bytes", "out bytes", "ratio", "MB/s", "ns/byte");
+	fprintf(json, "{\n  \"version\": %d,\n  \"corpus_size\": %d,\n"
+		"  \"runs\": %d,\n  \"corpora\": [", BENCH_VERSION, CORPUS_SIZE,
+		BENCH_RUNS);
+
+	result = BenchCorpus(name, data, size, table, json, 1);
+	free(data);
+
+	data = (unsigned char *)malloc(CORPUS_SIZE);
+
+	if (NULL == data)
+	{
+		perror("Allocating corpus");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++)
+	{
+		randomState = CORPUS_SEED;
+		corpora[i].make(data, CORPUS_SIZE);
+
+		if (BenchCorpus(corpora[i].name, data, CORPUS_SIZE, table, json,
+			0) != 0)
+		{
+			result = 1;
+		}
+	}
+
+	free(data);
+	fprintf(json, "\n  ]\n}\n");
+
+	if (json != stdout)
+	{
+		fclose(json);
+	}
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : BenchCorpus
+*   Description: This function runs the stages on a corpus, prints a line
+*				 for every stage and writes the JSON object of the corpus.
+*				 The throughput of every stage is counted in bytes of the
+*				 corpus, so the stages can be compared with each other.
+*				 The ratio of a stage is its output over the corpus.
+*   Parameters : name - name of the corpus
+*                data - the corpus
+*                size - number of bytes in the corpus
+*                table - the file to print the table to
+*                json - the JSON file
+*                first - nonzero for the first corpus of the JSON array
+*   Effects    : Results are printed to table and written to json.  A
+*                corpus the last stage does not give back is reported
+*                there, but is not a failure of the benchmark.
+*   Returned   : 0 for success, 1 if a stage failed
+****************************************************************************/
+static int BenchCorpus(const char *name, const unsigned char *data,
+	size_t size, FILE *table, FILE *json, int first)
+{
+	stage_result_t results[STAGE_COUNT];
+	unsigned char *outputs[STAGE_COUNT + 1];
+	unsigned char *out;
+	size_t sizes[STAGE_COUNT + 1], outSize;
+	unsigned long literals, pairs, triples;
+	stage_func_t stage;
+	clock_t start;
+	double seconds;
+	unsigned int i, run;
+	int ok, result;
+
+	outputs[0] = (unsigned char *)data;
+	sizes[0] = size;
+	ok = 1;
+
+	for (i = 0; i < STAGE_COUNT; i++)
+	{
+		results[i].inSize = sizes[i];
+		results[i].seconds = -1;
+		outputs[i + 1] = NULL;
+		stage = FindStage(stages[i].stage);
+
+		for (run = 0; run < BENCH_RUNS; run++)
+		{
+			start = clock();
+
+			if ((NULL == stage) || (RunBufferStage(stage, outputs[i], sizes[i],
+				&out, &outSize) != 0))
+			{
+				perror(stages[i].name);
+				ok = 0;
+				break;
+			}
+
+			seconds = Seconds(start);
+
+			if ((results[i].seconds < 0) || (seconds < results[i].seconds))
+			{
+				results[i].seconds = seconds;
+			}
+
+			/* the output of the first run is the input of the next stage */
+			if (NULL == outputs[i + 1])
+			{
+				outputs[i + 1] = out;
+				sizes[i + 1] = outSize;
+			}
+			else
+			{
+				free(out);
+			}
+		}
+
+		if (!ok)
+		{
+			results[i].seconds = -1;
+			break;
+		}
+
+		results[i].outSize = sizes[i + 1];
+	}
+
+	literals = 0;
+	pairs = 0;
+	triples = 0;
+	result = ok ? 0 : 1;
+
+	if (ok)
+	{
+		ok = (CountItems(outputs[PROJECT_STAGE], sizes[PROJECT_STAGE],
+			&literals, &pairs, &triples) == 0) &&
+			(sizes[STAGE_COUNT] == size) &&
+			(memcmp(outputs[STAGE_COUNT], data, size) == 0);
+	}
+
+	fprintf(json, "%s\n    {\n      \"name\": \"%s\",\n"
+		"      \"bytes\": %lu,\n      \"literals\": %lu,\n"
+		"      \"pairs\": %lu,\n      \"triples\": %lu,\n"
+		"      \"round_trip\": %s,\n      \"stages\": [",
+		first ? "" : ",", name, (unsigned long)size, literals, pairs,
+		triples, ok ? "true" : "false");
+
+	for (i = 0; (i < STAGE_COUNT) && (results[i].seconds >= 0); i++)
+	{
+		/* a stage too fast for the clock is taken as one tick */
+		seconds = (results[i].seconds > 0) ? results[i].seconds :
+			(1.0 / CLOCKS_PER_SEC);
+
+		fprintf(table, "%-12.12s %-15s %10lu %10lu %7.3f %9.2f %8.2f\n",
+			name, stages[i].name, (unsigned long)results[i].inSize,
+			(unsigned long)results[i].outSize,
+			(size > 0) ? ((double)results[i].outSize / size) : 0.0,
+			size / seconds / 1e6,
+			(size > 0) ? (seconds * 1e9 / size) : 0.0);
+
+		fprintf(json, "%s\n        {\"stage\": \"%s\", \"in_bytes\": %lu, "
+			"\"out_bytes\": %lu, \"seconds\": %.6f, \"ratio\": %.6f, "
+			"\"mb_per_s\": %.3f, \"ns_per_byte\": %.3f}", (i > 0) ? "," : "",
+			stages[i].name, (unsigned long)results[i].inSize,
+			(unsigned long)results[i].outSize, results[i].seconds,
+			(size > 0) ? ((double)results[i].outSize / size) : 0.0,
+			size / seconds / 1e6,
+			(size > 0) ? (seconds * 1e9 / size) : 0.0);
+	}
+
+	fprintf(json, "\n      ],\n      \"peak_rss_kb\": %ld\n    }",
+		PeakRSS());
+
+	fprintf(table, "%-12.12s %lu literals, %lu pairs, %lu triples, "
+		"peak RSS %ld kB  %s\n\n", name, literals, pairs, triples,
+		PeakRSS(), ok ? "ok" : "ROUND TRIP FAILED");
+
+	for (i = 1; i <= STAGE_COUNT; i++)
+	{
+		free(outputs[i]);
+	}
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : CountItems
+*   Description: This function counts the characters, PAIRs and TRIPLEs of
+*				 a buffer in the project format.  A pointer with a slide is
+*				 a TRIPLE, as the encoder only writes TRIPLEs for them.
+*   Parameters : project - the project encoded buffer
+*                size - number of bytes in the buffer
+*                literals, pairs, triples - set to the counts
+*   Effects    : None
+*   Returned   : 0 for success, -1 for failure
+****************************************************************************/
+static int CountItems(const unsigned char *project, size_t size,
+	unsigned long *literals, unsigned long *pairs, unsigned long *triples)
+{
+	token_buffer_t tokens;
+	bit_file_t *bfpIn;
+	FILE *fp;
+	size_t t;
+	int end;
+
+	fp = tmpfile();
+
+	if ((NULL == fp) || (fwrite(project, 1, size, fp) != size))
+	{
+		if (fp != NULL)
+		{
+			fclose(fp);
+		}
+
+		return -1;
+	}
+
+	rewind(fp);
+	bfpIn = MakeBitFile(fp, BF_READ);
+
+	if ((NULL == bfpIn) || (TokensInit(&tokens) != 0))
+	{
+		if (bfpIn != NULL)
+		{
+			BitFileToFILE(bfpIn);
+		}
+
+		fclose(fp);
+		return -1;
+	}
+
+	do
+	{
+		end = UnpackProject(bfpIn, &tokens);
+
+		for (t = 0; t < tokens.count; t++)
+		{
+			if (tokens.kind[t] == UNCODED)
+			{
+				(*literals)++;
+			}
+			else if (tokens.slide[t] != 0)
+			{
+				(*triples)++;
+			}
+			else
+			{
+				(*pairs)++;
+			}
+		}
+
+		tokens.count = 0;
+	} while (end != EOF);
+
+	TokensFree(&tokens);
+	BitFileToFILE(bfpIn);
+	fclose(fp);
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : PeakRSS
+*   Description: This function tells the most memory the process has had
+*				 resident so far.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : The peak resident set size in kB, 0 where it is not known
+****************************************************************************/
+static long PeakRSS(void)
+{
+#ifndef _WIN32
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		return (long)(usage.ru_maxrss / 1024);  /* in bytes there */
+#else
+		return (long)usage.ru_maxrss;
+#endif
+	}
+#endif
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : ReadFile
+*   Description: This function reads a whole file into memory.
+*   Parameters : name - name of the file
+*                size - set to the number of bytes read
+*   Effects    : None
+*   Returned   : The allocated contents, which the caller has to free, NULL
+*                for failure.
+****************************************************************************/
+static unsigned char *ReadFile(const char *name, size_t *size)
+{
+	unsigned char *data;
+	FILE *fp;
+	long length;
+
+	fp = fopen(name, "rb");
+
+	if (NULL == fp)
+	{
+		return NULL;
+	}
+
+	if ((fseek(fp, 0, SEEK_END) != 0) || ((length = ftell(fp)) < 0))
+	{
+		fclose(fp);
+		return NULL;
+	}
+
+	rewind(fp);
+	data = (unsigned char *)malloc((size_t)length + 1);
+
+	if ((NULL == data) ||
+		(fread(data, 1, (size_t)length, fp) != (size_t)length))
+	{
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+	*size = (size_t)length;
+	return data;
+}
+
+/****************************************************************************
+*   Function   : Seconds
+*   Description: This function tells the processor time since start.
+*   Parameters : start - the clock() value to measure from
+*   Effects    : None
+*   Returned   : Seconds since start
+****************************************************************************/
+static double Seconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/****************************************************************************
+*   Function   : NextRandom
+*   Description: This function returns the next number of a xorshift64*
+*				 generator, so the corpora do not depend on the C library.
+*   Parameters : None
+*   Effects    : randomState is advanced
+*   Returned   : 32 random bits
+****************************************************************************/
+static unsigned int NextRandom(void)
+{
+	randomState ^= randomState >> 12;
+	randomState ^= randomState << 25;
+	randomState ^= randomState >> 27;
+	return (unsigned int)((randomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/****************************************************************************
+*   Function   : MakeRandom
+*                MakeRepetitive
+*                MakeBinary
+*                MakeText
+*   Description: These functions generate the corpora: random bytes, which
+*				 do not compress; a 61 byte phrase repeated with a byte
+*				 changed every few kB; 16 byte records of counters, small
+*				 numbers and flags; and lines of words taken more often the
+*				 more common they are, with CR LF line ends as in org.txt.
+*   Parameters : data - the buffer to fill
+*                size - number of bytes to fill
+*   Effects    : data is filled
+*   Returned   : None
+****************************************************************************/
+static void MakeRandom(unsigned char *data, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		data[i] = (unsigned char)NextRandom();
+	}
+}
+
+static void MakeRepetitive(unsigned char *data, size_t size)
+{
+	unsigned char phrase[61];
+	size_t i;
+
+	for (i = 0; i < sizeof(phrase); i++)
+	{
+		phrase[i] = (unsigned char)('a' + NextRandom() % 26);
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		data[i] = phrase[i % sizeof(phrase)];
+
+		if (NextRandom() % 4096 == 0)
+		{
+			data[i] = (unsigned char)NextRandom();
+		}
+	}
+}
+
+static void MakeBinary(unsigned char *data, size_t size)
+{
+	unsigned char record[16];
+	unsigned int counter, value;
+	size_t i, j;
+
+	counter = 0x10000;
+
+	for (i = 0; i < size; i += sizeof(record))
+	{
+		value = NextRandom();
+
+		/* a little endian counter, a small number, a type and flags */
+		record[0] = (unsigned char)counter;
+		record[1] = (unsigned char)(counter >> 8);
+		record[2] = (unsigned char)(counter >> 16);
+		record[3] = (unsigned char)(counter >> 24);
+		record[4] = (unsigned char)(value & 0x3F);
+		record[5] = 0;
+		record[6] = 0;
+		record[7] = 0;
+		record[8] = (unsigned char)(1 << ((value >> 8) & 3));
+		record[9] = 0x80;
+
+		for (j = 10; j < sizeof(record); j++)
+		{
+			record[j] = ((value >> (j + 6)) & 1) ? 0xFF : 0;
+		}
+
+		counter += 1 + ((value >> 28) & 7);
+
+		for (j = 0; (j < sizeof(record)) && (i + j < size); j++)
+		{
+			data[i + j] = record[j];
+		}
+	}
+}
+
+static void MakeText(unsigned char *data, size_t size)
+{
+	const char *word;
+	size_t i, column;
+	unsigned int count, index;
+	int capital;
+
+	count = sizeof(words) / sizeof(words[0]);
+	column = 0;
+	capital = 1;
+	i = 0;
+
+	/* a word, a mark and a line end take less than 16 bytes */
+	while (i + 16 <= size)
+	{
+		/* the product of two uniform picks favours the first words */
+		index = (NextRandom() % count) * (NextRandom() % count) / count;
+
+		for (word = words[index]; *word != '\0'; word++)
+		{
+			data[i++] = (unsigned char)(capital ? (*word - 'a' + 'A') : *word);
+			capital = 0;
+			column++;
+		}
+
+		if (NextRandom() % 12 == 0)
+		{
+			capital = (NextRandom() % 3 != 0);
+			data[i++] = capital ? '.' : ',';
+			column++;
+		}
+
+		if (column > 60)
+		{
+			data[i++] = '\r';
+			data[i++] = '\n';
+			column = 0;
+		}
+		else
+		{
+			data[i++] = ' ';
+			column++;
+		}
+	}
+
+	while (i < size)
+	{
+		data[i++] = ' ';
+	}
+}
@@ -0,0 +1,501 @@
+/***************************************************************************
+*   A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : stream.c
+*   Purpose : Run a stage of the pipeline on input that is fed to it in
+*             pieces, and pass on its output as it is written.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "lzss.h"
+#include "lzlocal.h"
+#include "bitfile.h"
+
+/***************************************************************************
+* The stages read and write bit files, and run to the end of their input.
+* A stream runs its stage on a thread of its own, with bit files that read
+* the input queue and write the output queue.  The thread waits for input
+* when the input queue is empty, and the caller of StreamFeed waits while
+* it is full, so the input is never all kept in memory.  The output queue
+* has no limit, or the stage could wait for the caller to drain it while
+* the caller waits to feed the stage.
+***************************************************************************/
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/* bytes the bit files of a stream read and write at a time */
+#define STREAM_BLOCK_SIZE   (4U << 10)
+
+/* input not read yet that StreamFeed waits for */
+#define STREAM_QUEUE_LIMIT  (1U << 20)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/* the bytes written to a queue and not taken yet start at data + start */
+typedef struct stream_queue_t
+{
+	unsigned char *data;
+	size_t start;
+	size_t length;
+	size_t size;                        /* bytes allocated */
+} stream_queue_t;
+
+/***************************************************************************
+* A stream.  lock protects everything after it, and changed is signalled
+* whenever any of it changes.  finishing is set when the input ends, and
+* done when the stage returned result, with errno error.
+***************************************************************************/
+struct lzss_stream_t
+{
+	stage_func_t stage;
+	pthread_t thread;
+	int joined;                         /* thread was joined */
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	stream_queue_t in;
+	stream_queue_t out;
+	int finishing;
+	int done;
+	int failed;                         /* output was lost */
+	int result;
+	int error;
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void *StreamWorker(void *arg);
+static size_t StreamRead(void *handle, unsigned char *data, size_t size);
+static size_t StreamWrite(void *handle, unsigned char *data, size_t size);
+
+static int QueuePut(stream_queue_t *queue, const unsigned char *data,
+	size_t size);
+static size_t QueueTake(stream_queue_t *queue, unsigned char *data,
+	size_t size);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : StreamOpen
+*   Description: This function creates a stream and starts its stage on a
+*				 thread, where it waits for input.
+*   Parameters : stage - the stage to run
+*   Effects    : A stream is allocated and its thread started.
+*   Returned   : The stream, which has to be freed with StreamClose, NULL
+*                for failure.  errno will be set in the event of a failure.
+****************************************************************************/
+lzss_stream_t *StreamOpen(stream_stage_t stage)
+{
+	lzss_stream_t *stream;
+	stage_func_t func;
+
+	func = FindStage(stage);
+
+	if (NULL == func)
+	{
+		return NULL;
+	}
+
+	stream = (lzss_stream_t *)calloc(1, sizeof(lzss_stream_t));
+
+	if (NULL == stream)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	stream->stage = func;
+	pthread_mutex_init(&stream->lock, NULL);
+	pthread_cond_init(&stream->changed, NULL);
+
+	if (pthread_create(&stream->thread, NULL, StreamWorker, stream) != 0)
+	{
+		pthread_cond_destroy(&stream->changed);
+		pthread_mutex_destroy(&stream->lock);
+		free(stream);
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	return stream;
+}
+
+/****************************************************************************
+*   Function   : StreamFeed
+*   Description: This function passes the next bytes of input to the stage
+*				 of a stream.  It waits while the input queue holds more
+*				 than STREAM_QUEUE_LIMIT bytes the stage did not read yet.
+*   Parameters : stream - the stream
+*                data - the input
+*                size - number of bytes of input
+*   Effects    : The input is copied to the input queue of stream.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to EINVAL after StreamFinish, or to the
+*                errno of the stage if it failed.
+****************************************************************************/
+int StreamFeed(lzss_stream_t *stream, const unsigned char *data,
+	size_t size)
+{
+	int result;
+
+	/* validate arguments */
+	if ((NULL == stream) || ((NULL == data) && (size != 0)))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+
+	while ((stream->in.length >= STREAM_QUEUE_LIMIT) && !stream->done)
+	{
+		pthread_cond_wait(&stream->changed, &stream->lock);
+	}
+
+	if (stream->finishing)
+	{
+		errno = EINVAL;
+		result = -1;
+	}
+	else if (stream->done)
+	{
+		/* the stage stopped reading, its input is of no use */
+		errno = stream->error;
+		result = stream->result;
+	}
+	else
+	{
+		result = QueuePut(&stream->in, data, size);
+		pthread_cond_broadcast(&stream->changed);
+	}
+
+	pthread_mutex_unlock(&stream->lock);
+
+	return result;
+}
+
+/****************************************************************************
+*   Function   : StreamDrain
+*   Description: This function takes the output a stream wrote so far,
+*				 without waiting for more.
+*   Parameters : stream - the stream
+*                out - the buffer to copy the output to
+*                size - number of bytes in out
+*   Effects    : Up to size bytes of output are moved from the output
+*                queue of stream to out.
+*   Returned   : The number of bytes copied, 0 if there is no output.
+****************************************************************************/
+size_t StreamDrain(lzss_stream_t *stream, unsigned char *out, size_t size)
+{
+	size_t taken;
+
+	if ((NULL == stream) || (NULL == out))
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&stream->lock);
+	taken = QueueTake(&stream->out, out, size);
+	pthread_mutex_unlock(&stream->lock);
+
+	return taken;
+}
+
+/****************************************************************************
+*   Function   : StreamFinish
+*   Description: This function ends the input of a stream and waits for its
+*				 stage to read the rest of it and return.
+*   Parameters : stream - the stream
+*   Effects    : The thread of stream is finished.  All of the output is
+*                in the output queue.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int StreamFinish(lzss_stream_t *stream)
+{
+	if (NULL == stream)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!stream->joined)
+	{
+		pthread_mutex_lock(&stream->lock);
+		stream->finishing = 1;
+		pthread_cond_broadcast(&stream->changed);
+		pthread_mutex_unlock(&stream->lock);
+
+		pthread_join(stream->thread, NULL);
+		stream->joined = 1;
+	}
+
+	if (stream->result != 0)
+	{
+		errno = stream->error;
+		return -1;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : StreamClose
+*   Description: This function frees a stream, finishing it first if it was
+*				 not finished.  Output that was not drained is lost.
+*   Parameters : stream - the stream
+*   Effects    : stream is freed.
+*   Returned   : None
+****************************************************************************/
+void StreamClose(lzss_stream_t *stream)
+{
+	if (NULL == stream)
+	{
+		return;
+	}
+
+	StreamFinish(stream);
+
+	pthread_cond_destroy(&stream->changed);
+	pthread_mutex_destroy(&stream->lock);
+	free(stream->in.data);
+	free(stream->out.data);
+	free(stream);
+}
+
+/****************************************************************************
+*   Function   : StreamWorker
+*   Description: This function is the thread of a stream.  It runs the
+*				 stage on bit files that read and write the queues.
+*   Parameters : arg - the stream
+*   Effects    : The input is read and the output written to the queues.
+*                done and result are set when the stage returned.
+*   Returned   : NULL
+****************************************************************************/
+static void *StreamWorker(void *arg)
+{
+	lzss_stream_t *stream = (lzss_stream_t *)arg;
+	bit_file_t *bfpIn;
+	bit_file_t *bfpOut;
+	int result, error;
+
+	result = -1;
+	error = 0;
+
+	bfpIn = MakeCallbackBitFile(StreamRead, stream, STREAM_BLOCK_SIZE,
+		BF_READ);
+	bfpOut = MakeCallbackBitFile(StreamWrite, stream, STREAM_BLOCK_SIZE,
+		BF_WRITE);
+
+	if ((NULL == bfpIn) || (NULL == bfpOut))
+	{
+		error = errno;
+	}
+	else
+	{
+		result = stream->stage(bfpIn, bfpOut);
+		error = errno;
+	}
+
+	/* closing the output writes its last bits */
+	if (bfpOut != NULL)
+	{
+		BitFileClose(bfpOut);
+	}
+
+	if (bfpIn != NULL)
+	{
+		BitFileClose(bfpIn);
+	}
+
+	pthread_mutex_lock(&stream->lock);
+
+	if ((0 == result) && stream->failed)
+	{
+		result = -1;
+		error = ENOMEM;
+	}
+
+	stream->result = result;
+	stream->error = error;
+	stream->done = 1;
+	pthread_cond_broadcast(&stream->changed);
+	pthread_mutex_unlock(&stream->lock);
+
+	return NULL;
+}
+
+/****************************************************************************
+*   Function   : StreamRead
+*   Description: This function reads the input of a stream for its input
+*				 bit file, waiting until there is some or the input ended.
+*   Parameters : handle - the stream
+*                data - the buffer to read to
+*                size - number of bytes in data
+*   Effects    : Up to size bytes are moved from the input queue to data.
+*   Returned   : The number of bytes read, 0 at the end of the input.
+****************************************************************************/
+static size_t StreamRead(void *handle, unsigned char *data, size_t size)
+{
+	lzss_stream_t *stream = (lzss_stream_t *)handle;
+	size_t taken;
+
+	pthread_mutex_lock(&stream->lock);
+
+	while ((0 == stream->in.length) && !stream->finishing)
+	{
+		pthread_cond_wait(&stream->changed, &stream->lock);
+	}
+
+	taken = QueueTake(&stream->in, data, size);
+	pthread_cond_broadcast(&stream->changed);
+	pthread_mutex_unlock(&stream->lock);
+
+	return taken;
+}
+
+/****************************************************************************
+*   Function   : StreamWrite
+*   Description: This function writes the output of a stream for its
+*				 output bit file.
+*   Parameters : handle - the stream
+*                data - the output
+*                size - number of bytes of output
+*   Effects    : The output is copied to the output queue.
+*   Returned   : size for success, 0 if there is no memory for it.
+****************************************************************************/
+static size_t StreamWrite(void *handle, unsigned char *data, size_t size)
+{
+	lzss_stream_t *stream = (lzss_stream_t *)handle;
+	int result;
+
+	pthread_mutex_lock(&stream->lock);
+	result = QueuePut(&stream->out, data, size);
+
+	if (result != 0)
+	{
+		stream->failed = 1;
+	}
+
+	pthread_mutex_unlock(&stream->lock);
+
+	return (0 == result) ? size : 0;
+}
+
+/****************************************************************************
+*   Function   : QueuePut
+*   Description: This function adds bytes to the end of a queue, moving
+*				 the bytes in it to the front of its buffer or growing the
+*				 buffer to make room.
+*   Parameters : queue - the queue
+*                data - the bytes to add
+*                size - number of bytes to add
+*   Effects    : The bytes are added to queue.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int QueuePut(stream_queue_t *queue, const unsigned char *data,
+	size_t size)
+{
+	unsigned char *bigger;
+	size_t needed;
+
+	if ((queue->start != 0) &&
+		(queue->start + queue->length + size > queue->size))
+	{
+		memmove(queue->data, queue->data + queue->start, queue->length);
+		queue->start = 0;
+	}
+
+	needed = queue->length + size;
+
+	if (needed > queue->size)
+	{
+		if (needed < 2 * queue->size)
+		{
+			needed = 2 * queue->size;
+		}
+
+		bigger = (unsigned char *)realloc(queue->data, needed);
+
+		if (NULL == bigger)
+		{
+			errno = ENOMEM;
+			return -1;
+		}
+
+		queue->data = bigger;
+		queue->size = needed;
+	}
+
+	memcpy(queue->data + queue->start + queue->length, data, size);
+	queue->length += size;
+
+	return 0;
+}
+
+/****************************************************************************
+*   Function   : QueueTake
+*   Description: This function takes bytes from the front of a queue.
+*   Parameters : queue - the queue
+*                data - the buffer to copy them to
+*                size - the most bytes to take
+*   Effects    : The bytes taken are removed from queue.
+*   Returned   : The number of bytes taken.
+****************************************************************************/
+static size_t QueueTake(stream_queue_t *queue, unsigned char *data,
+	size_t size)
+{
+	if (size > queue->length)
+	{
+		size = queue->length;
+	}
+
+	if (size != 0)
+	{
+		memcpy(data, queue->data + queue->start, size);
+	}
+
+	queue->start += size;
+	queue->length -= size;
+
+	if (0 == queue->length)
+	{
+		queue->start = 0;
+	}
+
+	return size;
+}
@@ -0,0 +1,486 @@
+/***************************************************************************
+*          LZSS Encoding and Decoding
+*
+*   File    : tree.c
+*   Purpose : Implement binary tree matching of uncoded strings for LZSS
+*             algorithm.
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*   Based on : Michael Dipperstein implementation Version 0.7
+*			   http://michael.dipperstein.com/lzss/
+*
+*
+****************************************************************************
+*
+* Tree: Binary tree sorted matching routines used by LZSS
+*       Encoding/Decoding Routine
+* Copyright (C) 2004 - 2007, 2014 by
+* Michael Dipperstein (mdipper@alumni.engr.ucsb.edu)
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdlib.h>
+#include <errno.h>
+#include "lzlocal.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define NULL_INDEX      (WINDOW_SIZE + 1)
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/***************************************************************************
+* Every window index is a node of a binary search tree of the MAX_CODED
+* long strings starting at that index.  Only strings that do not contain
+* windowHead are in the tree.  Strings are unique: when an equal string is
+* added, the newer index takes the place of the older one.
+***************************************************************************/
+typedef struct tree_node_t
+{
+    unsigned int leftChild;
+    unsigned int rightChild;
+    unsigned int parent;
+} tree_node_t;
+
+struct search_data_t
+{
+    tree_node_t tree[WINDOW_SIZE];
+    unsigned int treeRoot;
+};
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int CompareString(const lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned int uncodedHead, unsigned int *matched);
+static void AddString(lzss_ctx_t *ctx, const unsigned int charIndex);
+static void RemoveString(lzss_ctx_t *ctx, const unsigned int charIndex);
+static void FixChildren(tree_node_t *tree, const unsigned int index);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : InitializeSearchStructures
+*   Description: This function initializes the binary tree with every
+*                string in the sliding window that does not contain
+*                windowHead (index 0 at the start of encoding).
+*   Parameters : ctx - the codec context
+*   Effects    : The binary tree is allocated and initialized.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int InitializeSearchStructures(lzss_ctx_t *ctx)
+{
+    search_data_t *sd;
+    unsigned int i;
+
+    sd = (search_data_t *)malloc(sizeof(search_data_t));
+    ctx->searchData = sd;
+
+    if (sd == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < WINDOW_SIZE; i++)
+    {
+        sd->tree[i].leftChild = NULL_INDEX;
+        sd->tree[i].rightChild = NULL_INDEX;
+        sd->tree[i].parent = NULL_INDEX;
+    }
+
+    sd->treeRoot = NULL_INDEX;
+
+    for (i = 1; i <= WINDOW_SIZE - MAX_CODED; i++)
+    {
+        AddString(ctx, i);
+    }
+
+    return 0;
+}
+
+/****************************************************************************
+*   Function   : FreeSearchStructures
+*   Description: This function frees the binary tree.
+*   Parameters : ctx - the codec context
+*   Effects    : The binary tree is freed.
+*   Returned   : None
+****************************************************************************/
+void FreeSearchStructures(lzss_ctx_t *ctx)
+{
+    free(ctx->searchData);
+    ctx->searchData = NULL;
+}
+
+/****************************************************************************
+*   Function   : CompareString
+*   Description: This function compares the MAX_CODED long string starting
+*                at slidingWindow[charIndex] with the string in the uncoded
+*                lookahead.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the string
+*                uncodedHead - head of uncoded lookahead buffer
+*                matched - set to the number of matching characters
+*   Effects    : None
+*   Returned   : < 0, 0 or > 0 as the lookahead string is less than, equal
+*                to or greater than the window string.
+****************************************************************************/
+static int CompareString(const lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned int uncodedHead, unsigned int *matched)
+{
+    const unsigned char *slidingWindow = ctx->slidingWindow;
+    const unsigned char *uncodedLookahead = ctx->uncodedLookahead;
+    unsigned int i, j, k;
+    int result;
+
+    result = 0;
+    j = charIndex;
+    k = uncodedHead;
+
+    for (i = 0; i < MAX_CODED; i++)
+    {
+        result = (int)uncodedLookahead[k] - (int)slidingWindow[j];
+
+        if (result != 0)
+        {
+            break;
+        }
+
+        j = Wrap((j + 1), WINDOW_SIZE);
+        k = Wrap((k + 1), MAX_CODED);
+    }
+
+    *matched = i;
+    return result;
+}
+
+/****************************************************************************
+*   Function   : FindMatch
+*   Description: This function will search through the slidingWindow
+*                dictionary for the longest sequence matching the MAX_CODED
+*                long string stored in uncodedLookahed.  The longest match
+*                in a binary search tree is on the search path of the
+*                lookahead.  The MAX_CODED - 1 strings that run into
+*                windowHead are not in the tree and are compared directly,
+*                stopping before windowHead (no self-reference).
+*   Parameters : ctx - the codec context
+*                windowHead - head of sliding window
+*                uncodedHead - head of uncoded lookahead buffer
+*   Effects    : None
+*   Returned   : The sliding window index where the match starts and the
+*                length of the match.  If there is no match a length of
+*                zero will be returned.
+****************************************************************************/
+encoded_string_t FindMatch(lzss_ctx_t *ctx, const unsigned int windowHead,
+    unsigned int uncodedHead)
+{
+    const unsigned char *slidingWindow = ctx->slidingWindow;
+    const unsigned char *uncodedLookahead = ctx->uncodedLookahead;
+    const tree_node_t *tree = ctx->searchData->tree;
+    encoded_string_t matchData;
+    unsigned int i, j, k, matched;
+    int compare;
+
+    matchData.length = 0;
+    matchData.offset = 0;
+
+    i = ctx->searchData->treeRoot;
+
+    while (i != NULL_INDEX)
+    {
+        compare = CompareString(ctx, i, uncodedHead, &matched);
+
+        if (matched > matchData.length)
+        {
+            matchData.length = matched;
+            matchData.offset = i;
+
+            if (matched >= MAX_CODED)
+            {
+                return matchData;
+            }
+        }
+
+        i = (compare < 0) ? tree[i].leftChild : tree[i].rightChild;
+    }
+
+    /* strings that contain windowHead */
+    i = Wrap((windowHead + WINDOW_SIZE - (MAX_CODED - 1)), WINDOW_SIZE);
+
+    while (i != windowHead)
+    {
+        j = 0;
+        k = i;
+
+        while ((k != windowHead) && (slidingWindow[k] ==
+            uncodedLookahead[Wrap((uncodedHead + j), MAX_CODED)]))
+        {
+            j++;
+            k = Wrap((k + 1), WINDOW_SIZE);
+        }
+
+        if (j > matchData.length)
+        {
+            matchData.length = j;
+            matchData.offset = i;
+        }
+
+        i = Wrap((i + 1), WINDOW_SIZE);
+    }
+
+    return matchData;
+}
+
+/****************************************************************************
+*   Function   : FixChildren
+*   Description: This function makes the children of a node point back to
+*                it as their parent.
+*   Parameters : tree - the binary tree
+*                index - sliding window index of the node
+*   Effects    : The parents of the children of index are updated.
+*   Returned   : None
+****************************************************************************/
+static void FixChildren(tree_node_t *tree, const unsigned int index)
+{
+    if (tree[index].leftChild != NULL_INDEX)
+    {
+        tree[tree[index].leftChild].parent = index;
+    }
+
+    if (tree[index].rightChild != NULL_INDEX)
+    {
+        tree[tree[index].rightChild].parent = index;
+    }
+}
+
+/****************************************************************************
+*   Function   : AddString
+*   Description: This function adds the MAX_CODED long string starting at
+*                slidingWindow[charIndex] to the binary tree.  If the tree
+*                already contains an equal string, charIndex replaces it.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the string
+*   Effects    : The string is in the binary tree.
+*   Returned   : None
+****************************************************************************/
+static void AddString(lzss_ctx_t *ctx, const unsigned int charIndex)
+{
+    const unsigned char *slidingWindow = ctx->slidingWindow;
+    tree_node_t *tree = ctx->searchData->tree;
+    unsigned int *treeRoot = &ctx->searchData->treeRoot;
+    unsigned int i, j, k, n, parent, child;
+    int compare;
+
+    tree[charIndex].leftChild = NULL_INDEX;
+    tree[charIndex].rightChild = NULL_INDEX;
+
+    if (*treeRoot == NULL_INDEX)
+    {
+        *treeRoot = charIndex;
+        tree[charIndex].parent = NULL_INDEX;
+        return;
+    }
+
+    i = *treeRoot;
+
+    while (1)
+    {
+        /* compare the new string with the one at i */
+        compare = 0;
+        j = charIndex;
+        k = i;
+
+        for (n = 0; n < MAX_CODED; n++)
+        {
+            compare = (int)slidingWindow[j] - (int)slidingWindow[k];
+
+            if (compare != 0)
+            {
+                break;
+            }
+
+            j = Wrap((j + 1), WINDOW_SIZE);
+            k = Wrap((k + 1), WINDOW_SIZE);
+        }
+
+        if (compare == 0)
+        {
+            /* equal strings, the new one takes the place of the old one */
+            tree[charIndex] = tree[i];
+            FixChildren(tree, charIndex);
+
+            parent = tree[i].parent;
+
+            if (parent == NULL_INDEX)
+            {
+                *treeRoot = charIndex;
+            }
+            else if (tree[parent].leftChild == i)
+            {
+                tree[parent].leftChild = charIndex;
+            }
+            else
+            {
+                tree[parent].rightChild = charIndex;
+            }
+
+            tree[i].leftChild = NULL_INDEX;
+            tree[i].rightChild = NULL_INDEX;
+            tree[i].parent = NULL_INDEX;
+            return;
+        }
+
+        child = (compare < 0) ? tree[i].leftChild : tree[i].rightChild;
+
+        if (child == NULL_INDEX)
+        {
+            if (compare < 0)
+            {
+                tree[i].leftChild = charIndex;
+            }
+            else
+            {
+                tree[i].rightChild = charIndex;
+            }
+
+            tree[charIndex].parent = i;
+            return;
+        }
+
+        i = child;
+    }
+}
+
+/****************************************************************************
+*   Function   : RemoveString
+*   Description: This function removes the string starting at
+*                slidingWindow[charIndex] from the binary tree.  Nothing is
+*                done if it is not in the tree.  A node with two children
+*                is replaced by the largest node of its left subtree.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the string
+*   Effects    : The string is not in the binary tree.
+*   Returned   : None
+****************************************************************************/
+static void RemoveString(lzss_ctx_t *ctx, const unsigned int charIndex)
+{
+    tree_node_t *tree = ctx->searchData->tree;
+    unsigned int *treeRoot = &ctx->searchData->treeRoot;
+    unsigned int parent, replacement;
+
+    if ((tree[charIndex].parent == NULL_INDEX) && (*treeRoot != charIndex))
+    {
+        /* not in the tree */
+        return;
+    }
+
+    if (tree[charIndex].leftChild == NULL_INDEX)
+    {
+        replacement = tree[charIndex].rightChild;
+    }
+    else if (tree[charIndex].rightChild == NULL_INDEX)
+    {
+        replacement = tree[charIndex].leftChild;
+    }
+    else
+    {
+        /* find the largest node of the left subtree and unlink it */
+        replacement = tree[charIndex].leftChild;
+
+        while (tree[replacement].rightChild != NULL_INDEX)
+        {
+            replacement = tree[replacement].rightChild;
+        }
+
+        if (replacement != tree[charIndex].leftChild)
+        {
+            parent = tree[replacement].parent;
+            tree[parent].rightChild = tree[replacement].leftChild;
+
+            if (tree[replacement].leftChild != NULL_INDEX)
+            {
+                tree[tree[replacement].leftChild].parent = parent;
+            }
+
+            tree[replacement].leftChild = tree[charIndex].leftChild;
+        }
+
+        tree[replacement].rightChild = tree[charIndex].rightChild;
+        FixChildren(tree, replacement);
+    }
+
+    /* link the replacement to the parent of the removed node */
+    parent = tree[charIndex].parent;
+
+    if (replacement != NULL_INDEX)
+    {
+        tree[replacement].parent = parent;
+    }
+
+    if (parent == NULL_INDEX)
+    {
+        *treeRoot = replacement;
+    }
+    else if (tree[parent].leftChild == charIndex)
+    {
+        tree[parent].leftChild = replacement;
+    }
+    else
+    {
+        tree[parent].rightChild = replacement;
+    }
+
+    tree[charIndex].leftChild = NULL_INDEX;
+    tree[charIndex].rightChild = NULL_INDEX;
+    tree[charIndex].parent = NULL_INDEX;
+}
+
+/****************************************************************************
+*   Function   : ReplaceChar
+*   Description: This function replaces the character stored in
+*                slidingWindow[charIndex] with the one specified by
+*                replacement.  charIndex is windowHead, so the string after
+*                it becomes the new windowHead and leaves the tree, and the
+*                string ending with the new character enters it.
+*   Parameters : ctx - the codec context
+*                charIndex - sliding window index of the character to be
+*                            replaced (windowHead).
+*   Effects    : slidingWindow[charIndex] is replaced by replacement.  The
+*                binary tree is updated.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int ReplaceChar(lzss_ctx_t *ctx, const unsigned int charIndex,
+    const unsigned char replacement)
+{
+    RemoveString(ctx, Wrap((charIndex + 1), WINDOW_SIZE));
+    ctx->slidingWindow[charIndex] = replacement;
+    AddString(ctx,
+        Wrap((charIndex + WINDOW_SIZE - (MAX_CODED - 1)), WINDOW_SIZE));
+
+    return 0;
+}
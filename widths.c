@@ -0,0 +1,325 @@
+/***************************************************************************
+*  A New Compression Method for Compressed Matching Encoding and Decoding
+*
+*   File    : widths.c
+*   Purpose : Encode and decode LZSS streams whose offset and length widths
+*             are chosen for every stream and recorded in its header
+*   Author  : Avichai and Omer
+*   Date    : 2016
+*
+****************************************************************************
+*
+* This file is part of the lzss library.
+*
+* The lzss library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The lzss library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "lzss.h"
+#include "lzlocal.h"
+#include "bitfile.h"
+
+/***************************************************************************
+* A stream is
+*   header - "LZSW", version, OFFSET_BITS, LENGTH_BITS and the character the
+*            window is filled with
+*   items  - as written by EncodeLZSS, with the widths of the header
+* With 12 and 4 bits the items are in the format of EncodeLZSS and
+* DecodeLZSS decodes them, but they are not always the same items: the
+* encoders never match into the window fill and give up after WIDTHS_CHAIN
+* positions, so they may find shorter matches than EncodeLZSS.
+***************************************************************************/
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define WIDTHS_MAGIC        "LZSW"
+#define WIDTHS_VERSION      1
+#define WIDTHS_FILL         '~'
+#define WIDTHS_HEADER_SIZE  8
+
+/* hash chains of the encoders */
+#define WIDTHS_HASH_BITS    16
+#define WIDTHS_HASH_SIZE    (1U << WIDTHS_HASH_BITS)
+#define WIDTHS_CHAIN        64          /* most positions tried for a match */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+
+/* the encoder and decoder of a pair of widths */
+typedef struct widths_kernel_t
+{
+	unsigned int offsetBits;
+	unsigned int lengthBits;
+	stage_func_t encode;
+	int (*decode)(bit_file_t *bfpIn, bit_file_t *bfpOut, int fill);
+} widths_kernel_t;
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static void PutWidthsHeader(bit_file_t *bfpOut, unsigned int offsetBits,
+	unsigned int lengthBits);
+static unsigned int WidthsHash(const unsigned char *ring, unsigned int pos,
+	unsigned int mask);
+static const widths_kernel_t *FindKernel(unsigned int offsetBits,
+	unsigned int lengthBits);
+static int DecodeWidthsBits(bit_file_t *bfpIn, bit_file_t *bfpOut);
+
+/***************************************************************************
+*                                 KERNELS
+***************************************************************************/
+#define KERNEL_OFFSET_BITS  12
+#define KERNEL_LENGTH_BITS  4
+#define KERNEL_ENCODE       Encode12x4Bits
+#define KERNEL_DECODE       Decode12x4Bits
+#include "lzkernel.h"
+
+#define KERNEL_OFFSET_BITS  16
+#define KERNEL_LENGTH_BITS  8
+#define KERNEL_ENCODE       Encode16x8Bits
+#define KERNEL_DECODE       Decode16x8Bits
+#include "lzkernel.h"
+
+#define KERNEL_OFFSET_BITS  20
+#define KERNEL_LENGTH_BITS  8
+#define KERNEL_ENCODE       Encode20x8Bits
+#define KERNEL_DECODE       Decode20x8Bits
+#include "lzkernel.h"
+
+static const widths_kernel_t kernels[] =
+{
+	{12, 4, Encode12x4Bits, Decode12x4Bits},
+	{16, 8, Encode16x8Bits, Decode16x8Bits},
+	{20, 8, Encode20x8Bits, Decode20x8Bits}
+};
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/****************************************************************************
+*   Function   : EncodeLZSSWidths
+*   Description: This function reads an input file and writes it encoded
+*				 according to the traditional LZSS algorithm, with offsets
+*				 of offsetBits bits and lengths of lengthBits bits, after a
+*				 header that records them.
+*   Parameters : fpIn - pointer to the open binary file to encode
+*                fpOut - pointer to the open binary file to write encoded
+*                       output
+*                offsetBits, lengthBits - the widths, 12 and 4, 16 and 8
+*                       or 20 and 8
+*   Effects    : fpIn is encoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to ENOTSUP for widths without a kernel.
+****************************************************************************/
+int EncodeLZSSWidths(FILE *fpIn, FILE *fpOut, unsigned int offsetBits,
+	unsigned int lengthBits)
+{
+	const widths_kernel_t *kernel;
+
+	kernel = FindKernel(offsetBits, lengthBits);
+
+	if (NULL == kernel)
+	{
+		return -1;
+	}
+
+	return RunFileStage(kernel->encode, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : DecodeLZSSWidths
+*   Description: This function decodes a file encoded by EncodeLZSSWidths,
+*				 with the kernel of the widths in its header.
+*   Parameters : fpIn - pointer to the open binary file to decode
+*                fpOut - pointer to the open binary file to write decoded
+*                       output
+*   Effects    : fpIn is decoded and written to fpOut.  Neither file is
+*                closed after exit.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure, to ENOTSUP for widths without a kernel.
+****************************************************************************/
+int DecodeLZSSWidths(FILE *fpIn, FILE *fpOut)
+{
+	return RunFileStage(DecodeWidthsBits, fpIn, fpOut);
+}
+
+/****************************************************************************
+*   Function   : EncodeLZSSWidthsBuf
+*                DecodeLZSSWidthsBuf
+*   Description: These functions are the in memory versions of the
+*				 functions with the same names.  They read the inSize
+*				 bytes at in and allocate the buffer they write.
+*   Parameters : in - the input buffer
+*                inSize - number of bytes in the input buffer
+*                offsetBits, lengthBits - the widths to encode with
+*                out - set to the allocated output buffer, which the caller
+*                      has to free
+*                outSize - set to the number of bytes in the output buffer
+*   Effects    : in is read and the output written to *out.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+int EncodeLZSSWidthsBuf(const unsigned char *in, size_t inSize,
+	unsigned int offsetBits, unsigned int lengthBits,
+	unsigned char **out, size_t *outSize)
+{
+	const widths_kernel_t *kernel;
+
+	kernel = FindKernel(offsetBits, lengthBits);
+
+	if (NULL == kernel)
+	{
+		return -1;
+	}
+
+	return RunBufferStage(kernel->encode, in, inSize, out, outSize);
+}
+
+int DecodeLZSSWidthsBuf(const unsigned char *in, size_t inSize,
+	unsigned char **out, size_t *outSize)
+{
+	return RunBufferStage(DecodeWidthsBits, in, inSize, out, outSize);
+}
+
+/****************************************************************************
+*   Function   : FindKernel
+*   Description: This function finds the kernel of a pair of widths.
+*   Parameters : offsetBits, lengthBits - the widths
+*   Effects    : None
+*   Returned   : The kernel, NULL with errno set to ENOTSUP if there is
+*                none.
+****************************************************************************/
+static const widths_kernel_t *FindKernel(unsigned int offsetBits,
+	unsigned int lengthBits)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+	{
+		if ((kernels[i].offsetBits == offsetBits) &&
+			(kernels[i].lengthBits == lengthBits))
+		{
+			return &kernels[i];
+		}
+	}
+
+	errno = ENOTSUP;
+	return NULL;
+}
+
+/****************************************************************************
+*   Function   : DecodeWidthsBits
+*   Description: This function reads the header of a stream written by
+*				 EncodeLZSSWidths and decodes the stream with the kernel of
+*				 its widths, for DecodeLZSSWidths and DecodeLZSSWidthsBuf.
+*   Parameters : bfpIn - pointer to the bit file to decode
+*                bfpOut - pointer to the bit file to write decoded output
+*   Effects    : bfpIn is decoded and written to bfpOut.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+****************************************************************************/
+static int DecodeWidthsBits(bit_file_t *bfpIn, bit_file_t *bfpOut)
+{
+	const widths_kernel_t *kernel;
+	unsigned char header[WIDTHS_HEADER_SIZE];
+	unsigned int i;
+	int c;
+
+	for (i = 0; i < WIDTHS_HEADER_SIZE; i++)
+	{
+		if ((c = BitFileGetChar(bfpIn)) == EOF)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		header[i] = (unsigned char)c;
+	}
+
+	if ((memcmp(header, WIDTHS_MAGIC, 4) != 0) ||
+		(header[4] != WIDTHS_VERSION))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	kernel = FindKernel(header[5], header[6]);
+
+	if (NULL == kernel)
+	{
+		return -1;
+	}
+
+	return kernel->decode(bfpIn, bfpOut, header[7]);
+}
+
+/****************************************************************************
+*   Function   : PutWidthsHeader
+*   Description: This function writes the header of a stream.
+*   Parameters : bfpOut - pointer to the bit file to write
+*                offsetBits, lengthBits - the widths of the stream
+*   Effects    : The header is written to bfpOut.
+*   Returned   : None
+****************************************************************************/
+static void PutWidthsHeader(bit_file_t *bfpOut, unsigned int offsetBits,
+	unsigned int lengthBits)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		BitFilePutChar(WIDTHS_MAGIC[i], bfpOut);
+	}
+
+	BitFilePutChar(WIDTHS_VERSION, bfpOut);
+	BitFilePutChar((int)offsetBits, bfpOut);
+	BitFilePutChar((int)lengthBits, bfpOut);
+	BitFilePutChar(WIDTHS_FILL, bfpOut);
+}
+
+/****************************************************************************
+*   Function   : WidthsHash
+*   Description: This function hashes the MAX_UNCODED + 1 characters at a
+*				 position of the ring of an encoder, the shortest string
+*				 worth a pointer.
+*   Parameters : ring - the ring
+*                pos - the position
+*                mask - size of the ring - 1
+*   Effects    : None
+*   Returned   : The hash, less than WIDTHS_HASH_SIZE.
+****************************************************************************/
+static unsigned int WidthsHash(const unsigned char *ring, unsigned int pos,
+	unsigned int mask)
+{
+	unsigned long key;
+
+	key = (unsigned long)ring[pos & mask] |
+		((unsigned long)ring[(pos + 1) & mask] << 8) |
+		((unsigned long)ring[(pos + 2) & mask] << 16) |
+		((unsigned long)ring[(pos + 3) & mask] << 24);
+
+	return (unsigned int)(((key * 2654435761UL) & 0xFFFFFFFFUL) >>
+		(32 - WIDTHS_HASH_BITS));
+}